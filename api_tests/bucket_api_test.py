@@ -13,7 +13,7 @@ def test__create_bucket_ok(base_url, session, bucket_name):
 
     data = json.loads(resp.content)
     assert data['settings'] == {"max_block_records": "1024", "max_block_size": "64000000",
-                                "quota_type": "NONE", "quota_size": '0'}
+                                "quota_type": "NONE", "quota_size": '0', "durability": "NO_SYNC"}
     assert data['info']['name'] == bucket_name
     assert len(data['entries']) == 0
 
@@ -50,7 +50,7 @@ def test__create_bucket_custom(base_url, session, bucket_name):
 
     data = json.loads(resp.content)
     assert data['settings'] == {"max_block_records": "1024", "max_block_size": "500", "quota_type": "NONE",
-                                "quota_size": "0"}
+                                "quota_size": "0", "durability": "NO_SYNC"}
 
 
 def test__create_twice_bucket(base_url, session, bucket_name):
@@ -125,7 +125,7 @@ def test__update_bucket_ok(base_url, session, bucket_name):
     assert resp.status_code == 200
     data = json.loads(resp.content)
 
-    new_settings.update({"quota_size": '0', 'max_block_records': '1024'})
+    new_settings.update({"quota_size": '0', 'max_block_records': '1024', "durability": "NO_SYNC"})
     assert data['settings'] == new_settings
 
 
@@ -89,6 +89,27 @@ def test__read_with_read_token(base_url, session, bucket, token_without_permissi
     assert resp.status_code == 403
 
 
+def test_write_batch(base_url, session, bucket):
+    """Should write many records into a few entries in one request"""
+    data = b"entry_1 1000 6\ndata_1entry_2 1000 6\ndata_2entry_1 1100 6\ndata_3"
+    resp = session.post(f'{base_url}/b/{bucket}/batch', data=data)
+    assert resp.status_code == 200
+
+    resp = session.get(f'{base_url}/b/{bucket}/entry_1?ts=1100')
+    assert resp.status_code == 200
+    assert resp.content == b"data_3"
+
+    resp = session.get(f'{base_url}/b/{bucket}/entry_2?ts=1000')
+    assert resp.status_code == 200
+    assert resp.content == b"data_2"
+
+
+def test_write_batch_bad_header(base_url, session, bucket):
+    """Should check headers of records in batch"""
+    resp = session.post(f'{base_url}/b/{bucket}/batch', data=b"entry_1 1000\ndata_1")
+    assert resp.status_code == 400
+
+
 def test_write_no_bucket(base_url, session):
     """Should return 404 if no bucket found"""
     resp = session.post(f'{base_url}/b/xxx/entry?ts=100')
@@ -245,6 +266,36 @@ def test_query_entry_next(base_url, session, bucket):
     assert resp.status_code == 404
 
 
+def test_query_entry_batch(base_url, session, bucket):
+    """Should read many records in one response"""
+
+    ts = 1000
+    for i in range(3):
+        resp = session.post(f'{base_url}/b/{bucket}/entry?ts={ts + i * 100}', data=f"data_{i}")
+        assert resp.status_code == 200
+
+    resp = session.get(f'{base_url}/b/{bucket}/entry/q?start={ts}')
+    assert resp.status_code == 200
+
+    query_id = int(json.loads(resp.content)["id"])
+    resp = session.get(f'{base_url}/b/{bucket}/entry/batch?q={query_id}&count=2')
+
+    assert resp.status_code == 200
+    assert resp.content == b"1000 6\ndata_01100 6\ndata_1"
+    assert resp.headers['x-reduct-count'] == '2'
+    assert resp.headers['x-reduct-last'] == '0'
+
+    resp = session.get(f'{base_url}/b/{bucket}/entry/batch?q={query_id}&count=2')
+
+    assert resp.status_code == 200
+    assert resp.content == b"1200 6\ndata_2"
+    assert resp.headers['x-reduct-count'] == '1'
+    assert resp.headers['x-reduct-last'] == '1'
+
+    resp = session.get(f'{base_url}/b/{bucket}/entry/batch?q={query_id}')
+    assert resp.status_code == 404
+
+
 def test_query_ttl(base_url, session, bucket):
     """Should keep TTL of query"""
 
@@ -16,7 +16,7 @@ def test__get_info(base_url, session):
     assert int(data['oldest_record']) >= 0
 
     assert data['defaults']['bucket'] == {'max_block_records': '1024', 'max_block_size': '64000000', 'quota_size': '0',
-                                          'quota_type': 'NONE'}
+                                          'quota_type': 'NONE', 'durability': 'NO_SYNC'}
     assert resp.headers['server'] == "ReductStorage"
     assert resp.headers['Content-Type'] == "application/json"
 
@@ -0,0 +1,105 @@
+// Copyright 2023 ReductStore
+// This Source Code Form is subject to the terms of the Mozilla Public
+//    License, v. 2.0. If a copy of the MPL was not distributed with this
+//    file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include <catch2/catch.hpp>
+#include <fmt/core.h>
+#include <uWebSockets/Loop.h>
+
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <vector>
+
+#include "reduct/async/event.h"
+#include "reduct/async/loop.h"
+#include "reduct/async/task.h"
+
+using reduct::async::Event;
+using reduct::async::ILoop;
+using reduct::async::VoidTask;
+
+using Clock = std::chrono::steady_clock;
+using namespace std::chrono_literals;  // NOLINT
+
+/**
+ * Waiting as it was before the loop had timers and events: defer the check again and again
+ */
+struct PollingWait {
+  const bool& flag;
+
+  bool await_ready() const noexcept { return flag; }
+
+  void await_suspend(std::coroutine_handle<> h) const noexcept {
+    if (flag) {
+      h.resume();
+    } else {
+      ILoop::loop().Defer([this, h] { await_suspend(h); });
+    }
+  }
+
+  void await_resume() const noexcept {}
+};
+
+/**
+ * Idle keep-alive stream which waits for data from its client
+ */
+struct Stream {
+  bool ready{};
+  Event event;
+  Clock::time_point ready_at;
+  Clock::duration latency;
+};
+
+VoidTask WaitPolling(Stream* stream) {
+  co_await PollingWait{stream->ready};
+  stream->latency = Clock::now() - stream->ready_at;
+}
+
+VoidTask WaitEvent(Stream* stream) {
+  co_await stream->event;
+  stream->latency = Clock::now() - stream->ready_at;
+}
+
+TEST_CASE("async::ILoop wakeups of idle keep-alive streams") {
+  constexpr size_t kStreams = 1000;
+  constexpr auto kIdleTime = 500ms;
+  const bool polling = GENERATE(true, false);
+
+  auto loop = ILoop::Build();
+  ILoop::set_loop(loop.get());
+
+  std::vector<Stream> streams(kStreams);
+  for (auto& stream : streams) {
+    polling ? WaitPolling(&stream) : WaitEvent(&stream);
+  }
+
+  // the clients send data after the idle time
+  loop->Schedule(kIdleTime, [&streams] {
+    for (auto& stream : streams) {
+      stream.ready_at = Clock::now();
+      stream.ready = true;
+      stream.event.Set();
+    }
+  });
+
+  // keeps the loop alive until the streams are resumed
+  loop->Schedule(kIdleTime + 100ms, [] {});
+
+  const auto cpu_start = std::clock();
+  const auto wall_start = Clock::now();
+  uWS::Loop::get()->run();
+  ILoop::set_loop(nullptr);
+
+  const auto cpu_ms = (std::clock() - cpu_start) * 1000 / CLOCKS_PER_SEC;
+  const auto wall_ms = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - wall_start).count();
+  const auto max_latency = std::max_element(streams.begin(), streams.end(), [](auto& lhs, auto& rhs) {
+                             return lhs.latency < rhs.latency;
+                           })->latency;
+
+  fmt::print("{} streams ({}): CPU {} ms of {} ms, max wakeup latency {} us\n", kStreams,
+             polling ? "polling" : "events", cpu_ms, wall_ms,
+             std::chrono::duration_cast<std::chrono::microseconds>(max_latency).count());
+}
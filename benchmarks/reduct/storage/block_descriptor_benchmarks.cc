@@ -0,0 +1,76 @@
+// Copyright 2022 ReductStore
+// This Source Code Form is subject to the terms of the Mozilla Public
+//    License, v. 2.0. If a copy of the MPL was not distributed with this
+//    file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include <catch2/catch.hpp>
+#include <fmt/core.h>
+#include <google/protobuf/util/time_util.h>
+
+#include <string>
+
+#include "reduct/proto/storage/entry.pb.h"
+#include "reduct/storage/block_descriptor.h"
+
+using google::protobuf::util::TimeUtil;
+using reduct::proto::Block;
+using reduct::proto::Record;
+using reduct::storage::ParseBlockDescriptor;
+using reduct::storage::SerializeBlockDescriptor;
+
+/**
+ * Builds a full block of 1024 records, as the default settings make it
+ */
+static Block MakeBlock(int label_count) {
+  constexpr int kRecordCount = 1024;
+  constexpr int64_t kBeginTime = 1'660'000'000'000'000;
+
+  Block block;
+  *block.mutable_begin_time() = TimeUtil::MicrosecondsToTimestamp(kBeginTime);
+  for (int i = 0; i < kRecordCount; ++i) {
+    auto record = block.add_records();
+    *record->mutable_timestamp() = TimeUtil::MicrosecondsToTimestamp(kBeginTime + i * 1000);
+    record->set_begin(i * 10'000);
+    record->set_end((i + 1) * 10'000);
+    record->set_state(Record::kFinished);
+    for (int j = 0; j < label_count; ++j) {
+      auto label = record->add_meta_data();
+      label->set_key(fmt::format("label_{}", j));
+      label->set_value(std::to_string(i % 10));
+    }
+  }
+
+  block.set_size(kRecordCount * 10'000);
+  *block.mutable_latest_record_time() = block.records(kRecordCount - 1).timestamp();
+  return block;
+}
+
+/**
+ * Compares the descriptor of a block in the binary format with the protobuf one of the previous versions.
+ * Both are decoded into proto::Block, so the benchmarks show the load time, not the RAM of cached blocks
+ */
+static void BenchmarkDescriptor(int label_count) {
+  const auto block = MakeBlock(label_count);
+  const auto binary = SerializeBlockDescriptor(block);
+  const auto protobuf = block.SerializeAsString();
+  WARN(fmt::format("Descriptor size: binary {} bytes, protobuf {} bytes", binary.size(), protobuf.size()));
+
+  BENCHMARK("parse binary") {
+    Block parsed;
+    return ParseBlockDescriptor(binary, &parsed).code;
+  };
+
+  BENCHMARK("parse protobuf") {
+    Block parsed;
+    return parsed.ParseFromString(protobuf);
+  };
+
+  BENCHMARK("serialize binary") { return SerializeBlockDescriptor(block).size(); };
+
+  BENCHMARK("serialize protobuf") { return block.SerializeAsString().size(); };
+}
+
+TEST_CASE("storage::BlockDescriptor of 1024 records without labels") { BenchmarkDescriptor(0); }
+
+TEST_CASE("storage::BlockDescriptor of 1024 records with 2 labels") { BenchmarkDescriptor(2); }
@@ -5,9 +5,12 @@
 
 #define CATCH_CONFIG_ENABLE_BENCHMARKING
 #include <catch2/catch.hpp>
+#include <fmt/core.h>
 #include <google/protobuf/util/time_util.h>
 
+#include <algorithm>
 #include <filesystem>
+#include <iostream>
 
 #include "reduct/storage/bucket.h"
 #include "reduct/storage/entry.h"
@@ -39,3 +42,56 @@ TEST_CASE("storage::IEntry write operation") {
     [[maybe_unused]] auto ret = writer->Write("1234567890");
   };
 }
+
+TEST_CASE("storage::IEntry write operation with durability") {
+  const auto durability = GENERATE(BucketSettings::NO_SYNC, BucketSettings::BATCHED_SYNC, BucketSettings::STRICT_SYNC);
+  const auto name = BucketSettings::Durability_Name(durability);
+
+  auto dir_path = fs::temp_directory_path() / "reduct" / "bucket";
+  fs::remove_all(dir_path);
+
+  BucketSettings settings;
+  settings.set_durability(durability);
+  auto bucket = IBucket::Build(dir_path, settings);
+  auto entry = bucket->GetOrCreateEntry("entry-1").result.lock();
+
+  // writes concurrent requests and waits until they are synced, as the HTTP API does
+  constexpr int kConcurrentWrites = 100;
+  auto write_and_sync = [&entry](std::vector<std::chrono::microseconds>* latencies) {
+    using Clock = std::chrono::steady_clock;
+
+    std::vector<reduct::async::IAsyncWriter::SPtr> writers;
+    const auto start = Clock::now();
+    for (int i = 0; i < kConcurrentWrites; ++i) {
+      auto [writer, err] = entry->BeginWrite(Time::clock::now(), 10);
+      [[maybe_unused]] auto ret = writer->Write("1234567890");
+      writers.push_back(writer);
+    }
+
+    std::vector<bool> synced(writers.size());
+    for (size_t count = 0; count < writers.size();) {
+      for (size_t i = 0; i < writers.size(); ++i) {
+        if (!synced[i] && writers[i]->sync_result()) {
+          synced[i] = true;
+          ++count;
+          if (latencies) {
+            latencies->push_back(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start));
+          }
+        }
+      }
+    }
+  };
+
+  BENCHMARK(fmt::format("Write {} records with {}", kConcurrentWrites, name)) { write_and_sync(nullptr); };
+
+  std::vector<std::chrono::microseconds> latencies;
+  for (int i = 0; i < 10; ++i) {
+    write_and_sync(&latencies);
+  }
+
+  std::ranges::sort(latencies);
+  const auto p99 = latencies[latencies.size() * 99 / 100];
+  std::cout << fmt::format("Latency of write with {}: p50={}us p99={}us", name, latencies[latencies.size() / 2].count(),
+                           p99.count())
+            << std::endl;
+}
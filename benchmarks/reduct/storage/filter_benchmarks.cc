@@ -0,0 +1,65 @@
+// Copyright 2022 ReductStore
+// This Source Code Form is subject to the terms of the Mozilla Public
+//    License, v. 2.0. If a copy of the MPL was not distributed with this
+//    file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include <catch2/catch.hpp>
+
+#include <vector>
+
+#include "reduct/proto/storage/entry.pb.h"
+#include "reduct/storage/query/filter.h"
+
+using reduct::proto::Record;
+using reduct::storage::query::FindStateKernel;
+using reduct::storage::query::GetFindStateKernels;
+
+/**
+ * Takes all the finished records one by one as a query does
+ */
+static size_t ScanFinished(FindStateKernel kernel, const std::vector<uint8_t>& states) {
+  size_t found = 0;
+  for (size_t pos = kernel(states, 0, Record::kFinished); pos < states.size();
+       pos = kernel(states, pos + 1, Record::kFinished)) {
+    ++found;
+  }
+  return found;
+}
+
+TEST_CASE("storage::query::FindState on a block of 1024 records") {
+  constexpr size_t kRecordCount = 1024;
+  const auto kernels = GetFindStateKernels();
+
+  // the worst case for a query: all the records in the block are being written except the last one
+  std::vector<uint8_t> states(kRecordCount, Record::kStarted);
+  states.back() = Record::kFinished;
+
+  BENCHMARK("scalar") { return ScanFinished(kernels.scalar, states); };
+
+  if (kernels.sse2) {
+    BENCHMARK("sse2") { return ScanFinished(kernels.sse2, states); };
+  }
+
+  if (kernels.avx2) {
+    BENCHMARK("avx2") { return ScanFinished(kernels.avx2, states); };
+  }
+}
+
+TEST_CASE("storage::query::FindState on a block of 1024 finished records") {
+  constexpr size_t kRecordCount = 1024;
+  const auto kernels = GetFindStateKernels();
+
+  // the usual case: the query takes the records one by one
+  std::vector<uint8_t> states(kRecordCount, Record::kFinished);
+
+  BENCHMARK("scalar") { return ScanFinished(kernels.scalar, states); };
+
+  if (kernels.sse2) {
+    BENCHMARK("sse2") { return ScanFinished(kernels.sse2, states); };
+  }
+
+  if (kernels.avx2) {
+    BENCHMARK("avx2") { return ScanFinished(kernels.avx2, states); };
+  }
+}
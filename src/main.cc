@@ -3,13 +3,11 @@
 //    License, v. 2.0. If a copy of the MPL was not distributed with this
 //    file, You can obtain one at https://mozilla.org/MPL/2.0/.
 //
-#include <uWebSockets/Loop.h>
-
+#include <algorithm>
 #include <csignal>
 
 #include "reduct/api/http_server.h"
 #include "reduct/asset/asset_manager.h"
-#include "reduct/async/loop.h"
 #include "reduct/auth/token_auth.h"
 #include "reduct/config.h"
 #include "reduct/core/env_variable.h"
@@ -22,7 +20,6 @@
 
 using reduct::api::IHttpServer;
 using reduct::asset::IAssetManager;
-using reduct::async::ILoop;
 using reduct::auth::ITokenAuthorization;
 using reduct::auth::ITokenRepository;
 using reduct::core::EnvVariable;
@@ -30,11 +27,6 @@ using reduct::core::Error;
 using reduct::core::Logger;
 using ReductStorage = reduct::storage::IStorage;
 
-class Loop : public ILoop {
- public:
-  void Defer(Task&& task) override { uWS::Loop::get()->defer(std::move(task)); }
-};
-
 static bool running = true;
 static void SignalHandler(auto signal) { running = false; }
 
@@ -53,14 +45,15 @@ int main() {
   auto api_token = env.Get<std::string>("RS_API_TOKEN", "", true);
   auto cert_path = env.Get<std::string>("RS_CERT_PATH", "");
   auto cert_key_path = env.Get<std::string>("RS_CERT_KEY_PATH", "");
+  auto threads = env.Get<int>("RS_THREADS", 1);
+  auto reclaim_high_watermark = env.Get<int>("RS_RECLAIM_HIGH_WATERMARK", 95);
+  auto reclaim_low_watermark = env.Get<int>("RS_RECLAIM_LOW_WATERMARK", 90);
+  auto reclaim_rate = env.Get<size_t>("RS_RECLAIM_RATE", 0);
 
   Logger::set_level(log_level);
 
   LOG_INFO("Configuration: \n {}", env.Print());
 
-  Loop loop;
-  ILoop::set_loop(&loop);
-
 #if WITH_CONSOLE
   auto console = IAssetManager::BuildFromZip(reduct::kZippedConsole);
 #else
@@ -68,7 +61,16 @@ int main() {
 #endif
 
   IHttpServer::Components components{
-      .storage = ReductStorage::Build({.data_path = data_path}),
+      .storage = ReductStorage::Build({
+          .data_path = data_path,
+          .reclaimer =
+              {
+                  .high_watermark = reclaim_high_watermark / 100.0,
+                  .low_watermark = std::min(reclaim_low_watermark, reclaim_high_watermark) / 100.0,
+                  .max_rate = reclaim_rate,
+              },
+          .background_restore = true,
+      }),
       .auth = ITokenAuthorization::Build(api_token),
       .token_repository = ITokenRepository::Build({.data_path = data_path, .api_token = api_token}),
       .console = std::move(console),
@@ -80,6 +82,7 @@ int main() {
                                                               .base_path = api_base_path,
                                                               .cert_path = cert_path,
                                                               .cert_key_path = cert_key_path,
+                                                              .threads = static_cast<size_t>(std::max(threads, 1)),
                                                           });
   return server->Run(running);
 }
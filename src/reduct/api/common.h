@@ -9,12 +9,16 @@
 #include <fmt/format.h>
 #include <google/protobuf/util/json_util.h>
 
+#include <algorithm>
+#include <cctype>
 #include <functional>
+#include <optional>
 #include <string>
 #include <string_view>
 
 #include "reduct/core/error.h"
 #include "reduct/core/result.h"
+#include "reduct/core/time.h"
 
 namespace reduct::api {
 
@@ -26,14 +30,16 @@ using StringMap = std::unordered_map<std::string, std::string>;
 struct HttpResponse {
   StringMap headers;
   size_t content_length;
-  std::function<core::Result<std::string>()> SendData;
+  std::function<core::Result<std::string_view>()> SendData;  // the data is valid until the next call
+  // if set, the response waits until it returns a value, meanwhile it may add headers
+  std::function<std::optional<core::Error>(StringMap* headers)> Ready{};
 
   static HttpResponse Default() {
     return {
         {},
         0,
         []() {
-          return core::Result<std::string>{"", core::Error::kOk};
+          return core::Result<std::string_view>{"", core::Error::kOk};
         },
     };
   }
@@ -65,6 +71,119 @@ std::string PrintToJson(T &&msg) {
   return data;
 }
 
+/**
+ * Parses a UNIX timestamp in microseconds from a request parameter
+ */
+inline core::Result<core::Time> ParseTimestamp(std::string_view timestamp, std::string_view param_name = "ts") {
+  using core::Error;
+  using core::Time;
+
+  auto ts = Time::clock::now();
+  if (timestamp.empty()) {
+    return {Time{}, Error::UnprocessableEntity(fmt::format("'{}' parameter can't be empty", param_name))};
+  }
+  try {
+    auto ts_as_umber = std::stoll(std::string{timestamp});
+    if (ts_as_umber < 0) {
+      return {Time{}, Error::UnprocessableEntity(fmt::format("Failed to parse '{}' parameter: {} must be positive",
+                                                             param_name, std::string{timestamp}))};
+    }
+
+    ts = Time() + std::chrono::microseconds(ts_as_umber);
+    return {ts, Error::kOk};
+  } catch (...) {
+    return {Time{},
+            Error::UnprocessableEntity(fmt::format("Failed to parse '{}' parameter: {} must unix times in microseconds",
+                                                   param_name, std::string{timestamp}))};
+  }
+}
+
+/**
+ * Parses an unsigned integer from a request parameter
+ */
+inline core::Result<uint64_t> ParseUInt(std::string_view timestamp, std::string_view param_name) {
+  using core::Error;
+
+  uint64_t val = 0;
+  if (timestamp.empty()) {
+    return {val, Error::UnprocessableEntity(fmt::format("'{}' parameter can't be empty", param_name))};
+  }
+  try {
+    val = std::stoul(std::string{timestamp});
+    return {val, Error::kOk};
+  } catch (...) {
+    return {val, Error::UnprocessableEntity(fmt::format("Failed to parse '{}' parameter: {} must be unsigned integer",
+                                                        param_name, std::string{timestamp}))};
+  }
+}
+
+/**
+ * Quality of a media type in an Accept header, e.g. "application/x-protobuf, application/json;q=0.5".
+ * It takes the q value of the most specific range matching the type: the type itself, its subtype wildcard
+ * or the full wildcard
+ * @return 1 if the header is empty, 0 if no range matches the type
+ */
+inline double AcceptQuality(std::string_view accept, std::string_view media_type) {
+  auto trim = [](std::string_view str) {
+    while (!str.empty() && (str.front() == ' ' || str.front() == '\t')) str.remove_prefix(1);
+    while (!str.empty() && (str.back() == ' ' || str.back() == '\t')) str.remove_suffix(1);
+    return str;
+  };
+
+  auto iequals = [](std::string_view lhs, std::string_view rhs) {
+    return std::ranges::equal(lhs, rhs, [](char l, char r) { return std::tolower(l) == std::tolower(r); });
+  };
+
+  if (trim(accept).empty()) {
+    return 1.0;
+  }
+
+  const auto media_main_type = media_type.substr(0, media_type.find('/'));
+  int best_specificity = 0;
+  double quality = 0.0;
+  while (!accept.empty()) {
+    const auto comma = accept.find(',');
+    auto media_range = accept.substr(0, comma);
+    accept = comma == std::string_view::npos ? std::string_view{} : accept.substr(comma + 1);
+
+    const auto semicolon = media_range.find(';');
+    const auto range = trim(media_range.substr(0, semicolon));
+
+    int specificity = 0;
+    if (iequals(range, media_type)) {
+      specificity = 3;
+    } else if (range.ends_with("/*") && iequals(range.substr(0, range.size() - 2), media_main_type)) {
+      specificity = 2;
+    } else if (range == "*/*") {
+      specificity = 1;
+    }
+
+    if (specificity <= best_specificity) {
+      continue;
+    }
+
+    double q = 1.0;
+    auto params = semicolon == std::string_view::npos ? std::string_view{} : media_range.substr(semicolon + 1);
+    while (!params.empty()) {
+      const auto next = params.find(';');
+      const auto param = trim(params.substr(0, next));
+      params = next == std::string_view::npos ? std::string_view{} : params.substr(next + 1);
+      if (param.size() > 2 && iequals(param.substr(0, 2), "q=")) {
+        try {
+          q = std::clamp(std::stod(std::string(param.substr(2))), 0.0, 1.0);
+        } catch (...) {
+          q = 1.0;  // ignore a malformed weight
+        }
+      }
+    }
+
+    best_specificity = specificity;
+    quality = q;
+  }
+
+  return quality;
+}
+
 /**
  * Default receiver which does nothing but generate a response
  * @return
@@ -89,7 +208,7 @@ static core::Result<HttpRequestReceiver> SendJson(core::Result<T> &&res) {
                 .content_length = json.size(),
                 .SendData =
                     [json = std::move(json)]() {
-                      return core::Result<std::string>{json, core::Error::kOk};
+                      return core::Result<std::string_view>{json, core::Error::kOk};
                     },
             },
             core::Error::kOk,
@@ -170,7 +289,7 @@ static core::Result<HttpRequestReceiver> ReceiveAndSendJson(std::function<core::
                 .content_length = json.size(),
                 .SendData =
                     [json = std::move(json)]() {
-                      return core::Result<std::string>{json, core::Error::kOk};
+                      return core::Result<std::string_view>{json, core::Error::kOk};
                     },
             },
             Error::kOk,
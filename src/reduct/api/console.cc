@@ -48,7 +48,7 @@ Result<HttpRequestReceiver> Console::UiRequest(const asset::IAssetManager* conso
                 .content_length = content->size(),
                 .SendData =
                     [content]() {
-                      return Result<std::string>{*content, Error::kOk};
+                      return Result<std::string_view>{*content, Error::kOk};
                     },
             },
             Error::kOk,
@@ -5,6 +5,10 @@
 
 #include "reduct/api/entry_api.h"
 
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
 #include "reduct/core/logger.h"
 #include "reduct/proto/api/entry.pb.h"
 #include "reduct/storage/query/quiery.h"
@@ -21,40 +25,65 @@ using storage::IStorage;
 using storage::query::IQuery;
 
 using proto::api::QueryInfo;
+using proto::api::RecordInfoList;
+
+static constexpr uint64_t kDefaultBatchRecords = 100;
+static constexpr uint64_t kMaxBatchRecords = 1'000;  // a larger count is clamped
+static constexpr uint64_t kDefaultBatchSize = 8'000'000;
+static constexpr uint64_t kDefaultListLimit = 10'000;
+static constexpr uint64_t kMaxListLimit = 100'000;  // a larger limit is clamped, so a response fits in memory
+static constexpr std::string_view kProtobufContentType = "application/x-protobuf";
+static constexpr std::string_view kBatchErrorHeaderPrefix = "x-reduct-error-";  // + position of record in batch
+
+/**
+ * Header of a record in a batch
+ */
+inline std::string MakeBatchHeader(const Time& timestamp, size_t size) {
+  return fmt::format("{} {}\n", core::ToMicroseconds(timestamp), size);
+}
 
-inline core::Result<Time> ParseTimestamp(std::string_view timestamp, std::string_view param_name = "ts") {
-  auto ts = Time::clock::now();
-  if (timestamp.empty()) {
-    return {Time{}, Error::UnprocessableEntity(fmt::format("'{}' parameter can't be empty", param_name))};
+/**
+ * Removes data of the bucket in the write path only when the record doesn't fit its quota,
+ * before that the reclaimer of the storage removes it in background
+ * @param bucket another request may remove it meanwhile
+ * @param reserve size of the record
+ */
+inline Error KeepHardQuota(const IBucket::WPtr& bucket, size_t reserve) {
+  auto bucket_ptr = bucket.lock();
+  if (!bucket_ptr) {
+    return Error::NotFound("Bucket is removed");
   }
-  try {
-    auto ts_as_umber = std::stoll(timestamp.data());
-    if (ts_as_umber < 0) {
-      return {Time{}, Error::UnprocessableEntity(fmt::format("Failed to parse '{}' parameter: {} must be positive",
-                                                             param_name, std::string{timestamp}))};
-    }
 
-    ts = Time() + std::chrono::microseconds(ts_as_umber);
-    return {ts, Error::kOk};
-  } catch (...) {
-    return {Time{},
-            Error::UnprocessableEntity(fmt::format("Failed to parse '{}' parameter: {} must unix times in microseconds",
-                                                   param_name, std::string{timestamp}))};
+  if (auto err = bucket_ptr->KeepQuota(reserve)) {
+    LOG_WARNING("Didn't manage to keep quota: {}", err.ToString());
+    return Error::InsufficientStorage(fmt::format("Bucket is full: {}", err.message));
   }
+
+  return Error::kOk;
 }
 
-inline core::Result<uint64_t> ParseUInt(std::string_view timestamp, std::string_view param_name) {
-  uint64_t val = 0;
-  if (timestamp.empty()) {
-    return {val, Error::UnprocessableEntity(fmt::format("'{}' parameter can't be empty", param_name))};
+/**
+ * Parses the mode of reading a record by its timestamp, exact matching if it is empty
+ */
+inline Result<IEntry::ReadMode> ParseReadMode(std::string_view mode) {
+  static const std::unordered_map<std::string_view, IEntry::ReadMode> kModes = {
+      {"exact", IEntry::ReadMode::kExact},
+      {"before", IEntry::ReadMode::kBefore},
+      {"after", IEntry::ReadMode::kAfter},
+      {"nearest", IEntry::ReadMode::kNearest},
+  };
+
+  if (mode.empty()) {
+    return {IEntry::ReadMode::kExact, Error::kOk};
   }
-  try {
-    val = std::stoul(std::string{timestamp});
-    return {val, Error::kOk};
-  } catch (...) {
-    return {val, Error::UnprocessableEntity(fmt::format("Failed to parse '{}' parameter: {} must be unsigned integer",
-                                                        param_name, std::string{timestamp}))};
+
+  if (auto it = kModes.find(mode); it != kModes.end()) {
+    return {it->second, Error::kOk};
   }
+
+  return {IEntry::ReadMode::kExact,
+          Error::UnprocessableEntity(fmt::format(
+              "Failed to parse 'mode' parameter: {} must be exact, before, after or nearest", std::string{mode}))};
 }
 
 inline core::Result<IEntry::SPtr> GetOrCreateEntry(IStorage* storage, const std::string& bucket_name,
@@ -88,12 +117,7 @@ inline core::Result<IEntry::SPtr> GetOrCreateEntry(IStorage* storage, const std:
 
 core::Result<HttpRequestReceiver> EntryApi::Write(storage::IStorage* storage, std::string_view bucket_name,
                                                   std::string_view entry_name, std::string_view timestamp,
-                                                  std::string_view content_length) {
-  auto [entry, create_err] = GetOrCreateEntry(storage, std::string(bucket_name), std::string(entry_name));
-  if (create_err) {
-    return create_err;
-  }
-
+                                                  std::string_view content_length, const async::LabelMap& labels) {
   auto [ts, parse_err] = ParseTimestamp(timestamp);
   if (parse_err) {
     return parse_err;
@@ -109,15 +133,24 @@ core::Result<HttpRequestReceiver> EntryApi::Write(storage::IStorage* storage, st
     return Error::ContentLengthRequired("Bad or empty content-length");
   }
 
-  auto [writer, writer_err] = entry->BeginWrite(ts, size);
-  if (writer_err) {
-    return writer_err;
+  auto [bucket, bucket_err] = storage->GetBucket(std::string(bucket_name));
+  if (bucket_err) {
+    return bucket_err;
+  }
+
+  if (auto quota_err = KeepHardQuota(bucket, size)) {
+    return quota_err;
   }
 
-  auto [bucket, _] = storage->GetBucket(std::string(bucket_name));
-  auto quota_error = bucket.lock()->KeepQuota();
-  if (quota_error) {
-    LOG_WARNING("Didn't mange to keep quota: {}", quota_error.ToString());
+  // the quota may remove the entry with its last block, so we take it after
+  auto [entry, create_err] = GetOrCreateEntry(storage, std::string(bucket_name), std::string(entry_name));
+  if (create_err) {
+    return create_err;
+  }
+
+  auto [writer, writer_err] = entry->BeginWrite(ts, size, labels);
+  if (writer_err) {
+    return writer_err;
   }
 
   return {
@@ -128,6 +161,7 @@ core::Result<HttpRequestReceiver> EntryApi::Write(storage::IStorage* storage, st
         }
 
         if (last) {
+          resp.Ready = [writer](StringMap*) { return writer->sync_result(); };
           return Result<HttpResponse>{resp, Error::kOk};
         }
 
@@ -137,13 +171,207 @@ core::Result<HttpRequestReceiver> EntryApi::Write(storage::IStorage* storage, st
   };
 }
 
+core::Result<HttpRequestReceiver> EntryApi::WriteBatch(storage::IStorage* storage, std::string_view bucket_name,
+                                                       std::string_view content_length) {
+  int64_t body_size;
+  try {
+    body_size = std::stol(content_length.data());
+    if (body_size < 0) {
+      return Error::ContentLengthRequired("Negative content-length");
+    }
+  } catch (...) {
+    return Error::ContentLengthRequired("Bad or empty content-length");
+  }
+
+  auto [bucket, bucket_err] = storage->GetBucket(std::string(bucket_name));
+  if (bucket_err) {
+    return bucket_err;
+  }
+
+  // the body is bigger than its records only by their headers, so one reservation covers the whole batch
+  if (auto quota_err = KeepHardQuota(bucket, body_size)) {
+    return quota_err;
+  }
+
+  // state of the batch between chunks of the body
+  struct Batch {
+    std::string header;                // header of the current record until it is received
+    size_t index{};                    // position of the current record in the batch
+    Time ts;                           // timestamp of the current record
+    size_t left{};                     // bytes of the current record to receive
+    bool in_record{};                  // the header of the current record is received
+    async::IAsyncWriter::SPtr writer;  // writer of the current record, nullptr if the record failed
+    std::unordered_map<std::string, IEntry::SPtr> entries;
+    std::vector<std::pair<size_t, async::IAsyncWriter::SPtr>> pending;  // received records which are being synced
+    std::vector<std::pair<size_t, Error>> results;                     // status of the records by their positions
+
+    /**
+     * Releases the writers of the written records, so that a big batch doesn't keep their files open
+     * @return true if all the records are written
+     */
+    bool ReleaseWritten() {
+      std::erase_if(pending, [this](const auto& record) {
+        auto result = record.second->sync_result();
+        if (result) {
+          results.emplace_back(record.first, std::move(*result));
+        }
+        return result.has_value();
+      });
+      return pending.empty();
+    }
+  };
+
+  auto batch = std::make_shared<Batch>();
+
+  // a bad header breaks the framing of the body, so only it fails the request. A record which can't be written
+  // is skipped and its error is reported in the response
+  auto begin_record = [batch, bucket](std::string_view header) -> Error {
+    std::vector<std::string_view> fields;
+    for (auto rest = header; !rest.empty();) {
+      const auto pos = std::min(rest.find(' '), rest.size());
+      fields.push_back(rest.substr(0, pos));
+      rest.remove_prefix(std::min(pos + 1, rest.size()));
+    }
+
+    if (fields.size() != 3) {
+      return Error::BadRequest(fmt::format("Bad record header '{}' in batch", header));
+    }
+
+    auto [ts, ts_err] = ParseTimestamp(fields[1]);
+    if (ts_err) {
+      return ts_err;
+    }
+
+    auto [size, size_err] = ParseUInt(fields[2], "size");
+    if (size_err) {
+      return size_err;
+    }
+
+    batch->ts = ts;
+    batch->left = size;
+    batch->in_record = true;
+
+    auto open_writer = [&]() -> Result<async::IAsyncWriter::SPtr> {
+      auto bucket_ptr = bucket.lock();
+      if (!bucket_ptr) {
+        return Error::NotFound("Bucket is removed");
+      }
+
+      // take each entry only once, because its name is validated with a regex, unless the reclaimer has removed it
+      const std::string entry_name(fields[0]);
+      auto entry_it = batch->entries.find(entry_name);
+      if (entry_it == batch->entries.end() || !bucket_ptr->HasEntry(entry_name)) {
+        auto [entry, entry_err] = bucket_ptr->GetOrCreateEntry(entry_name);
+        if (entry_err) {
+          return entry_err;
+        }
+
+        entry_it = batch->entries.insert_or_assign(entry_name, entry.lock()).first;
+      }
+
+      return entry_it->second->BeginWrite(ts, size);
+    };
+
+    auto [writer, writer_err] = open_writer();
+    if (writer_err) {
+      batch->results.emplace_back(batch->index, std::move(writer_err));
+    }
+    batch->writer = std::move(writer);
+    return Error::kOk;
+  };
+
+  return {
+      [batch, begin_record](std::string_view chunk, bool last) -> Result<HttpResponse> {
+        auto resp = HttpResponse::Default();
+        while (!chunk.empty() || (batch->in_record && batch->left == 0)) {
+          if (!batch->in_record) {
+            const auto end = chunk.find('\n');
+            batch->header.append(chunk.substr(0, end));
+            if (end == std::string_view::npos) {
+              break;  // the header continues in the next chunk
+            }
+
+            chunk.remove_prefix(end + 1);
+            auto err = begin_record(batch->header);
+            batch->header.clear();
+            if (err) {
+              return {resp, err};
+            }
+            continue;
+          }
+
+          const auto data = chunk.substr(0, batch->left);
+          chunk.remove_prefix(data.size());
+          batch->left -= data.size();
+          if (batch->writer) {
+            if (auto err = batch->writer->Write(data, batch->left == 0)) {
+              batch->results.emplace_back(batch->index, std::move(err));
+              batch->writer.reset();  // the rest of the record is skipped
+            }
+          }
+
+          if (batch->left == 0) {
+            if (batch->writer) {
+              batch->pending.emplace_back(batch->index, std::move(batch->writer));
+              batch->ReleaseWritten();
+            }
+            batch->in_record = false;
+            batch->index++;
+          }
+        }
+
+        if (!last) {
+          return {resp, Error::Continue()};
+        }
+
+        if (batch->in_record) {
+          if (batch->writer) {
+            return {resp, batch->writer->Write({}, true)};  // marks the record as broken
+          }
+          return {resp, Error::BadRequest("Content is smaller than in content-length")};
+        }
+
+        if (!batch->header.empty()) {
+          return {resp, Error::BadRequest(fmt::format("Bad record header '{}' in batch", batch->header))};
+        }
+
+        resp.Ready = [batch](StringMap* headers) -> std::optional<Error> {
+          if (!batch->ReleaseWritten()) {
+            return std::nullopt;
+          }
+
+          for (const auto& [index, result] : batch->results) {
+            if (result) {
+              LOG_WARNING("Failed to write record {} in batch: {}", index, result.ToString());
+              headers->insert_or_assign(fmt::format("{}{}", kBatchErrorHeaderPrefix, index),
+                                        fmt::format("{},{}", result.code, result.message));
+            }
+          }
+          return Error::kOk;
+        };
+        return {resp, Error::kOk};
+      },
+      Error::kOk,
+  };
+}
+
 Result<HttpRequestReceiver> EntryApi::Read(IStorage* storage, std::string_view bucket_name, std::string_view entry_name,
-                                           std::string_view timestamp, std::string_view query_id) {
+                                           std::string_view timestamp, std::string_view query_id,
+                                           std::string_view mode) {
   auto [entry, create_err] = GetOrCreateEntry(storage, std::string(bucket_name), std::string(entry_name), true);
   if (create_err) {
     return create_err;
   }
 
+  auto [read_mode, mode_err] = ParseReadMode(mode);
+  if (mode_err) {
+    return mode_err;
+  }
+
+  if (!mode.empty() && !query_id.empty()) {
+    return Error::UnprocessableEntity("'mode' parameter can't be used with 'q' parameter");
+  }
+
   bool last = true;
   async::IAsyncReader::SPtr reader;
   Error error = Error::kOk;
@@ -160,7 +388,7 @@ Result<HttpRequestReceiver> EntryApi::Read(IStorage* storage, std::string_view b
       ts = Time() + std::chrono::microseconds(entry->GetInfo().latest_record());
     }
 
-    auto [next, start_err] = entry->BeginRead(ts);
+    auto [next, start_err] = entry->BeginRead(ts, read_mode);
     if (start_err) {
       return start_err;
     }
@@ -186,16 +414,21 @@ Result<HttpRequestReceiver> EntryApi::Read(IStorage* storage, std::string_view b
   assert(reader && "Failed to reach reader");
   return {
       [reader, last, error = std::move(error)](std::string_view chunk, bool) -> Result<HttpResponse> {
+        StringMap headers = {{"x-reduct-time", std::to_string(core::ToMicroseconds(reader->timestamp()))},
+                             {"x-reduct-last", std::to_string(static_cast<int>(last))},
+                             {"content-type", "application/octet-stream"}};
+        for (const auto& [name, value] : reader->labels()) {
+          headers.emplace(fmt::format("x-reduct-label-{}", name), value);
+        }
+
         return Result<HttpResponse>{
             HttpResponse{
-                .headers = {{"x-reduct-time", std::to_string(core::ToMicroseconds(reader->timestamp()))},
-                            {"x-reduct-last", std::to_string(static_cast<int>(last))},
-                            {"content-type", "application/octet-stream"}},
+                .headers = std::move(headers),
                 .content_length = reader->size(),
                 .SendData =
                     [reader]() {
                       auto [chunk, err] = reader->Read();
-                      return Result<std::string>{std::move(chunk.data), err};
+                      return Result<std::string_view>{chunk.data, err};
                     },
             },
             Error::kOk,
@@ -206,9 +439,140 @@ Result<HttpRequestReceiver> EntryApi::Read(IStorage* storage, std::string_view b
   };
 }
 
+Result<HttpRequestReceiver> EntryApi::ReadBatch(IStorage* storage, std::string_view bucket_name,
+                                                std::string_view entry_name, std::string_view query_id,
+                                                std::string_view max_records, std::string_view max_size) {
+  auto [entry, create_err] = GetOrCreateEntry(storage, std::string(bucket_name), std::string(entry_name), true);
+  if (create_err) {
+    return create_err;
+  }
+
+  auto [id, parse_err] = ParseUInt(query_id, "id");
+  if (parse_err) {
+    return parse_err;
+  }
+
+  uint64_t records_limit = kDefaultBatchRecords;
+  if (!max_records.empty()) {
+    auto [val, err] = ParseUInt(max_records, "count");
+    if (err) {
+      return err;
+    }
+    records_limit = std::clamp(val, uint64_t{1}, kMaxBatchRecords);
+  }
+
+  uint64_t size_limit = kDefaultBatchSize;
+  if (!max_size.empty()) {
+    auto [val, err] = ParseUInt(max_size, "size");
+    if (err) {
+      return err;
+    }
+    size_limit = val;
+  }
+
+  // records of the batch are sent one by one with their headers. Only the timestamps and sizes are collected
+  // for the content length, a record is opened when it is its turn, so the batch holds one file at most
+  struct Batch {
+    struct Record {
+      Time timestamp;
+      size_t size;
+    };
+
+    IEntry::WPtr entry;
+    std::vector<Record> records;
+    size_t current{};
+    async::IAsyncReader::SPtr reader;
+    std::string header;
+    bool header_sent{};
+  };
+
+  auto batch = std::make_shared<Batch>();
+  batch->entry = entry;
+  bool last = false;
+  size_t content_length = 0;
+  size_t data_size = 0;
+  // the batch ends with the record which reaches the size limit
+  while (!last && batch->records.size() < records_limit && data_size < size_limit) {
+    auto [next, next_err] = entry->Next(id);
+    if (next_err || next_err.code == Error::kNoContent) {
+      if (batch->records.empty()) {
+        if (next_err.code == Error::kNoContent) {
+          return DefaultReceiver(std::move(next_err));
+        }
+        return next_err;
+      }
+
+      // send what we have, the client gets the error with the next batch
+      LOG_WARNING("Batch for query {} is interrupted: {}", id, next_err.ToString());
+      break;
+    }
+
+    const auto size = next.reader->size();
+    const auto timestamp = next.reader->timestamp();
+    content_length += MakeBatchHeader(timestamp, size).size() + size;
+    data_size += size;
+    last = next.last;
+    batch->records.push_back({timestamp, size});
+  }
+
+  return {
+      [batch, last, content_length](std::string_view, bool) -> Result<HttpResponse> {
+        return Result<HttpResponse>{
+            HttpResponse{
+                .headers = {{"x-reduct-count", std::to_string(batch->records.size())},
+                            {"x-reduct-last", std::to_string(static_cast<int>(last))},
+                            {"content-type", "application/octet-stream"}},
+                .content_length = content_length,
+                .SendData =
+                    [batch]() -> Result<std::string_view> {
+                      if (batch->current == batch->records.size()) {
+                        return {"", Error::kOk};
+                      }
+
+                      const auto& record = batch->records[batch->current];
+                      if (!batch->header_sent) {
+                        batch->header = MakeBatchHeader(record.timestamp, record.size);
+                        batch->header_sent = true;
+                        if (record.size == 0) {  // empty record
+                          batch->current++;
+                          batch->header_sent = false;
+                        }
+                        return {batch->header, Error::kOk};
+                      }
+
+                      if (!batch->reader) {
+                        auto entry_ptr = batch->entry.lock();
+                        if (!entry_ptr) {
+                          return {{}, Error::NotFound("Entry is removed")};
+                        }
+
+                        auto [reader, err] = entry_ptr->BeginRead(record.timestamp);
+                        if (err) {
+                          return {{}, std::move(err)};
+                        }
+                        batch->reader = std::move(reader);
+                      }
+
+                      auto [chunk, err] = batch->reader->Read();
+                      if (err == Error::kOk && batch->reader->is_done()) {
+                        batch->reader.reset();
+                        batch->current++;
+                        batch->header_sent = false;
+                      }
+                      return {chunk.data, err};
+                    },
+            },
+            Error::kOk,
+        };
+      },
+      Error::kOk,
+  };
+}
+
 core::Result<HttpRequestReceiver> EntryApi::Query(storage::IStorage* storage, std::string_view bucket_name,
                                                   std::string_view entry_name, std::string_view start_timestamp,
-                                                  std::string_view stop_timestamp, std::string_view ttl_interval) {
+                                                  std::string_view stop_timestamp, std::string_view ttl_interval,
+                                                  const async::LabelMap& include, const async::LabelMap& exclude) {
   auto [entry, err] = GetOrCreateEntry(storage, std::string(bucket_name), std::string(entry_name), true);
   if (err) {
     return err;
@@ -242,7 +606,8 @@ core::Result<HttpRequestReceiver> EntryApi::Query(storage::IStorage* storage, st
     ttl = std::chrono::seconds(val);
   }
 
-  auto [id, query_err] = entry->Query(start_ts, stop_ts, IQuery::Options{.ttl = ttl});
+  auto [id, query_err] =
+      entry->Query(start_ts, stop_ts, IQuery::Options{.ttl = ttl, .include = include, .exclude = exclude});
   if (query_err) {
     return query_err;
   }
@@ -253,4 +618,65 @@ core::Result<HttpRequestReceiver> EntryApi::Query(storage::IStorage* storage, st
   return SendJson(Result<QueryInfo>{std::move(info), Error::kOk});
 }
 
+core::Result<HttpRequestReceiver> EntryApi::List(storage::IStorage* storage, std::string_view bucket_name,
+                                                 std::string_view entry_name, std::string_view start_timestamp,
+                                                 std::string_view stop_timestamp, std::string_view limit,
+                                                 std::string_view accept) {
+  auto [entry, err] = GetOrCreateEntry(storage, std::string(bucket_name), std::string(entry_name), true);
+  if (err) {
+    return err;
+  }
+
+  std::optional<Time> start_ts;
+  if (!start_timestamp.empty()) {
+    auto [ts, parse_err] = ParseTimestamp(start_timestamp, "start");
+    if (parse_err) {
+      return parse_err;
+    }
+    start_ts = ts;
+  }
+
+  std::optional<Time> stop_ts;
+  if (!stop_timestamp.empty()) {
+    auto [ts, parse_err] = ParseTimestamp(stop_timestamp, "stop");
+    if (parse_err) {
+      return parse_err;
+    }
+    stop_ts = ts;
+  }
+
+  uint64_t records_limit = kDefaultListLimit;
+  if (!limit.empty()) {
+    auto [val, parse_err] = ParseUInt(limit, "limit");
+    if (parse_err) {
+      return parse_err;
+    }
+    records_limit = std::clamp(val, uint64_t{1}, kMaxListLimit);
+  }
+
+  auto [list, list_err] = entry->List(start_ts, stop_ts, records_limit);
+  if (list_err) {
+    return list_err;
+  }
+
+  // JSON is the default, so the client must prefer protobuf explicitly
+  if (AcceptQuality(accept, kProtobufContentType) <= AcceptQuality(accept, "application/json")) {
+    return SendJson(Result<RecordInfoList>{std::move(list), Error::kOk});
+  }
+
+  return {
+      [data = list.SerializeAsString()](std::string_view, bool) mutable -> Result<HttpResponse> {
+        return {
+            HttpResponse{
+                .headers = {{"Content-Type", std::string(kProtobufContentType)}},
+                .content_length = data.size(),
+                .SendData = [data = std::move(data)]() { return Result<std::string_view>{data, Error::kOk}; },
+            },
+            Error::kOk,
+        };
+      },
+      Error::kOk,
+  };
+}
+
 }  // namespace reduct::api
@@ -16,24 +16,61 @@ class EntryApi {
  public:
   /**
    * POST /b/:bucket_name/:entry
+   * @param labels labels of the record from the headers x-reduct-label-<name>
    */
   static core::Result<HttpRequestReceiver> Write(storage::IStorage* storage, std::string_view bucket_name,
                                                  std::string_view entry_name, std::string_view timestamp,
-                                                 std::string_view content_length);
+                                                 std::string_view content_length, const async::LabelMap& labels = {});
+
+  /**
+   * POST /b/:bucket_name/batch
+   * Writes many records into entries of a bucket. Each record is prefixed with "<entry> <timestamp> <size>\n".
+   * The quota is kept once for the whole body. A record which fails doesn't stop the batch, its status is sent
+   * in the header x-reduct-error-<position>: <code>,<message>
+   * @param content_length size of the body
+   */
+  static core::Result<HttpRequestReceiver> WriteBatch(storage::IStorage* storage, std::string_view bucket_name,
+                                                      std::string_view content_length);
 
   /**
    * GET /b/:bucket_name/:entry
+   * @param mode how to match the timestamp: exact (default), before, after or nearest
    */
   static core::Result<HttpRequestReceiver> Read(storage::IStorage* storage, std::string_view bucket_name,
                                                 std::string_view entry_name, std::string_view timestamp,
-                                                std::string_view query_id);
+                                                std::string_view query_id, std::string_view mode = {});
+
+  /**
+   * GET /b/:bucket_name/:entry/batch
+   * Streams the next records of a query in one response. Each record is prefixed with "<timestamp> <size>\n"
+   * @param max_records maximal number of records, 100 by default and clamped to 1000
+   */
+  static core::Result<HttpRequestReceiver> ReadBatch(storage::IStorage* storage, std::string_view bucket_name,
+                                                     std::string_view entry_name, std::string_view query_id,
+                                                     std::string_view max_records, std::string_view max_size);
 
   /**
    * GET /b/:bucket/:entry/query
+   * @param include the query takes only records with all these labels (include-<name>=<value>)
+   * @param exclude the query skips records with all these labels (exclude-<name>=<value>)
    */
   static core::Result<HttpRequestReceiver> Query(storage::IStorage* storage, std::string_view bucket_name,
                                                  std::string_view entry_name, std::string_view start_timestamp,
-                                                 std::string_view stop_timestamp, std::string_view ttl_interval);
+                                                 std::string_view stop_timestamp, std::string_view ttl_interval,
+                                                 const async::LabelMap& include = {},
+                                                 const async::LabelMap& exclude = {});
+
+  /**
+   * GET /b/:bucket/:entry/list
+   * Lists timestamps, sizes and states of the records in [start, stop) without reading their data.
+   * The next page starts after the timestamp of the last record in the list
+   * @param limit maximal number of records, 10000 by default and clamped to 100000
+   * @param accept Accept header, binary encoding if it prefers "application/x-protobuf" to "application/json"
+   */
+  static core::Result<HttpRequestReceiver> List(storage::IStorage* storage, std::string_view bucket_name,
+                                                std::string_view entry_name, std::string_view start_timestamp,
+                                                std::string_view stop_timestamp, std::string_view limit,
+                                                std::string_view accept);
 };
 
 }  // namespace reduct::api
@@ -8,15 +8,23 @@
 #include <App.h>
 #include <fmt/format.h>
 
+#include <algorithm>
 #include <filesystem>
+#include <limits>
 #include <regex>
+#include <thread>
+#include <vector>
 
 #include "reduct/api/bucket_api.h"
 #include "reduct/api/console.h"
 #include "reduct/api/entry_api.h"
 #include "reduct/api/server_api.h"
+#include "reduct/api/subscription.h"
 #include "reduct/api/token_api.h"
+#include "reduct/async/event.h"
+#include "reduct/async/run.h"
 #include "reduct/async/sleep.h"
+#include "reduct/async/thread_pool.h"
 #include "reduct/core/logger.h"
 
 namespace reduct::api {
@@ -27,8 +35,10 @@ using google::protobuf::util::JsonStringToMessage;
 using proto::api::BucketSettings;
 
 using asset::IAssetManager;
+using async::Backoff;
 using async::Sleep;
 using async::Task;
+using async::ThreadPoolExecutor;
 using async::VoidTask;
 using auth::ITokenAuthorization;
 using core::Error;
@@ -50,12 +60,11 @@ class HttpServer : public IHttpServer {
         auth_(std::move(components.auth)),
         token_repository_(std::move(components.token_repository)),
         console_(std::move(components.console)),
-        options_(std::move(options)) {}
+        options_(std::move(options)),
+        pool_(std::make_unique<ThreadPoolExecutor>()) {}
 
   [[nodiscard]] int Run(const bool &running) const override {
-    if (options_.cert_path.empty()) {
-      RegisterEndpointsAndRun(uWS::App(), running);
-    } else {
+    if (!options_.cert_path.empty()) {
       auto check_file = [](auto file) {
         if (!fs::exists(file)) {
           LOG_ERROR("File '{}' doesn't exist", file);
@@ -64,53 +73,107 @@ class HttpServer : public IHttpServer {
         return true;
       };
 
-      if (check_file(options_.cert_path) && check_file(options_.cert_key_path)) {
-        RegisterEndpointsAndRun(uWS::SSLApp(uWS::SocketContextOptions{
-                                    .key_file_name = options_.cert_key_path.data(),
-                                    .cert_file_name = options_.cert_path.data(),
-                                }),
-                                running);
-      } else {
+      if (!check_file(options_.cert_path) || !check_file(options_.cert_key_path)) {
         return -1;
       }
     }
 
+    // each thread has its own loop and app listening to the same port, the kernel balances the connections
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < options_.threads; ++i) {
+      threads.emplace_back([this, &running] { RunLoop(running); });
+    }
+
+    RunLoop(running);
+    for (auto &thread : threads) {
+      thread.join();
+    }
+
     return 0;
   }
 
  private:
+  void RunLoop(const bool &running) const {
+    auto loop = async::ILoop::Build();
+    async::ILoop::set_loop(loop.get());
+
+    if (options_.cert_path.empty()) {
+      RegisterEndpointsAndRun(uWS::App(), running);
+    } else {
+      RegisterEndpointsAndRun(uWS::SSLApp(uWS::SocketContextOptions{
+                                  .key_file_name = options_.cert_key_path.data(),
+                                  .cert_file_name = options_.cert_path.data(),
+                              }),
+                              running);
+    }
+  }
+
   template <bool SSL>
   struct AsyncHttpReceiver {
     using Callback = uWS::MoveOnlyFunction<core::Error(std::string_view, bool)>;
-    explicit AsyncHttpReceiver(uWS::HttpResponse<SSL> *res, Callback callback) : finish_{}, error_{}, res_(res) {
-      res->onData([this, callback = std::move(callback)](std::string_view data, bool last) mutable {
+
+    /**
+     * uWS drops the data of a request without a data handler, so the receiver buffers it until Start is called
+     */
+    explicit AsyncHttpReceiver(uWS::HttpResponse<SSL> *res) : finish_{}, aborted_{}, error_{}, res_(res) {
+      res->onData([this](std::string_view data, bool last) {
         LOG_DEBUG("Received chuck {} kB", data.size() / 1024);
-        error_ = callback(data, last);
-        finish_ = last;
+        if (!callback_) {
+          buffer_.append(data);
+          finish_ = last;
+          return;
+        }
+
+        Receive(data, last);
       });
 
       res->onAborted([this] {
         LOG_ERROR("Aborted write operation");
+        aborted_ = true;
         error_ = core::Error::BadRequest("Aborted write operation");
+        received_.Set();
       });
     }
 
-    [[nodiscard]] bool await_ready() const noexcept { return false; }
-
-    void await_suspend(std::coroutine_handle<> h) const noexcept {
-      if (finish_ || error_) {
-        h.resume();
-      } else {
-        async::ILoop::loop().Defer([this, h] { await_suspend(h); });
+    /**
+     * Passes the buffered data and then the received chunks to the callback
+     */
+    void Start(Callback callback) {
+      callback_ = std::move(callback);
+      if (!buffer_.empty() || finish_) {
+        Receive(buffer_, finish_);
+        buffer_ = {};
       }
     }
 
+    [[nodiscard]] bool aborted() const noexcept { return aborted_; }
+
+    [[nodiscard]] bool await_ready() const noexcept { return received_.await_ready(); }
+
+    void await_suspend(std::coroutine_handle<> h) noexcept { received_.await_suspend(h); }
+
     [[nodiscard]] core::Error await_resume() noexcept { return error_; }
 
    private:
+    void Receive(std::string_view data, bool last) {
+      if (error_) {
+        return;
+      }
+
+      error_ = callback_(data, last);
+      finish_ = last;
+      if (finish_ || error_) {
+        received_.Set();
+      }
+    }
+
     bool finish_;
+    bool aborted_;
     core::Error error_;
     uWS::HttpResponse<SSL> *res_;
+    Callback callback_;
+    std::string buffer_;     // data received before the handler is ready
+    async::Event received_;  // onData or onAborted resumes the coroutine without polling
   };
 
   template <bool SSL>
@@ -120,13 +183,91 @@ class HttpServer : public IHttpServer {
     bool running;
   };
 
+  /**
+   * WebSocket subscriber. It may outlive the socket while a pump is deferred
+   */
+  template <bool SSL>
+  struct Subscriber {
+    using SPtr = std::shared_ptr<Subscriber>;
+    using WebSocket = uWS::WebSocket<SSL, true, SPtr>;
+
+    // stop sending records when the socket buffers more bytes and resume when it drains
+    static constexpr size_t kMaxBufferedAmount = 1'000'000;
+
+    // retry a record which is still being read from disk; new records wake the subscriber up themselves
+    static constexpr std::chrono::milliseconds kReadRetryInterval{1};
+
+    ISubscription::UPtr subscription;
+    WebSocket *ws{};  // nullptr if the socket is closed
+
+    static void Pump(const std::weak_ptr<Subscriber> &weak) {
+      auto self = weak.lock();
+      if (!self || !self->ws) {
+        return;
+      }
+
+      auto err = self->subscription->Pump([ws = self->ws](std::string_view message) {
+        ws->send(message, uWS::OpCode::BINARY);
+        return ws->getBufferedAmount() < kMaxBufferedAmount;
+      });
+
+      if (err.code == Error::kContinue) {
+        async::ILoop::loop().Schedule(kReadRetryInterval, [weak] { Pump(weak); });
+      } else if (err) {
+        LOG_WARNING("Close subscription: {}", err.ToString());
+        self->ws->end(1008, err.message);
+      }
+    }
+  };
+
+  template <bool SSL>
+  void Subscribe(uWS::HttpResponse<SSL> *res, uWS::HttpRequest *req, us_socket_context_t *context) const {
+    std::string url(req->getUrl());
+    std::string bucket_name(req->getParameter(0));
+    std::string authorization(req->getHeader("authorization"));
+    if (authorization.empty() && !req->getQuery("token").empty()) {
+      // browsers can't set headers for WebSockets
+      authorization = fmt::format("Bearer {}", req->getQuery("token"));
+    }
+
+    auto SendError = [res, &url](const core::Error &err) {
+      LOG_DEBUG("GET {}: {}", url, err.ToString());
+      res->writeStatus(std::to_string(err.code));
+      res->writeHeader("content-type", "application/json");
+      res->writeHeader("-x-reduct-error", err.message);
+      res->end(fmt::format(R"({{"detail":"{}"}})", err.message));
+    };
+
+    if (auto err = auth_->Check(authorization, *token_repository_, ReadAccess(bucket_name))) {
+      SendError(err);
+      return;
+    }
+
+    auto subscriber = std::make_shared<Subscriber<SSL>>();
+    auto [subscription, err] = ISubscription::Build(
+        storage_.get(), bucket_name, req->getParameter(1), req->getQuery("start"),
+        // writers call it in their threads, so the pump is deferred to the loop of the socket
+        [weak = std::weak_ptr(subscriber), loop = &async::ILoop::loop()] {
+          loop->Defer([weak] { Subscriber<SSL>::Pump(weak); });
+        });
+    if (err) {
+      SendError(err);
+      return;
+    }
+
+    subscriber->subscription = std::move(subscription);
+    res->template upgrade<typename Subscriber<SSL>::SPtr>(
+        std::move(subscriber), req->getHeader("sec-websocket-key"), req->getHeader("sec-websocket-protocol"),
+        req->getHeader("sec-websocket-extensions"), context);
+  }
+
   template <bool SSL>
   VoidTask RegisterEndpoint(const auth::IAuthorizationPolicy &policy, HttpContext<SSL> ctx,
                             std::function<Result<HttpRequestReceiver>()> &&callback) const {
     std::string method(ctx.req->getMethod());
     std::string url{ctx.req->getUrl()};
     auto authorization = ctx.req->getHeader("authorization");
-    auto origin = ctx.req->getHeader("origin");
+    std::string origin(ctx.req->getHeader("origin"));
 
     std::transform(method.begin(), method.end(), method.begin(), [](auto ch) { return std::toupper(ch); });
     ctx.res->onAborted([&method, &url] { LOG_ERROR("{} {}: aborted", method, url); });
@@ -164,24 +305,47 @@ class HttpServer : public IHttpServer {
       co_return;
     }
 
-    auto [receiver, err] = callback();
+    AsyncHttpReceiver<SSL> body(ctx.res);
+
+    // the handler may block on disk, so it runs in the pool and the coroutine resumes in the loop
+    auto [receiver, err] =
+        co_await async::Run<Result<HttpRequestReceiver>, ThreadPoolExecutor>(std::move(callback), pool_.get());
+    if (body.aborted()) {
+      co_return;
+    }
+
     if (err) {
       SendError(err);
       co_return;
     }
 
     HttpResponse response;
-    err = co_await AsyncHttpReceiver<SSL>(ctx.res, [&response, &receiver](auto chunk, bool last) {
+    body.Start([&response, &receiver](auto chunk, bool last) {
       auto [recv_resp, recv_err] = receiver(chunk, last);
       response = std::move(recv_resp);
       return recv_err;
     });
 
+    err = co_await body;
+
     if (err) {
       SendError(err);
       co_return;
     }
 
+    if (response.Ready) {
+      std::optional<Error> ready_err;
+      Backoff backoff;
+      while (!(ready_err = response.Ready(&response.headers))) {
+        co_await backoff.Wait();  // e.g. data is being synced to disk
+      }
+
+      if (*ready_err) {
+        SendError(*ready_err);
+        co_return;
+      }
+    }
+
     ctx.res->writeStatus(std::to_string(err.code));  // If Ok but not 200
     CommonHeaders();
     for (auto &[key, val] : response.headers) {
@@ -189,20 +353,22 @@ class HttpServer : public IHttpServer {
     }
 
     // Send data
-    bool ready_to_continue = false;
-    ctx.res->onWritable([&ready_to_continue](auto _) {
+    async::Event writable;
+    ctx.res->onWritable([&writable](auto _) {
       LOG_DEBUG("ready");
-      ready_to_continue = true;
+      writable.Set();
       return true;
     });
 
     bool aborted = false;
-    ctx.res->onAborted([&aborted] {
+    ctx.res->onAborted([&aborted, &writable] {
       LOG_WARNING("aborted");
       aborted = true;
+      writable.Set();
     });
 
     bool complete = false;
+    Backoff backoff;
     while (!aborted && !complete) {
       co_await Sleep(async::kTick);  // switch context before start to read
       auto [chuck, read_err] = response.SendData();
@@ -211,20 +377,21 @@ class HttpServer : public IHttpServer {
         co_return;
       }
 
+      if (read_err.code == Error::kContinue) {
+        co_await backoff.Wait();  // the data is being read from disk
+        continue;
+      }
+
+      backoff.Reset();
       const auto offset = ctx.res->getWriteOffset();
       while (!aborted) {
-        ready_to_continue = false;
         auto [ok, responded] =
             ctx.res->tryEnd(chuck.substr(ctx.res->getWriteOffset() - offset), response.content_length);
         if (ok) {
           complete = responded;
           break;
         } else {
-          // Have to wait until onWritable sets flag
-          while (!ready_to_continue && !aborted) {
-            co_await Sleep(async::kTick);
-          }
-
+          co_await writable;  // onWritable or onAborted resumes the coroutine
           continue;
         }
       }
@@ -236,9 +403,41 @@ class HttpServer : public IHttpServer {
     co_return;
   }
 
+  /**
+   * Takes labels of a record from the headers x-reduct-label-<name>: <value>
+   */
+  static async::LabelMap ParseLabelHeaders(uWS::HttpRequest *req) {
+    async::LabelMap labels;
+    for (auto [key, value] : *req) {
+      if (key.starts_with(kLabelHeaderPrefix) && key.size() > kLabelHeaderPrefix.size()) {
+        labels.emplace(key.substr(kLabelHeaderPrefix.size()), value);
+      }
+    }
+    return labels;
+  }
+
+  /**
+   * Takes labels from the query parameters <prefix><name>=<value>
+   */
+  static async::LabelMap ParseLabelQuery(uWS::HttpRequest *req, std::string_view prefix) {
+    async::LabelMap labels;
+    for (auto rest = req->getQuery(); !rest.empty();) {
+      const auto param = rest.substr(0, rest.find('&'));
+      rest.remove_prefix(std::min(param.size() + 1, rest.size()));
+
+      const auto name = param.substr(0, param.find('='));
+      if (name.starts_with(prefix) && name.size() > prefix.size()) {
+        labels.emplace(name.substr(prefix.size()), req->getQuery(name));  // the value is URL-decoded
+      }
+    }
+    return labels;
+  }
+
+  constexpr static std::string_view kLabelHeaderPrefix = "x-reduct-label-";
+
   template <bool SSL>
   void RegisterEndpointsAndRun(uWS::TemplatedApp<SSL> &&app, const bool &running) const {
-    auto [host, port, base_path, cert_path, cert_key_path] = options_;
+    auto [host, port, base_path, cert_path, cert_key_path, threads] = options_;
 
     if (!base_path.starts_with('/')) {
       base_path = "/" + base_path;
@@ -248,7 +447,30 @@ class HttpServer : public IHttpServer {
     }
 
     const auto api_path = base_path + "api/v1/";
+    // Subscription API
+    using SubscriberSocket = typename Subscriber<SSL>::WebSocket;
+    app.template ws<typename Subscriber<SSL>::SPtr>(
+        api_path + "b/:bucket_name/:entry_name/ws",
+        {
+            .compression = uWS::DISABLED,
+            .maxPayloadLength = 1024,  // clients send nothing but control frames
+            .idleTimeout = 120,
+            .maxBackpressure = std::numeric_limits<unsigned int>::max(),  // the subscriber pauses itself
+            .upgrade = [this](auto *res, auto *req, auto *context) { Subscribe<SSL>(res, req, context); },
+            .open =
+                [](SubscriberSocket *ws) {
+                  auto &subscriber = *ws->getUserData();
+                  subscriber->ws = ws;
+                  Subscriber<SSL>::Pump(subscriber);  // resumed records
+                },
+            .message = [](SubscriberSocket *ws, std::string_view message, uWS::OpCode op_code) {},
+            .drain = [](SubscriberSocket *ws) { Subscriber<SSL>::Pump(*ws->getUserData()); },
+            .close = [](SubscriberSocket *ws, int code,
+                        std::string_view message) { (*ws->getUserData())->ws = nullptr; },
+        });
+
     // Server API
+    // the handlers run in the pool after uWS has freed the request, so they capture copies of its parameters
     app.head(api_path + "alive",
              [this, running](auto *res, auto *req) {
                RegisterEndpoint(Anonymous(), HttpContext<SSL>{res, req, running},
@@ -266,72 +488,113 @@ class HttpServer : public IHttpServer {
              })
         .get(api_path + "me",
              [this, running](auto *res, auto *req) {
-               RegisterEndpoint(Authenticated(), HttpContext<SSL>{res, req, running}, [this, req]() {
-                 return ServerApi::Me(token_repository_.get(), req->getHeader("authorization"));
-               });
+               RegisterEndpoint(Authenticated(), HttpContext<SSL>{res, req, running},
+                                [this, authorization = std::string(req->getHeader("authorization"))]() {
+                                  return ServerApi::Me(token_repository_.get(), authorization);
+                                });
              })
         // Bucket API
         .post(api_path + "b/:bucket_name",
               [this, running](auto *res, auto *req) {
-                RegisterEndpoint(FullAccess(), HttpContext<SSL>{res, req, running}, [this, req]() {
-                  return BucketApi::CreateBucket(storage_.get(), req->getParameter(0));
-                });
+                RegisterEndpoint(FullAccess(), HttpContext<SSL>{res, req, running},
+                                 [this, bucket_name = std::string(req->getParameter(0))]() {
+                                   return BucketApi::CreateBucket(storage_.get(), bucket_name);
+                                 });
               })
         .get(api_path + "b/:bucket_name",
              [this, running](auto *res, auto *req) {
                std::string bucket_name(req->getParameter(0));
-               RegisterEndpoint(Authenticated(), HttpContext<SSL>{res, req, running}, [this, req, &bucket_name]() {
+               RegisterEndpoint(Authenticated(), HttpContext<SSL>{res, req, running}, [this, bucket_name]() {
                  return BucketApi::GetBucket(storage_.get(), bucket_name);
                });
              })
         .head(api_path + "b/:bucket_name",
               [this, running](auto *res, auto *req) {
                 std::string bucket_name(req->getParameter(0));
-                RegisterEndpoint(Authenticated(), HttpContext<SSL>{res, req, running}, [this, req, &bucket_name]() {
+                RegisterEndpoint(Authenticated(), HttpContext<SSL>{res, req, running}, [this, bucket_name]() {
                   return BucketApi::HeadBucket(storage_.get(), bucket_name);
                 });
               })
         .put(api_path + "b/:bucket_name",
              [this, running](auto *res, auto *req) {
-               RegisterEndpoint(FullAccess(), HttpContext<SSL>{res, req, running}, [this, req]() {
-                 return BucketApi::UpdateBucket(storage_.get(), req->getParameter(0));
-               });
+               RegisterEndpoint(FullAccess(), HttpContext<SSL>{res, req, running},
+                                [this, bucket_name = std::string(req->getParameter(0))]() {
+                                  return BucketApi::UpdateBucket(storage_.get(), bucket_name);
+                                });
              })
         .del(api_path + "b/:bucket_name",
              [this, running](auto *res, auto *req) {
-               RegisterEndpoint(FullAccess(), HttpContext<SSL>{res, req, running}, [this, req]() {
-                 return BucketApi::RemoveBucket(storage_.get(), token_repository_.get(), req->getParameter(0));
-               });
+               RegisterEndpoint(FullAccess(), HttpContext<SSL>{res, req, running},
+                                [this, bucket_name = std::string(req->getParameter(0))]() {
+                                  return BucketApi::RemoveBucket(storage_.get(), token_repository_.get(), bucket_name);
+                                });
              })
         // Entry API
+        .post(api_path + "b/:bucket_name/batch",
+              [this, running](auto *res, auto *req) {
+                std::string bucket_name(req->getParameter(0));
+                RegisterEndpoint(WriteAccess(bucket_name), HttpContext<SSL>{res, req, running},
+                                 [this, bucket_name, content_length = std::string(req->getHeader("content-length"))]() {
+                                   return EntryApi::WriteBatch(storage_.get(), bucket_name, content_length);
+                                 });
+              })
         .post(api_path + "b/:bucket_name/:entry_name",
               [this, running](auto *res, auto *req) {
                 std::string bucket_name(req->getParameter(0));
                 RegisterEndpoint(WriteAccess(bucket_name), HttpContext<SSL>{res, req, running},
-                                 [this, req, &bucket_name]() {
-                                   return EntryApi::Write(storage_.get(), bucket_name, req->getParameter(1),
-                                                          req->getQuery("ts"), req->getHeader("content-length"));
+                                 [this, bucket_name, entry_name = std::string(req->getParameter(1)),
+                                  ts = std::string(req->getQuery("ts")),
+                                  content_length = std::string(req->getHeader("content-length")),
+                                  labels = ParseLabelHeaders(req)]() {
+                                   return EntryApi::Write(storage_.get(), bucket_name, entry_name, ts, content_length,
+                                                          labels);
                                  });
               })
         .get(api_path + "b/:bucket_name/:entry_name",
              [this, running](auto *res, auto *req) {
                std::string bucket_name(req->getParameter(0));
-
                RegisterEndpoint(ReadAccess(bucket_name), HttpContext<SSL>{res, req, running},
-                                [this, req, &bucket_name]() {
-                                  return EntryApi::Read(storage_.get(), bucket_name, req->getParameter(1),
-                                                        req->getQuery("ts"), req->getQuery("q"));
+                                [this, bucket_name, entry_name = std::string(req->getParameter(1)),
+                                 ts = std::string(req->getQuery("ts")), query_id = std::string(req->getQuery("q")),
+                                 mode = std::string(req->getQuery("mode"))]() {
+                                  return EntryApi::Read(storage_.get(), bucket_name, entry_name, ts, query_id, mode);
+                                });
+             })
+        .get(api_path + "b/:bucket_name/:entry_name/batch",
+             [this, running](auto *res, auto *req) {
+               std::string bucket_name(req->getParameter(0));
+               RegisterEndpoint(ReadAccess(bucket_name), HttpContext<SSL>{res, req, running},
+                                [this, bucket_name, entry_name = std::string(req->getParameter(1)),
+                                 query_id = std::string(req->getQuery("q")),
+                                 count = std::string(req->getQuery("count")),
+                                 size = std::string(req->getQuery("size"))]() {
+                                  return EntryApi::ReadBatch(storage_.get(), bucket_name, entry_name, query_id, count,
+                                                             size);
                                 });
              })
         .get(api_path + "b/:bucket_name/:entry_name/q",
              [this, running](auto *res, auto *req) {
                std::string bucket_name(req->getParameter(0));
-               RegisterEndpoint(
-                   ReadAccess(bucket_name), HttpContext<SSL>{res, req, running}, [this, req, bucket_name]() {
-                     return EntryApi::Query(storage_.get(), bucket_name, std::string(req->getParameter(1)),
-                                            std::string(req->getQuery("start")), std::string(req->getQuery("stop")),
-                                            std::string(req->getQuery("ttl")));
-                   });
+               RegisterEndpoint(ReadAccess(bucket_name), HttpContext<SSL>{res, req, running},
+                                [this, bucket_name, entry_name = std::string(req->getParameter(1)),
+                                 start = std::string(req->getQuery("start")), stop = std::string(req->getQuery("stop")),
+                                 ttl = std::string(req->getQuery("ttl")), include = ParseLabelQuery(req, "include-"),
+                                 exclude = ParseLabelQuery(req, "exclude-")]() {
+                                  return EntryApi::Query(storage_.get(), bucket_name, entry_name, start, stop, ttl,
+                                                         include, exclude);
+                                });
+             })
+        .get(api_path + "b/:bucket_name/:entry_name/list",
+             [this, running](auto *res, auto *req) {
+               std::string bucket_name(req->getParameter(0));
+               RegisterEndpoint(ReadAccess(bucket_name), HttpContext<SSL>{res, req, running},
+                                [this, bucket_name, entry_name = std::string(req->getParameter(1)),
+                                 start = std::string(req->getQuery("start")), stop = std::string(req->getQuery("stop")),
+                                 limit = std::string(req->getQuery("limit")),
+                                 accept = std::string(req->getHeader("accept"))]() {
+                                  return EntryApi::List(storage_.get(), bucket_name, entry_name, start, stop, limit,
+                                                        accept);
+                                });
              })
         // Token API
         .get(api_path + "tokens",
@@ -341,21 +604,24 @@ class HttpServer : public IHttpServer {
              })
         .get(api_path + "tokens/:token_id",
              [this, running](auto *res, auto *req) {
-               RegisterEndpoint(FullAccess(), HttpContext<SSL>{res, req, running}, [this, req]() {
-                 return TokenApi::GetToken(token_repository_.get(), req->getParameter(0));
-               });
+               RegisterEndpoint(FullAccess(), HttpContext<SSL>{res, req, running},
+                                [this, token_name = std::string(req->getParameter(0))]() {
+                                  return TokenApi::GetToken(token_repository_.get(), token_name);
+                                });
              })
         .post(api_path + "tokens/:token_id",
               [this, running](auto *res, auto *req) {
-                RegisterEndpoint(FullAccess(), HttpContext<SSL>{res, req, running}, [this, req]() {
-                  return TokenApi::CreateToken(token_repository_.get(), storage_.get(), req->getParameter(0));
-                });
+                RegisterEndpoint(FullAccess(), HttpContext<SSL>{res, req, running},
+                                 [this, token_name = std::string(req->getParameter(0))]() {
+                                   return TokenApi::CreateToken(token_repository_.get(), storage_.get(), token_name);
+                                 });
               })
         .del(api_path + "tokens/:token_id",
              [this, running](auto *res, auto *req) {
-               RegisterEndpoint(FullAccess(), HttpContext<SSL>{res, req, running}, [this, req]() {
-                 return TokenApi::RemoveToken(token_repository_.get(), req->getParameter(0));
-               });
+               RegisterEndpoint(FullAccess(), HttpContext<SSL>{res, req, running},
+                                [this, token_name = std::string(req->getParameter(0))]() {
+                                  return TokenApi::RemoveToken(token_repository_.get(), token_name);
+                                });
              })
         .get(base_path,
              [base_path](auto *res, auto *req) {
@@ -371,13 +637,15 @@ class HttpServer : public IHttpServer {
                if (path.empty()) {
                  path = "index.html";
                }
-               RegisterEndpoint(Anonymous(), HttpContext<SSL>{res, req, running},
-                                [&]() { return Console::UiRequest(console_.get(), base_path, path); });
+               RegisterEndpoint(Anonymous(), HttpContext<SSL>{res, req, running}, [this, base_path, path]() {
+                 return Console::UiRequest(console_.get(), base_path, path);
+               });
              })
         .get(base_path + "ui",
              [this, base_path, running](auto *res, auto *req) {
-               RegisterEndpoint(Anonymous(), HttpContext<SSL>{res, req, running},
-                                [&]() { return Console::UiRequest(console_.get(), base_path, "index.html"); });
+               RegisterEndpoint(Anonymous(), HttpContext<SSL>{res, req, running}, [this, base_path]() {
+                 return Console::UiRequest(console_.get(), base_path, "index.html");
+               });
              })
         .any("/*",
              [this, running](auto *res, auto *req) {
@@ -413,6 +681,7 @@ class HttpServer : public IHttpServer {
   std::unique_ptr<ITokenAuthorization> auth_;
   std::unique_ptr<auth::ITokenRepository> token_repository_;
   std::unique_ptr<IAssetManager> console_;
+  std::unique_ptr<ThreadPoolExecutor> pool_;  // runs the handlers, they may block on disk
 };
 
 std::unique_ptr<IHttpServer> IHttpServer::Build(Components components, Options options) {
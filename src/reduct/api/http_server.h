@@ -40,6 +40,7 @@ class IHttpServer {
     std::string base_path;
     std::string cert_path;
     std::string cert_key_path;
+    size_t threads = 1;  // number of event loops serving the port
   };
 
   /**
@@ -0,0 +1,187 @@
+// Copyright 2023 ReductStore
+// This Source Code Form is subject to the terms of the Mozilla Public
+//    License, v. 2.0. If a copy of the MPL was not distributed with this
+//    file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#include "reduct/api/subscription.h"
+
+#include <fmt/core.h>
+
+#include <deque>
+#include <mutex>
+#include <optional>
+
+#include "reduct/api/common.h"
+#include "reduct/core/logger.h"
+
+namespace reduct::api {
+
+using core::Error;
+using core::Result;
+using core::Time;
+using storage::IEntry;
+using storage::query::IQuery;
+
+class Subscription : public ISubscription {
+ public:
+  // the query of the resumed records must live while the client is paused
+  static constexpr std::chrono::seconds kQueryTtl{60};
+
+  Subscription(IEntry::SPtr entry, std::optional<uint64_t> query_id, OnRecord on_record)
+      : entry_(entry), query_id_(query_id), overflow_{} {
+    subscription_id_ = entry->Subscribe([this, on_record = std::move(on_record)](const Time& ts) {
+      {
+        std::lock_guard lock(mutex_);
+        if (pending_.size() >= kMaxPendingRecords) {
+          overflow_ = true;
+        } else {
+          pending_.push_back(ts);
+        }
+      }
+
+      on_record();
+    });
+  }
+
+  ~Subscription() override {
+    if (auto entry = entry_.lock()) {
+      entry->Unsubscribe(subscription_id_);
+    }
+  }
+
+  Error Pump(const Send& send) override {
+    if (std::lock_guard lock(mutex_); overflow_) {
+      return {.code = Error::kServiceUnavailable, .message = "Subscriber is too slow"};
+    }
+
+    auto entry = entry_.lock();
+    if (!entry) {
+      return Error::NotFound("Entry is removed");
+    }
+
+    while (true) {
+      if (!reader_) {
+        reader_ = NextReader(entry.get());
+        if (!reader_) {
+          return Error::kOk;  // nothing to send
+        }
+
+        message_ = fmt::format("{} {}\n", core::ToMicroseconds(reader_->timestamp()), reader_->size());
+      }
+
+      while (!reader_->is_done()) {
+        auto [chunk, err] = reader_->Read();
+        if (err.code == Error::kContinue) {
+          return err;
+        }
+
+        if (err) {
+          LOG_ERROR("Failed to read record {} for subscriber: {}", core::ToMicroseconds(reader_->timestamp()),
+                    err.ToString());
+          break;
+        }
+
+        message_.append(chunk.data);
+      }
+
+      const auto complete = reader_->is_done();
+      reader_.reset();
+      if (complete && !send(message_)) {
+        return Error::kOk;  // wait until the client drains the data
+      }
+    }
+  }
+
+ private:
+  /**
+   * Takes the next record from the resumed query and then from the finished records
+   * @return nullptr if there is nothing to send
+   */
+  async::IAsyncReader::SPtr NextReader(IEntry* entry) {
+    if (query_id_) {
+      auto [next, err] = entry->Next(*query_id_);
+      if (err == Error::kOk) {
+        last_resumed_ = next.reader->timestamp();
+        if (next.last) {
+          query_id_.reset();
+        }
+        return next.reader;
+      }
+
+      query_id_.reset();
+    }
+
+    while (auto ts = PopPending()) {
+      if (last_resumed_ && *ts <= *last_resumed_) {
+        continue;  // the query has sent it
+      }
+
+      auto [reader, err] = entry->BeginRead(*ts);
+      if (err) {
+        LOG_WARNING("Failed to read record {} for subscriber: {}", core::ToMicroseconds(*ts), err.ToString());
+        continue;
+      }
+
+      return reader;
+    }
+
+    return nullptr;
+  }
+
+  /**
+   * Takes a finished record from the queue
+   * We don't keep the lock while reading the entry, because the entry notifies us under its own lock
+   */
+  std::optional<Time> PopPending() {
+    std::lock_guard lock(mutex_);
+    if (pending_.empty()) {
+      return std::nullopt;
+    }
+
+    const auto ts = pending_.front();
+    pending_.pop_front();
+    return ts;
+  }
+
+  IEntry::WPtr entry_;
+  uint64_t subscription_id_;
+  std::optional<uint64_t> query_id_;
+  std::optional<Time> last_resumed_;
+  std::deque<Time> pending_;
+  bool overflow_;
+  std::mutex mutex_;  // writers may finish records on other threads
+  async::IAsyncReader::SPtr reader_;
+  std::string message_;
+};
+
+Result<ISubscription::UPtr> ISubscription::Build(storage::IStorage* storage, std::string_view bucket_name,
+                                                 std::string_view entry_name, std::string_view start_timestamp,
+                                                 OnRecord on_record) {
+  auto [bucket, bucket_err] = storage->GetBucket(std::string(bucket_name));
+  if (bucket_err) {
+    return bucket_err;
+  }
+
+  auto [entry, entry_err] = bucket.lock()->GetEntry(std::string(entry_name));
+  if (entry_err) {
+    return entry_err;
+  }
+
+  std::optional<uint64_t> query_id;
+  if (!start_timestamp.empty()) {
+    auto [start, parse_err] = ParseTimestamp(start_timestamp, "start");
+    if (parse_err) {
+      return parse_err;
+    }
+
+    auto [id, query_err] = entry.lock()->Query(start, {}, IQuery::Options{.ttl = Subscription::kQueryTtl});
+    if (query_err) {
+      return query_err;
+    }
+    query_id = id;
+  }
+
+  return {std::make_unique<Subscription>(entry.lock(), query_id, std::move(on_record)), Error::kOk};
+}
+
+}  // namespace reduct::api
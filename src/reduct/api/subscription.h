@@ -0,0 +1,67 @@
+// Copyright 2023 ReductStore
+// This Source Code Form is subject to the terms of the Mozilla Public
+//    License, v. 2.0. If a copy of the MPL was not distributed with this
+//    file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#ifndef REDUCT_API_SUBSCRIPTION_H
+#define REDUCT_API_SUBSCRIPTION_H
+
+#include <functional>
+#include <memory>
+#include <string_view>
+
+#include "reduct/core/error.h"
+#include "reduct/core/result.h"
+#include "reduct/storage/storage.h"
+
+namespace reduct::api {
+
+/**
+ * @brief Subscription of a WebSocket client to records of an entry
+ * It collects finished records and sends them to the client in messages "<timestamp> <size>\n<content>"
+ * as fast as the client takes them.
+ */
+class ISubscription {
+ public:
+  using UPtr = std::unique_ptr<ISubscription>;
+
+  /**
+   * Sends a message to the client
+   * @return false if the client has backpressure and we should wait before sending more
+   */
+  using Send = std::function<bool(std::string_view)>;
+
+  /**
+   * Is called when a new record is ready to send
+   */
+  using OnRecord = std::function<void()>;
+
+  static constexpr size_t kMaxPendingRecords = 1024;
+
+  virtual ~ISubscription() = default;
+
+  /**
+   * @brief Sends pending records until the client has backpressure
+   * @param send
+   * @return Error::Continue if a record is being read and the caller should pump again a bit later,
+   * an error if the client is too slow and should be closed
+   */
+  virtual core::Error Pump(const Send& send) = 0;
+
+  /**
+   * @brief Subscribes to the entry
+   * GET /b/:bucket_name/:entry_name/ws
+   * @param storage
+   * @param bucket_name
+   * @param entry_name
+   * @param start_timestamp if it is set, the records from this timestamp are sent first
+   * @param on_record
+   * @return
+   */
+  static core::Result<UPtr> Build(storage::IStorage* storage, std::string_view bucket_name,
+                                  std::string_view entry_name, std::string_view start_timestamp, OnRecord on_record);
+};
+
+}  // namespace reduct::api
+
+#endif  // REDUCT_API_SUBSCRIPTION_H
@@ -0,0 +1,50 @@
+// Copyright 2023 ReductStore
+// This Source Code Form is subject to the terms of the Mozilla Public
+//    License, v. 2.0. If a copy of the MPL was not distributed with this
+//    file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#ifndef REDUCT_ASYNC_EVENT_H
+#define REDUCT_ASYNC_EVENT_H
+
+#include <coroutine>
+#include <utility>
+
+#include "reduct/async/task.h"
+
+namespace reduct::async {
+
+/**
+ * Awaitable flag which resumes the waiting coroutine as soon as it is set.
+ * It is reset when the coroutine is resumed.
+ * @note it isn't thread safe, set it in the thread of the loop (e.g. in callbacks of uWS)
+ */
+class Event {
+ public:
+  [[nodiscard]] bool await_ready() const noexcept { return set_; }
+
+  template <typename Promise>
+  void await_suspend(std::coroutine_handle<Promise> h) noexcept {
+    MarkResumedByEvent(h);
+    handle_ = h;
+  }
+
+  void await_resume() noexcept { set_ = false; }
+
+  /**
+   * Sets the flag and resumes the waiting coroutine in place
+   * @note the coroutine may destroy the event before the method returns
+   */
+  void Set() noexcept {
+    set_ = true;
+    if (auto h = std::exchange(handle_, {})) {
+      h.resume();
+    }
+  }
+
+ private:
+  bool set_{};
+  std::coroutine_handle<> handle_;
+};
+
+}  // namespace reduct::async
+#endif  // REDUCT_ASYNC_EVENT_H
@@ -6,7 +6,11 @@
 #ifndef REDUCT_STORAGE_IO_H
 #define REDUCT_STORAGE_IO_H
 
+#include <map>
 #include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
 
 #include "reduct/core/error.h"
 #include "reduct/core/result.h"
@@ -14,6 +18,11 @@
 
 namespace reduct::async {
 
+/**
+ * Labels of a record: names and values
+ */
+using LabelMap = std::map<std::string, std::string>;
+
 /**
  * @brief Represents an async writer which takes chunks from the loop and write them into a data block
  */
@@ -25,6 +34,12 @@ class IAsyncWriter {
   virtual ~IAsyncWriter() = default;
   virtual core::Error Write(std::string_view chunk, bool last = true) noexcept = 0;
   [[nodiscard]] virtual bool is_done() const noexcept = 0;
+
+  /**
+   * @brief Result of writing the data to disk
+   * @return std::nullopt if the data is still being written or synced
+   */
+  [[nodiscard]] virtual std::optional<core::Error> sync_result() noexcept = 0;
 };
 
 /**
@@ -38,7 +53,7 @@ class IAsyncReader {
   using SPtr = std::shared_ptr<IAsyncReader>;
 
   struct DataChunk {
-    std::string data;
+    std::string_view data;  // valid until the next reading or the reader is destroyed
     bool last;
 
     std::strong_ordering operator<=>(const DataChunk&) const = default;
@@ -49,6 +64,7 @@ class IAsyncReader {
   [[nodiscard]] virtual bool is_done() const noexcept = 0;
   [[nodiscard]] virtual core::Time timestamp() const noexcept = 0;
   [[nodiscard]] virtual size_t size() const noexcept = 0;
+  [[nodiscard]] virtual const LabelMap& labels() const noexcept = 0;
 };
 
 }  // namespace reduct::async
@@ -5,12 +5,50 @@
 
 #include "reduct/async/loop.h"
 
+#include <uWebSockets/Loop.h>
+
 namespace reduct::async {
 
-ILoop* ILoop::loop_ = nullptr;
+thread_local ILoop* ILoop::loop_ = nullptr;
 
 void ILoop::set_loop(ILoop* new_loop) { loop_ = new_loop; }
 
 ILoop& ILoop::loop() { return *loop_; }
 
+bool ILoop::has_loop() { return loop_ != nullptr; }
+
+class Loop : public ILoop {
+ public:
+  // keep the loop of the thread because uWS::Loop::get() creates a new loop in other threads
+  Loop() : uws_loop_(uWS::Loop::get()) {}
+
+  void Defer(Task&& task) override { uws_loop_->defer(std::move(task)); }
+
+  void Schedule(std::chrono::microseconds delay, Task&& task) override {
+    const auto ms = std::chrono::ceil<std::chrono::milliseconds>(delay).count();
+    if (delay < std::chrono::milliseconds(1)) {
+      Defer(std::move(task));
+      return;
+    }
+
+    // the timer owns the task until it fires once
+    auto* timer = us_create_timer(reinterpret_cast<us_loop_t*>(uws_loop_), 0, sizeof(Task*));
+    *static_cast<Task**>(us_timer_ext(timer)) = new Task(std::move(task));
+    us_timer_set(
+        timer,
+        [](us_timer_t* fired) {
+          auto* fired_task = *static_cast<Task**>(us_timer_ext(fired));
+          us_timer_close(fired);
+          (*fired_task)();
+          delete fired_task;
+        },
+        static_cast<int>(ms), 0);
+  }
+
+ private:
+  uWS::Loop* uws_loop_;
+};
+
+std::unique_ptr<ILoop> ILoop::Build() { return std::make_unique<Loop>(); }
+
 }  // namespace reduct::async
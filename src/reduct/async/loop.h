@@ -10,6 +10,8 @@
 
 #include <chrono>
 #include <functional>
+#include <memory>
+
 namespace reduct::async {
 
 static const std::chrono::microseconds kTick{10};
@@ -18,13 +20,48 @@ class ILoop {
  public:
   using Task = uWS::MoveOnlyFunction<void()>;
 
+  virtual ~ILoop() = default;
+
+  /**
+   * Runs a task in the next iteration of the loop
+   * @note thread safe
+   * @param task
+   */
   virtual void Defer(Task&& task) = 0;
 
+  /**
+   * Runs a task after a delay without polling the loop.
+   * Delays shorter than the resolution of the timers (1 ms) are deferred to the next iteration
+   * @note it must be called in the thread of the loop
+   * @param delay
+   * @param task
+   */
+  virtual void Schedule(std::chrono::microseconds delay, Task&& task) = 0;
+
+  /**
+   * Sets the loop of the current thread. Each thread which serves HTTP requests has its own loop
+   */
   static void set_loop(ILoop*);
+
+  /**
+   * @return the loop of the current thread
+   * @note threads without loop (e.g. workers of an executor) must capture the loop of the caller to resume it
+   */
   static ILoop& loop();
 
+  /**
+   * @return true if the current thread has a loop
+   */
+  static bool has_loop();
+
+  /**
+   * Builds a loop on the uWebSockets loop of the current thread
+   * @return
+   */
+  static std::unique_ptr<ILoop> Build();
+
  private:
-  static ILoop* loop_;
+  static thread_local ILoop* loop_;
 };
 }  // namespace reduct::async
 #endif  // REDUCT_STORAGE_LOOP_H
@@ -11,96 +11,113 @@
 #include <future>
 
 #include "reduct/async/executors.h"
+#include "reduct/async/sleep.h"
 #include "reduct/async/task.h"
 
 namespace reduct::async {
 
 /**
  * Push a task to an executor
- * by default use LoopExecutor so it defers the tasks thread safely
+ * by default use LoopExecutor so it defers the tasks thread safely.
+ * The executor resumes the coroutine through the loop when the task is done, so nothing polls the task
  * @tparam T
  * @tparam Executor
  */
 template <typename T, typename Executor = LoopExecutor<T>>
 struct Run {
-  using Us = std::chrono::microseconds;
+  Run(std::function<T()>&& task, Executor* executor) : executor_(executor), func_(std::move(task)) {}
+  explicit Run(std::function<T()>&& task) : executor_{}, func_(std::move(task)) {}
 
-  Run(std::function<T()>&& task, Executor* executor) { task_ = executor->Commit(std::move(task)); }
-  explicit Run(std::function<T()>&& task) { task_ = LoopExecutor<T>().Commit(std::move(task)); }
+  constexpr bool await_ready() const noexcept { return false; }
 
-  bool await_ready() const noexcept { return CheckTask(); }
+  template <typename Promise>
+  void await_suspend(std::coroutine_handle<Promise> h) noexcept {
+    MarkResumedByEvent(h);
+    auto wrapper = [this, h, loop = &ILoop::loop()]() -> T {
+      T result = func_();
+      result_ = result;
+      // the awaiter may be destroyed after resuming, don't touch it below
+      loop->Defer([h] {
+        LOG_TRACE("Resume {}", h.address());
+        h.resume();
+      });
+      return result;
+    };
 
-  void await_suspend(std::coroutine_handle<> h) const noexcept {
-    if (CheckTask()) {
-      LOG_TRACE("Resume {}", *(int*)h.address());
-      h.resume();
+    if (executor_ != nullptr) {
+      executor_->Commit(std::move(wrapper));
     } else {
-      LOG_TRACE("Deffer {}", *(int*)h.address());
-      ILoop::loop().Defer([this, h] { await_suspend(h); });
+      LoopExecutor<T>().Commit(std::move(wrapper));
     }
   }
 
-  T await_resume() noexcept { return task_.get(); }
+  T await_resume() noexcept { return std::move(*result_); }
 
  private:
   Run() = default;
-  inline bool CheckTask() const { return task_.wait_for(Us(10)) == std::future_status::ready; }
-  std::future<T> task_;
+
+  Executor* executor_;
+  std::function<T()> func_;
+  std::optional<T> result_;
 };
 
 /**
  * Push a periodical task to an executor
- * by default use LoopExecutor so it defers the tasks thread safely
+ * by default use LoopExecutor so it defers the tasks thread safely.
+ * The task is committed again by a timer of the loop until it returns a value. The delay grows with Backoff,
+ * so a pending task doesn't spin the loop
  * @tparam T
  * @tparam Executor
  */
 template <typename T, typename Executor = LoopExecutor<std::optional<T>>>
 struct RunUntil {
-  using Us = std::chrono::microseconds;
+  RunUntil(std::function<std::optional<T>()>&& task, Executor* executor)
+      : executor_(executor), func_(std::move(task)) {}
 
-  RunUntil(std::function<std::optional<T>()>&& task, Executor* executor) : executor_(executor), func_(std::move(task)) {
-    task_ = executor_->Commit(func_);
-  }
+  explicit RunUntil(std::function<std::optional<T>()>&& task) : executor_{}, func_(std::move(task)) {}
+
+  constexpr bool await_ready() const noexcept { return false; }
 
-  explicit RunUntil(std::function<std::optional<T>()>&& task) : executor_{}, func_(std::move(task)) {
-    task_ = LoopExecutor<std::optional<T>>().Commit(func_);
+  template <typename Promise>
+  void await_suspend(std::coroutine_handle<Promise> h) noexcept {
+    MarkResumedByEvent(h);
+    loop_ = &ILoop::loop();  // the executor may run the task in a thread without loop
+    Commit(h);
   }
 
-  constexpr bool await_ready() const noexcept { return false; }
+  T await_resume() noexcept { return *result_; }
 
-  void await_suspend(std::coroutine_handle<> h) noexcept {
-    if (CheckTask()) {
-      LOG_TRACE("Resume {}", *(int*)h.address());
-      result_ = task_.get();
-      if (result_) {
-        h.resume();
+ private:
+  RunUntil() = default;
+
+  void Commit(std::coroutine_handle<> h) {
+    auto wrapper = [this, h]() -> std::optional<T> {
+      auto result = func_();
+      if (result) {
+        result_ = result;
+        loop_->Defer([h] {
+          LOG_TRACE("Resume {}", h.address());
+          h.resume();
+        });
       } else {
-        // if result is nullopt, repeat task
-        if (executor_ != nullptr) {
-          task_ = executor_->Commit(func_);
-        } else {
-          task_ = LoopExecutor<std::optional<T>>().Commit(func_);
-        }
-
-        ILoop::loop().Defer([this, h] { await_suspend(h); });
+        // if result is nullopt, repeat task after a delay. Timers must be set in the thread of the loop
+        loop_->Defer([this, h] { loop_->Schedule(backoff_.Next(), [this, h] { Commit(h); }); });
       }
+      return result;
+    };
 
+    if (executor_ != nullptr) {
+      executor_->Commit(std::move(wrapper));
     } else {
-      LOG_TRACE("Deffer {}", *(int*)h.address());
-      ILoop::loop().Defer([this, h] { await_suspend(h); });
+      LoopExecutor<std::optional<T>>().Commit(std::move(wrapper));
     }
   }
 
-  T await_resume() noexcept { return *result_; }
-
- private:
-  RunUntil() = default;
-  inline bool CheckTask() const { return task_.wait_for(Us(10)) == std::future_status::ready; }
-
-  std::future<std::optional<T>> task_;
   std::optional<T> result_;
   Executor* executor_;
   std::function<std::optional<T>()> func_;
+  ILoop* loop_{};
+  Backoff backoff_;
 };
 
 }  // namespace reduct::async
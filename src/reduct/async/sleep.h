@@ -6,6 +6,7 @@
 #ifndef REDUCT_ASYNC_SLEEP_H
 #define REDUCT_ASYNC_SLEEP_H
 
+#include <algorithm>
 #include <chrono>
 #include <coroutine>
 #include <future>
@@ -15,18 +16,24 @@
 
 namespace reduct::async {
 
+static const std::chrono::microseconds kMaxBackoff{1000};
+
+/**
+ * Suspends the coroutine and resumes it by a timer of the loop
+ * @tparam R
+ * @tparam P
+ */
 template <typename R, typename P>
 struct Sleep {
   explicit Sleep(std::chrono::duration<R, P> delay) : delay_{delay}, start_{std::chrono::steady_clock::now()} {}
 
   bool await_ready() const noexcept { return decltype(start_)::clock::now() - start_ > delay_; }
 
-  void await_suspend(std::coroutine_handle<> h) const noexcept {
-    if (decltype(start_)::clock::now() - start_ > delay_) {
-      h.resume();
-    } else {
-      ILoop::loop().Defer([this, h] { await_suspend(h); });
-    }
+  template <typename Promise>
+  void await_suspend(std::coroutine_handle<Promise> h) const noexcept {
+    MarkResumedByEvent(h);
+    const auto remaining = delay_ - (decltype(start_)::clock::now() - start_);
+    ILoop::loop().Schedule(std::chrono::ceil<std::chrono::microseconds>(remaining), [h] { h.resume(); });
   }
 
   void await_resume() const noexcept {}
@@ -36,5 +43,39 @@ struct Sleep {
   std::chrono::time_point<std::chrono::steady_clock> start_;
 };
 
+/**
+ * Exponential backoff for operations which can be only polled (e.g. syncing or reading data in another thread).
+ * The delay starts with kTick and doubles up to the max delay, so a long operation doesn't spin the loop
+ */
+class Backoff {
+ public:
+  explicit Backoff(std::chrono::microseconds max_delay = kMaxBackoff) : delay_(kTick), max_delay_(max_delay) {}
+
+  /**
+   * Sleeps for the current delay and doubles it
+   * @return
+   */
+  auto Wait() noexcept { return Sleep(Next()); }
+
+  /**
+   * Takes the current delay and doubles it, for callers which schedule a task instead of sleeping
+   * @return
+   */
+  std::chrono::microseconds Next() noexcept {
+    const auto delay = delay_;
+    delay_ = std::min(delay_ * 2, max_delay_);
+    return delay;
+  }
+
+  /**
+   * Starts with kTick again, when the operation has made progress
+   */
+  void Reset() noexcept { delay_ = kTick; }
+
+ private:
+  std::chrono::microseconds delay_;
+  std::chrono::microseconds max_delay_;
+};
+
 }  // namespace reduct::async
 #endif  // REDUCT_ASYNC_SLEEP_H
@@ -6,9 +6,11 @@
 #ifndef REDUCT_STORAGE_TASK_H
 #define REDUCT_STORAGE_TASK_H
 
+#include <atomic>
 #include <coroutine>
 #include <functional>
 #include <optional>
+#include <thread>
 
 #include "reduct/async/loop.h"
 #include "reduct/core/logger.h"
@@ -39,9 +41,15 @@ struct Task {
       LOG_TRACE("initial_suspend");
       return {};
     }
-    std::suspend_always final_suspend() noexcept {
+    auto final_suspend() noexcept {
       LOG_TRACE("final_suspend");
-      return {};
+      struct FinalAwaiter {
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(Handle h) const noexcept { h.promise().done_ = true; }
+        void await_resume() const noexcept {}
+      };
+
+      return FinalAwaiter{};
     }
 
     void return_value(T val) noexcept {
@@ -51,6 +59,8 @@ struct Task {
     void unhandled_exception() { LOG_ERROR("Unhandled exception in coroutine"); }
 
     T value_;
+    std::atomic<bool> done_{};              // the coroutine may be finished in another thread
+    std::atomic<bool> resumed_by_event_{};  // an awaiter resumes the coroutine, so Get mustn't do it
   };
 
   explicit Task(typename promise_type::Handle coro) : coro_(coro) {}
@@ -60,17 +70,34 @@ struct Task {
 
   /**
    * Resume the corutine if it is needed and return result
+   * @note if the coroutine waits for an event, it blocks until the event resumes it
    * @return
    */
   T Get() const {
-    if (!coro_.done()) coro_.resume();
-    return std::move(coro_.promise().value_);
+    auto& promise = coro_.promise();
+    if (!promise.done_ && !promise.resumed_by_event_) coro_.resume();
+    while (!promise.done_) {
+      std::this_thread::yield();
+    }
+    return std::move(promise.value_);
   }
 
  private:
   typename promise_type::Handle coro_;
 };
 
+/**
+ * Marks that an awaiter resumes the coroutine when an event happens, so Task::Get waits instead of resuming it
+ * @tparam Promise
+ * @param h
+ */
+template <typename Promise>
+void MarkResumedByEvent(std::coroutine_handle<Promise> h) noexcept {
+  if constexpr (requires { h.promise().resumed_by_event_ = true; }) {
+    h.promise().resumed_by_event_ = true;
+  }
+}
+
 /**
  * Simple task, promise_type is destroyed automatically
  */
@@ -0,0 +1,121 @@
+// Copyright 2023 ReductStore
+// This Source Code Form is subject to the terms of the Mozilla Public
+//    License, v. 2.0. If a copy of the MPL was not distributed with this
+//    file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#include "reduct/async/thread_pool.h"
+
+#include <algorithm>
+
+namespace reduct::async {
+
+ThreadPoolExecutor::ThreadPoolExecutor(Options options)
+    : options_(options), pending_{}, next_worker_{}, stop_{}, waiters_{}, progress_{} {
+  const auto threads = std::max<size_t>(options_.threads, 1);
+  for (size_t i = 0; i < threads; ++i) {
+    workers_.push_back(std::make_unique<Worker>());
+  }
+
+  // start the threads when all the queues exist, because workers steal from each other
+  for (size_t i = 0; i < threads; ++i) {
+    workers_[i]->thread = std::thread([this, i] { Work(i); });
+  }
+}
+
+ThreadPoolExecutor::~ThreadPoolExecutor() {
+  {
+    std::lock_guard lock(sleep_mutex_);
+    stop_ = true;
+  }
+  wakeup_.notify_all();
+
+  for (auto& worker : workers_) {
+    worker->thread.join();
+  }
+}
+
+bool ThreadPoolExecutor::TryPush(Job& job) {
+  if (pending_.fetch_add(1) >= options_.max_queue_size) {
+    pending_.fetch_sub(1);
+    return false;
+  }
+
+  auto& worker = *workers_[next_worker_.fetch_add(1) % workers_.size()];
+  {
+    std::lock_guard lock(worker.mutex);
+    worker.jobs.push_back(std::move(job));
+  }
+
+  {
+    // don't miss a worker which has just checked the counter and is going to sleep
+    std::lock_guard lock(sleep_mutex_);
+  }
+  wakeup_.notify_one();
+  NotifyWaiters();
+  return true;
+}
+
+bool ThreadPoolExecutor::TryPop(size_t index, Job* job) {
+  for (size_t i = 0; i < workers_.size(); ++i) {
+    auto& worker = *workers_[(index + i) % workers_.size()];
+    std::lock_guard lock(worker.mutex);
+    if (worker.jobs.empty()) {
+      continue;
+    }
+
+    if (i == 0) {
+      *job = std::move(worker.jobs.front());  // own queue in order of commits
+      worker.jobs.pop_front();
+    } else {
+      *job = std::move(worker.jobs.back());  // steal from the other end to not contend with the owner
+      worker.jobs.pop_back();
+    }
+
+    pending_.fetch_sub(1);
+    return true;
+  }
+
+  return false;
+}
+
+bool ThreadPoolExecutor::RunPending() {
+  Job job;
+  if (!TryPop(next_worker_ % workers_.size(), &job)) {
+    return false;
+  }
+
+  job();
+  NotifyWaiters();
+  return true;
+}
+
+void ThreadPoolExecutor::Work(size_t index) {
+  while (true) {
+    Job job;
+    if (TryPop(index, &job)) {
+      job();
+      NotifyWaiters();
+      continue;
+    }
+
+    std::unique_lock lock(sleep_mutex_);
+    wakeup_.wait(lock, [this] { return stop_ || pending_ > 0; });
+    if (stop_ && pending_ == 0) {
+      return;
+    }
+  }
+}
+
+void ThreadPoolExecutor::NotifyWaiters() {
+  if (waiters_ == 0) {
+    return;  // a waiter checks its future after it is counted, so it can't miss the task
+  }
+
+  {
+    std::lock_guard lock(sleep_mutex_);
+    progress_.fetch_add(1);
+  }
+  progress_changed_.notify_all();
+}
+
+}  // namespace reduct::async
@@ -0,0 +1,134 @@
+// Copyright 2023 ReductStore
+// This Source Code Form is subject to the terms of the Mozilla Public
+//    License, v. 2.0. If a copy of the MPL was not distributed with this
+//    file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#ifndef REDUCT_ASYNC_THREAD_POOL_H
+#define REDUCT_ASYNC_THREAD_POOL_H
+
+#include <uWebSockets/MoveOnlyFunction.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace reduct::async {
+
+/**
+ * Executor which runs blocking tasks (e.g. disk I/O) in a pool of worker threads.
+ * Each worker has its own queue and steals tasks from the others when its queue is empty.
+ * It can be used with async::Run, which resumes the coroutine in the loop when the task is done:
+ *
+ *    co_await Run<T, ThreadPoolExecutor>(task, &pool);
+ */
+class ThreadPoolExecutor {
+ public:
+  using Job = uWS::MoveOnlyFunction<void()>;
+
+  struct Options {
+    size_t threads = std::thread::hardware_concurrency();  // number of workers, at least one is started
+    size_t max_queue_size = 1024;  // if the queues are full, the task runs in the thread which commits it
+  };
+
+  explicit ThreadPoolExecutor(Options options);
+  ThreadPoolExecutor() : ThreadPoolExecutor(Options{}) {}
+
+  /**
+   * Finishes the committed tasks and stops the workers
+   */
+  ~ThreadPoolExecutor();
+
+  ThreadPoolExecutor(const ThreadPoolExecutor&) = delete;
+  ThreadPoolExecutor& operator=(const ThreadPoolExecutor&) = delete;
+
+  /**
+   * Commits a task to a worker
+   * @note thread safe
+   * @param task
+   * @return future with the result of the task
+   */
+  template <typename F>
+  std::future<std::invoke_result_t<F&>> Commit(F task) {
+    using T = std::invoke_result_t<F&>;
+    std::packaged_task<T()> wrapper(std::move(task));
+    auto future = wrapper.get_future();
+    Job job([wrapper = std::move(wrapper)]() mutable { wrapper(); });
+    if (!TryPush(job)) {
+      job();  // the queues are full, so the caller does the work instead of waiting for a worker
+    }
+    return future;
+  }
+
+  /**
+   * Waits for a future of a committed task and runs the committed tasks meanwhile, so a task can wait for the tasks
+   * it has committed without blocking a worker. When there is nothing to run, it sleeps until a task is committed
+   * or finished
+   * @note thread safe
+   * @param future
+   * @return result of the future
+   */
+  template <typename T>
+  T Wait(std::future<T> future) {
+    waiters_.fetch_add(1);
+    while (!IsReady(future)) {
+      const auto progress = progress_.load();
+      if (RunPending() || IsReady(future)) {
+        continue;
+      }
+
+      std::unique_lock lock(sleep_mutex_);
+      progress_changed_.wait(lock, [this, progress] { return progress_ != progress; });
+    }
+
+    waiters_.fetch_sub(1);
+    return future.get();
+  }
+
+  /**
+   * @return number of committed tasks which haven't been started yet
+   */
+  [[nodiscard]] size_t pending() const noexcept { return pending_; }
+
+  [[nodiscard]] size_t size() const noexcept { return workers_.size(); }
+
+ private:
+  struct Worker {
+    std::mutex mutex;
+    std::deque<Job> jobs;
+    std::thread thread;
+  };
+
+  template <typename T>
+  static bool IsReady(const std::future<T>& future) {
+    return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+  }
+
+  bool TryPush(Job& job);
+  bool TryPop(size_t index, Job* job);
+  bool RunPending();
+  void Work(size_t index);
+  void NotifyWaiters();
+
+  Options options_;
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::atomic<size_t> pending_;
+  std::atomic<size_t> next_worker_;
+
+  std::mutex sleep_mutex_;
+  std::condition_variable wakeup_;
+  bool stop_;
+
+  std::atomic<size_t> waiters_;                // threads in Wait
+  std::atomic<uint64_t> progress_;             // number of committed and finished tasks while somebody waits
+  std::condition_variable progress_changed_;  // wakes up the threads in Wait
+};
+
+}  // namespace reduct::async
+#endif  // REDUCT_ASYNC_THREAD_POOL_H
@@ -9,6 +9,7 @@
 
 #include <fstream>
 #include <map>
+#include <mutex>
 #include <random>
 #include <ranges>
 
@@ -56,6 +57,7 @@ class TokenRepository : public ITokenRepository {
   }
 
   Result<TokenCreateResponse> CreateToken(std::string name, TokenPermissions permissions) override {
+    std::lock_guard lock(mutex_);
     if (name.empty()) {
       return {{}, Error::UnprocessableEntity("Token name can't be empty")};
     }
@@ -94,6 +96,7 @@ class TokenRepository : public ITokenRepository {
   }
 
   Error UpdateToken(const std::string& name, TokenPermissions permissions) override {
+    std::lock_guard lock(mutex_);
     if (auto err = FindByName(name).error) {
       return err;
     }
@@ -104,6 +107,7 @@ class TokenRepository : public ITokenRepository {
   }
 
   Result<TokenList> GetTokenList() const override {
+    std::lock_guard lock(mutex_);
     TokenList token_list{};
     for (auto token : repo_ | std::views::values) {
       token.clear_permissions();  // we don't expose permissions and value when we do list
@@ -115,6 +119,7 @@ class TokenRepository : public ITokenRepository {
   }
 
   Result<Token> FindByName(const std::string& name) const override {
+    std::lock_guard lock(mutex_);
     auto it = repo_.find(name);
     if (it == repo_.end()) {
       return {{}, Error{.code = 404, .message = fmt::format("Token '{}' doesn't exist", name)}};
@@ -126,6 +131,7 @@ class TokenRepository : public ITokenRepository {
   }
 
   Result<Token> ValidateToken(std::string_view value) const override {
+    std::lock_guard lock(mutex_);
     auto v = repo_ | std::views::values | std::views::filter([value](auto t) { return t.value() == value; });
     if (v.empty()) {
       return {{}, Error::Unauthorized("Invalid token")};
@@ -137,6 +143,7 @@ class TokenRepository : public ITokenRepository {
   }
 
   Error RemoveToken(const std::string& name) override {
+    std::lock_guard lock(mutex_);
     if (repo_.erase(name) == 0) {
       return Error{.code = 404, .message = fmt::format("Token '{}' doesn't exist", name)};
     }
@@ -165,6 +172,7 @@ class TokenRepository : public ITokenRepository {
 
   std::filesystem::path config_path_;
   std::map<std::string, Token> repo_;
+  mutable std::recursive_mutex mutex_;  // the HTTP threads share the repository
 };
 
 std::unique_ptr<ITokenRepository> ITokenRepository::Build(ITokenRepository::Options options) {
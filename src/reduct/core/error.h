@@ -54,6 +54,7 @@ struct [[nodiscard]] Error {  // NOLINT
     kBadGateway = 502,
     kServiceUnavailable = 503,
     kGatewayTimeout = 504,
+    kInsufficientStorage = 507,
   };
 
   // HTTP codes 100-200
@@ -80,6 +81,9 @@ struct [[nodiscard]] Error {  // NOLINT
   static Error TooEarly(std::string msg = "Too Early") { return Error{kTooEarly, std::move(msg)}; }
   // HTTP codes 500-600
   static Error InternalError(std::string msg = "Internal Error") { return Error{kInternalError, std::move(msg)}; }
+  static Error InsufficientStorage(std::string msg = "Insufficient Storage") {
+    return Error{kInsufficientStorage, std::move(msg)};
+  }
 };
 
 }  // namespace reduct::core
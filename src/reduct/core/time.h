@@ -15,5 +15,7 @@ inline auto ToMicroseconds(Time tp) {
   return std::chrono::duration_cast<std::chrono::microseconds>(tp.time_since_epoch()).count();
 }
 
+inline Time FromMicroseconds(int64_t us) { return Time() + std::chrono::microseconds(us); }
+
 }
 #endif  // REDUCT_STORAGE_TIME_H
@@ -0,0 +1,181 @@
+// Copyright 2022 ReductStore
+// This Source Code Form is subject to the terms of the Mozilla Public
+//    License, v. 2.0. If a copy of the MPL was not distributed with this
+//    file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#include "reduct/storage/block_descriptor.h"
+
+#include <fmt/core.h>
+#include <google/protobuf/util/time_util.h>
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+namespace reduct::storage {
+
+using core::Error;
+using google::protobuf::util::TimeUtil;
+
+// the structures are copied as they are, so the format is little-endian only on such platforms
+static_assert(std::endian::native == std::endian::little);
+
+namespace {
+
+void AppendString(std::string* out, std::string_view str) {
+  const auto size = static_cast<uint32_t>(str.size());
+  out->append(reinterpret_cast<const char*>(&size), sizeof(size));
+  out->append(str);
+}
+
+/**
+ * Reads fixed-width values and strings from a buffer and checks its bounds
+ */
+class Reader {
+ public:
+  explicit Reader(std::string_view data) : data_(data), pos_{} {}
+
+  template <typename T>
+  bool Read(T* value) {
+    if (data_.size() - pos_ < sizeof(T)) {
+      return false;
+    }
+
+    std::memcpy(value, data_.data() + pos_, sizeof(T));
+    pos_ += sizeof(T);
+    return true;
+  }
+
+  bool ReadString(std::string* str) {
+    uint32_t size;
+    if (!Read(&size) || data_.size() - pos_ < size) {
+      return false;
+    }
+
+    str->assign(data_.data() + pos_, size);
+    pos_ += size;
+    return true;
+  }
+
+  bool Seek(size_t pos) {
+    if (pos > data_.size()) {
+      return false;
+    }
+
+    pos_ = pos;
+    return true;
+  }
+
+ private:
+  std::string_view data_;
+  size_t pos_;
+};
+
+}  // namespace
+
+std::string SerializeBlockDescriptor(const proto::Block& block) {
+  BlockDescriptorHeader header{
+      .magic = kBlockDescriptorMagic,
+      .version = kBlockDescriptorVersion,
+      .begin_time = TimeUtil::TimestampToMicroseconds(block.begin_time()),
+      .latest_record_time = TimeUtil::TimestampToMicroseconds(block.latest_record_time()),
+      .size = block.size(),
+      .record_count = static_cast<uint32_t>(block.records_size()),
+      .flags = (block.invalid() ? BlockDescriptorHeader::kInvalidFlag : 0) |
+               (block.has_latest_record_time() ? BlockDescriptorHeader::kHasLatestRecordFlag : 0),
+  };
+
+  std::string out;
+  out.reserve(sizeof(header) + block.records_size() * sizeof(BlockDescriptorRecord));
+  out.append(reinterpret_cast<const char*>(&header), sizeof(header));
+
+  std::string meta;
+  for (const auto& record : block.records()) {
+    BlockDescriptorRecord packed{
+        .timestamp = TimeUtil::TimestampToMicroseconds(record.timestamp()),
+        .begin = record.begin(),
+        .end = record.end(),
+        .meta_offset = BlockDescriptorRecord::kNoMeta,
+        .state = static_cast<uint8_t>(record.state()),
+        .reserved = {},
+    };
+
+    if (record.meta_data_size() > 0) {
+      packed.meta_offset = static_cast<uint32_t>(meta.size());
+      const auto count = static_cast<uint32_t>(record.meta_data_size());
+      meta.append(reinterpret_cast<const char*>(&count), sizeof(count));
+      for (const auto& entry : record.meta_data()) {
+        AppendString(&meta, entry.key());
+        AppendString(&meta, entry.value());
+      }
+    }
+
+    out.append(reinterpret_cast<const char*>(&packed), sizeof(packed));
+  }
+
+  out.append(meta);
+  return out;
+}
+
+Error ParseBlockDescriptor(std::string_view data, proto::Block* block) {
+  Reader reader(data);
+  BlockDescriptorHeader header{};
+  if (!reader.Read(&header) || header.magic != kBlockDescriptorMagic) {
+    return Error::InternalError("Block descriptor has no header");
+  }
+
+  if (header.version != kBlockDescriptorVersion) {
+    return Error::InternalError(fmt::format("Block descriptor has unknown version {}", header.version));
+  }
+
+  const auto meta_pos = sizeof(header) + static_cast<size_t>(header.record_count) * sizeof(BlockDescriptorRecord);
+  if (meta_pos > data.size()) {
+    return Error::InternalError("Block descriptor is truncated");
+  }
+
+  block->Clear();
+  *block->mutable_begin_time() = TimeUtil::MicrosecondsToTimestamp(header.begin_time);
+  if (header.flags & BlockDescriptorHeader::kHasLatestRecordFlag) {
+    *block->mutable_latest_record_time() = TimeUtil::MicrosecondsToTimestamp(header.latest_record_time);
+  }
+  block->set_size(header.size);
+  block->set_invalid(header.flags & BlockDescriptorHeader::kInvalidFlag);
+
+  block->mutable_records()->Reserve(static_cast<int>(header.record_count));
+  Reader meta_reader(data.substr(meta_pos));
+  for (uint32_t i = 0; i < header.record_count; ++i) {
+    BlockDescriptorRecord packed{};
+    reader.Read(&packed);
+
+    auto record = block->add_records();
+    *record->mutable_timestamp() = TimeUtil::MicrosecondsToTimestamp(packed.timestamp);
+    record->set_begin(packed.begin);
+    record->set_end(packed.end);
+    record->set_state(static_cast<proto::Record::State>(packed.state));
+
+    if (packed.meta_offset == BlockDescriptorRecord::kNoMeta) {
+      continue;
+    }
+
+    uint32_t count;
+    if (!meta_reader.Seek(packed.meta_offset) || !meta_reader.Read(&count)) {
+      return Error::InternalError("Block descriptor has a broken meta section");
+    }
+
+    for (uint32_t j = 0; j < count; ++j) {
+      auto entry = record->add_meta_data();
+      if (!meta_reader.ReadString(entry->mutable_key()) || !meta_reader.ReadString(entry->mutable_value())) {
+        return Error::InternalError("Block descriptor has a broken meta section");
+      }
+    }
+  }
+
+  return Error::kOk;
+}
+
+bool IsBlockDescriptor(std::string_view data) {
+  return data.size() >= kBlockDescriptorMagic.size() &&
+         std::equal(kBlockDescriptorMagic.begin(), kBlockDescriptorMagic.end(), data.begin());
+}
+
+}  // namespace reduct::storage
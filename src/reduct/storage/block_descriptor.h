@@ -0,0 +1,86 @@
+// Copyright 2022 ReductStore
+// This Source Code Form is subject to the terms of the Mozilla Public
+//    License, v. 2.0. If a copy of the MPL was not distributed with this
+//    file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#ifndef REDUCT_STORAGE_BLOCK_DESCRIPTOR_H
+#define REDUCT_STORAGE_BLOCK_DESCRIPTOR_H
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "reduct/core/error.h"
+#include "reduct/proto/storage/entry.pb.h"
+
+namespace reduct::storage {
+
+/**
+ * Binary format of a block descriptor (.meta file):
+ *
+ * | header | records[record_count] | meta section |
+ *
+ * The header and the records have fixed width, so the descriptor is saved without protobuf encoding.
+ * It is still decoded into proto::Block when it is loaded, so it doesn't make cached blocks smaller
+ * (see benchmarks/reduct/storage/block_descriptor_benchmarks.cc).
+ * Meta data of the records is stored in the meta section: uint32 count, then uint32 length and bytes
+ * of the key and the value for each entry.
+ * All the numbers are little-endian.
+ */
+struct BlockDescriptorHeader {
+  std::array<char, 4> magic;   // kBlockDescriptorMagic
+  uint32_t version;            // kBlockDescriptorVersion
+  int64_t begin_time;          // begin time of the block in microseconds
+  int64_t latest_record_time;  // timestamp of the latest record in microseconds
+  uint64_t size;               // size of the block in bytes
+  uint32_t record_count;       // number of the records after the header
+  uint32_t flags;              // kInvalidFlag | kHasLatestRecordFlag
+
+  static constexpr uint32_t kInvalidFlag = 1;
+  static constexpr uint32_t kHasLatestRecordFlag = 2;
+};
+
+struct BlockDescriptorRecord {
+  int64_t timestamp;     // timestamp of the record in microseconds
+  uint64_t begin;        // begin position of the blob in the block
+  uint64_t end;          // end position of the blob in the block
+  uint32_t meta_offset;  // offset of the meta data in the meta section, kNoMeta if the record has none
+  uint8_t state;         // proto::Record::State
+  std::array<uint8_t, 3> reserved;
+
+  static constexpr uint32_t kNoMeta = UINT32_MAX;
+};
+
+static_assert(sizeof(BlockDescriptorHeader) == 40);
+static_assert(sizeof(BlockDescriptorRecord) == 32);
+
+static constexpr std::array<char, 4> kBlockDescriptorMagic = {'R', 'S', 'B', 'D'};
+static constexpr uint32_t kBlockDescriptorVersion = 1;
+
+/**
+ * Serializes a block descriptor into the binary format
+ * @param block
+ * @return
+ */
+std::string SerializeBlockDescriptor(const proto::Block& block);
+
+/**
+ * Parses a block descriptor in the binary format
+ * @param data content of a .meta file
+ * @param block parsed descriptor
+ * @return error 500 if the data is broken or has an unknown version
+ */
+core::Error ParseBlockDescriptor(std::string_view data, proto::Block* block);
+
+/**
+ * Checks if the data has the header of the binary format.
+ * The descriptors of the previous versions are protobuf messages which never start with the magic
+ * @param data
+ * @return
+ */
+bool IsBlockDescriptor(std::string_view data);
+
+}  // namespace reduct::storage
+
+#endif  // REDUCT_STORAGE_BLOCK_DESCRIPTOR_H
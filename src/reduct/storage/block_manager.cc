@@ -7,17 +7,28 @@
 
 #include <fcntl.h>
 #include <fmt/core.h>
+#include <google/protobuf/io/zero_copy_stream_impl.h>
+#include <google/protobuf/util/delimited_message_util.h>
 #include <google/protobuf/util/time_util.h>
 
+#include <algorithm>
 #include <fstream>
+#include <list>
+#include <numeric>
+#include <unordered_map>
 #include <utility>
 
 #include "reduct/core/logger.h"
+#include "reduct/storage/block_descriptor.h"
+#include "reduct/storage/block_summary.h"
 
 namespace reduct::storage {
 
 namespace fs = std::filesystem;
 using google::protobuf::Timestamp;
+using google::protobuf::io::IstreamInputStream;
+using google::protobuf::util::ParseDelimitedFromZeroCopyStream;
+using google::protobuf::util::SerializeDelimitedToOstream;
 using google::protobuf::util::TimeUtil;
 
 using core::Error;
@@ -31,44 +42,69 @@ std::filesystem::path BlockPath(const fs::path& parent, const proto::Block& bloc
 
 class BlockManager : public IBlockManager {
  public:
-  explicit BlockManager(fs::path parent) : parent_(std::move(parent)) {}
+  BlockManager(fs::path parent, size_t cache_size, io::IFileSyncer::SPtr syncer)
+      : parent_(std::move(parent)), cache_size_(cache_size), syncer_(std::move(syncer)), stats_{}, journal_ts_{} {}
 
-  core::Result<BlockSPtr> LoadBlock(const Timestamp& proto_ts) override {
-    if (latest_loaded_ && latest_loaded_->begin_time() == proto_ts) {
-      return {latest_loaded_, Error::kOk};
+  core::Result<BlockSPtr> LoadBlock(int64_t begin_time) override {
+    if (auto cached = GetFromCache(begin_time)) {
+      return {cached, Error::kOk};
     }
 
-    auto file_name = parent_ / fmt::format("{}{}", TimeUtil::TimestampToMicroseconds(proto_ts), kMetaExt);
-    std::ifstream file(file_name);
+    auto meta_path = parent_ / fmt::format("{}{}", begin_time, kMetaExt);
+    std::ifstream file(meta_path, std::ios::binary | std::ios::ate);
     if (!file) {
       return {
           nullptr,
           {
               .code = 500,
               .message =
-                  fmt::format("Failed to load a block descriptor {}: {}", file_name.string(), std::strerror(errno)),
+                  fmt::format("Failed to load a block descriptor {}: {}", meta_path.string(), std::strerror(errno)),
           },
       };
     }
 
-    latest_loaded_ = std::make_shared<proto::Block>();
-    if (!latest_loaded_->ParseFromIstream(&file)) {
-      latest_loaded_ = nullptr;
-      return {nullptr, {.code = 500, .message = fmt::format("Failed to parse meta: {}", file_name.string())}};
+    std::string data(file.tellg(), '\0');
+    file.seekg(0);
+    if (!file.read(data.data(), static_cast<std::streamsize>(data.size()))) {
+      return {nullptr, {.code = 500, .message = fmt::format("Failed to read meta: {}", meta_path.string())}};
     }
+    file.close();
 
-    return {latest_loaded_, Error::kOk};
+    auto block = std::make_shared<proto::Block>();
+    if (IsBlockDescriptor(data)) {
+      if (auto err = ParseBlockDescriptor(data, block.get())) {
+        return {nullptr, {.code = 500, .message = fmt::format("Failed to parse meta {}: {}", meta_path.string(),
+                                                              err.message)}};
+      }
+    } else {
+      // the descriptors of the previous versions are protobuf messages, we convert them at once
+      if (!block->ParseFromString(data)) {
+        return {nullptr, {.code = 500, .message = fmt::format("Failed to parse meta: {}", meta_path.string())}};
+      }
+
+      LOG_DEBUG("Convert block descriptor {} into binary format", meta_path.string());
+      if (auto err = SaveBlock(block)) {
+        LOG_WARNING("Failed to convert block descriptor {}: {}", meta_path.string(), err.ToString());
+      }
+    }
+
+    if (auto err = ReplayJournal(block.get())) {
+      return {nullptr, err};
+    }
+
+    PutToCache(block);
+    return {block, Error::kOk};
   }
 
-  core::Result<BlockSPtr> StartBlock(const Timestamp& proto_ts, size_t max_block_size) override {
+  core::Result<BlockSPtr> StartBlock(int64_t begin_time, size_t max_block_size) override {
     // allocate the whole block
-    latest_loaded_ = std::make_shared<proto::Block>();
-    latest_loaded_->mutable_begin_time()->CopyFrom(proto_ts);
+    auto block = std::make_shared<proto::Block>();
+    *block->mutable_begin_time() = TimeUtil::MicrosecondsToTimestamp(begin_time);
 
-    auto block_path = BlockPath(parent_, *latest_loaded_, kBlockExt);
+    auto block_path = BlockPath(parent_, *block, kBlockExt);
 
+    std::error_code ec;
     if (auto file = std::ofstream(block_path, std::ios::binary)) {
-      std::error_code ec;
       fs::resize_file(block_path, max_block_size, ec);
       if (ec) {
         return {{}, {.code = 500, .message = ec.message()}};
@@ -77,26 +113,67 @@ class BlockManager : public IBlockManager {
       return {{}, {.code = 500, .message = strerror(errno)}};
     }
 
-    auto err = SaveBlock(latest_loaded_);
+    auto err = SaveBlock(block);
     if (err) {
       return {{}, err};
     }
 
-    return {latest_loaded_, Error::kOk};
+    // a journal could be left by a crash before the descriptor was saved
+    CloseJournal(begin_time);
+    fs::remove(BlockPath(parent_, *block, kJournalExt), ec);
+    // and a summary by a finished block with the same begin time
+    fs::remove(FilePath(begin_time, kSummaryExt), ec);
+
+    if (syncer_) {
+      // new files must be synced with their directory
+      syncer_->Sync({block_path, BlockPath(parent_, *block, kMetaExt), parent_}, 0);
+    }
+
+    PutToCache(block);
+    return {block, Error::kOk};
   }
 
   core::Error SaveBlock(const BlockSPtr& block) const override {
     auto block_path = BlockPath(parent_, *block, kMetaExt);
-    std::ofstream file(block_path);
-    if (file) {
-      block->SerializeToOstream(&file);
+    std::ofstream file(block_path, std::ios::binary | std::ios::trunc);
+    const auto data = SerializeBlockDescriptor(*block);
+    if (file && file.write(data.data(), static_cast<std::streamsize>(data.size()))) {
       return {};
     } else {
       return {.code = 500, .message = "Failed to save a block descriptor"};
     }
   }
 
-  Error FinishBlock(const BlockSPtr& block) const override {
+  Error AppendRecord(const BlockSPtr& block, int record_index) override {
+    proto::BlockEvent event;
+    *event.mutable_record_added() = block->records(record_index);
+    event.set_record_index(record_index);
+
+    if (auto it = cache_index_.find(BeginTime(*block)); it != cache_index_.end() && it->second->block == block) {
+      AddToIndex(&it->second->index, *block, record_index);
+    }
+
+    return AppendEvent(*block, &event);
+  }
+
+  Error UpdateRecordState(const BlockSPtr& block, int record_index, proto::Record::State state) override {
+    ApplyState(block.get(), record_index, state);
+    if (auto it = cache_index_.find(BeginTime(*block)); it != cache_index_.end() && it->second->block == block) {
+      // the updated record is usually the latest one
+      auto& index = it->second->index;
+      auto pos = std::ranges::find(index.indexes.rbegin(), index.indexes.rend(), record_index);
+      if (pos != index.indexes.rend()) {
+        index.states[index.indexes.rend() - pos - 1] = static_cast<uint8_t>(state);
+      }
+    }
+
+    proto::BlockEvent event;
+    event.mutable_state_changed()->set_record_index(record_index);
+    event.mutable_state_changed()->set_state(state);
+    return AppendEvent(*block, &event);
+  }
+
+  Error FinishBlock(const BlockSPtr& block) override {
     auto block_path = BlockPath(parent_, *block, kBlockExt);
     std::error_code ec;
     fs::resize_file(block_path, block->size(), ec);
@@ -104,9 +181,67 @@ class BlockManager : public IBlockManager {
       return {.code = 500, .message = ec.message()};
     }
 
+    // compact the journal into the descriptor
+    if (auto err = SaveBlock(block)) {
+      return err;
+    }
+
+    // the descriptor must be on disk before we remove the journal
+    if (syncer_) {
+      if (auto err = syncer_->SyncNow({block_path, BlockPath(parent_, *block, kMetaExt)})) {
+        return err;
+      }
+    }
+
+    CloseJournal(BeginTime(*block));
+    fs::remove(BlockPath(parent_, *block, kJournalExt), ec);
+    if (ec) {
+      return {.code = 500, .message = ec.message()};
+    }
+
+    return SaveSummary(SummarizeBlock(*block));
+  }
+
+  Error SaveSummary(const proto::BlockSummary& summary) const override {
+    const auto begin_time = TimeUtil::TimestampToMicroseconds(summary.begin_time());
+    const auto path = FilePath(begin_time, kSummaryExt);
+
+    auto stamped = summary;
+    const auto [meta_size, meta_mtime] = MetaStat(begin_time);
+    stamped.set_meta_size(meta_size);
+    stamped.set_meta_mtime(meta_mtime);
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file || !stamped.SerializeToOstream(&file)) {
+      return Error::InternalError(fmt::format("Failed to save a block summary {}", path.string()));
+    }
+
     return Error::kOk;
   }
 
+  core::Result<proto::BlockSummary> LoadSummary(int64_t begin_time) const override {
+    const auto path = FilePath(begin_time, kSummaryExt);
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+      return {{}, Error::NotFound(fmt::format("Block {} has no summary", begin_time))};
+    }
+
+    proto::BlockSummary summary;
+    if (!summary.ParseFromIstream(&file)) {
+      return {{}, Error::InternalError(fmt::format("Failed to parse a block summary {}", path.string()))};
+    }
+
+    // the descriptor or the journal has changed since the summary was saved, e.g. by a belated record
+    std::error_code ec;
+    const auto [meta_size, meta_mtime] = MetaStat(begin_time);
+    if (fs::exists(FilePath(begin_time, kJournalExt), ec) || summary.meta_size() != meta_size ||
+        summary.meta_mtime() != meta_mtime) {
+      return {{}, Error::Conflict(fmt::format("Summary of block {} is stale", begin_time))};
+    }
+
+    return {std::move(summary), Error::kOk};
+  }
+
   Error RemoveBlock(const BlockSPtr& block) override {
     const auto& readers = RemoveDeadReaders(block);
     if (!readers.empty()) {
@@ -118,6 +253,9 @@ class BlockManager : public IBlockManager {
       return {.code = 500, .message = "Block has active writers"};
     }
 
+    RemoveFromCache(BeginTime(*block));
+    evicted_.erase(BeginTime(*block));
+
     std::error_code ec;
     auto path = BlockPath(parent_, *block);
     auto make_error = [&ec, &path] {
@@ -140,11 +278,28 @@ class BlockManager : public IBlockManager {
       LOG_WARNING(err.ToString());
     }
 
+    // remove journal
+    CloseJournal(BeginTime(*block));
+    path = BlockPath(parent_, *block, kJournalExt);
+    fs::remove(path, ec);
+    if (ec) {
+      err = make_error();
+      LOG_WARNING(err.ToString());
+    }
+
+    // remove summary
+    path = FilePath(BeginTime(*block), kSummaryExt);
+    fs::remove(path, ec);
+    if (ec) {
+      err = make_error();
+      LOG_WARNING(err.ToString());
+    }
+
     return err;
   }
 
   core::Result<async::IAsyncReader::SPtr> BeginRead(const BlockSPtr& block, AsyncReaderParameters params) override {
-    async::IAsyncReader::SPtr reader = BuildAsyncReader(*block, std::move(params));
+    async::IAsyncReader::SPtr reader = BuildReader(block, std::move(params));
 
     auto& readers = RemoveDeadReaders(block);
     readers.push_back(reader);
@@ -153,23 +308,8 @@ class BlockManager : public IBlockManager {
   }
 
   core::Result<async::IAsyncWriter::SPtr> BeginWrite(const BlockSPtr& block, AsyncWriterParameters params) override {
-    async::IAsyncWriter::SPtr writer =
-        BuildAsyncWriter(*block, std::move(params), [this, ts = block->begin_time()](int index, auto state) {
-          auto [blk, load_err] = LoadBlock(ts);
-          if (load_err) {
-            LOG_ERROR("{}", load_err.ToString());
-            return;
-          }
-
-          blk->mutable_records(index)->set_state(state);
-          if (state == proto::Record::kInvalid) {
-            blk->set_invalid(true);
-          }
-
-          if (auto err = SaveBlock(blk)) {
-            LOG_ERROR("{}", err.ToString());
-          }
-        });
+    params.syncer = syncer_;
+    async::IAsyncWriter::SPtr writer = BuildWriter(block, std::move(params));
 
     auto& writers = RemoveDeadWriters(block);
     writers.push_back(writer);
@@ -177,26 +317,382 @@ class BlockManager : public IBlockManager {
     return {writer, Error::kOk};
   }
 
+  const RecordIndex& GetRecordIndex(const BlockSPtr& block) override {
+    auto it = cache_index_.find(BeginTime(*block));
+    if (it == cache_index_.end() || it->second->block != block) {
+      PutToCache(block);  // the block was evicted, build its index again
+      return lru_.front().index;
+    }
+
+    return it->second->index;
+  }
+
+  void SetOnRecordFinished(std::function<void(int64_t)> callback) override {
+    on_record_finished_ = std::move(callback);
+  }
+
+  [[nodiscard]] CacheStats GetCacheStats() const override { return stats_; }
+
  private:
+  static int64_t BeginTime(const proto::Block& block) { return TimeUtil::TimestampToMicroseconds(block.begin_time()); }
+
+  [[nodiscard]] fs::path FilePath(int64_t begin_time, std::string_view ext) const {
+    return parent_ / fmt::format("{}{}", begin_time, ext);
+  }
+
+  /**
+   * Size and modification time of the descriptor, so that a summary can be checked against it
+   */
+  [[nodiscard]] std::pair<uint64_t, int64_t> MetaStat(int64_t begin_time) const {
+    const auto path = FilePath(begin_time, kMetaExt);
+    std::error_code ec;
+    const auto size = fs::file_size(path, ec);
+    if (ec) {
+      return {0, 0};
+    }
+
+    const auto mtime = fs::last_write_time(path, ec);
+    if (ec) {
+      return {0, 0};
+    }
+
+    return {size, std::chrono::duration_cast<std::chrono::nanoseconds>(mtime.time_since_epoch()).count()};
+  }
+
+  static void ApplyState(proto::Block* block, int record_index, proto::Record::State state) {
+    block->mutable_records(record_index)->set_state(state);
+    if (state == proto::Record::kInvalid) {
+      block->set_invalid(true);
+    }
+  }
+
+  Error AppendEvent(const proto::Block& block, proto::BlockEvent* event) {
+    if (block.has_latest_record_time()) {
+      event->mutable_latest_record_time()->CopyFrom(block.latest_record_time());
+    }
+
+    // usually we write into the same block, so keep its journal open
+    if (!journal_.is_open() || journal_ts_ != BeginTime(block)) {
+      journal_.close();
+      journal_.clear();
+      journal_.open(BlockPath(parent_, block, kJournalExt), std::ios::binary | std::ios::app);
+      journal_ts_ = BeginTime(block);
+    }
+
+    if (!journal_ || !SerializeDelimitedToOstream(*event, &journal_) || !journal_.flush()) {
+      journal_.close();
+      return Error::InternalError(
+          fmt::format("Failed to append to journal {}", BlockPath(parent_, block, kJournalExt).string()));
+    }
+
+    return Error::kOk;
+  }
+
+  void CloseJournal(int64_t begin_time) {
+    if (journal_.is_open() && journal_ts_ == begin_time) {
+      journal_.close();
+    }
+  }
+
+  /**
+   * Applies the events from the journal of the block if it exists.
+   * A broken tail of the journal (e.g. after a crash) is truncated
+   */
+  Error ReplayJournal(proto::Block* block) {
+    const auto journal_path = BlockPath(parent_, *block, kJournalExt);
+    std::ifstream file(journal_path, std::ios::binary);
+    if (!file) {
+      return Error::kOk;  // no journal, the descriptor is compacted
+    }
+
+    IstreamInputStream stream(&file);
+    int64_t valid_size = 0;
+    proto::BlockEvent event;
+    bool clean_eof = true;
+    while (ParseDelimitedFromZeroCopyStream(&event, &stream, &clean_eof)) {
+      switch (event.event_case()) {
+        case proto::BlockEvent::kRecordAdded:
+          if (event.record_index() < block->records_size()) {
+            break;  // the journal was compacted but not removed
+          }
+
+          block->set_size(std::max(block->size(), event.record_added().end()));
+          *block->add_records() = std::move(*event.mutable_record_added());
+          break;
+        case proto::BlockEvent::kStateChanged: {
+          const auto& changed = event.state_changed();
+          if (changed.record_index() >= block->records_size()) {
+            return Error::InternalError(fmt::format("Journal {} refers to a wrong record", journal_path.string()));
+          }
+          ApplyState(block, changed.record_index(), changed.state());
+          break;
+        }
+        case proto::BlockEvent::EVENT_NOT_SET:
+          break;
+      }
+
+      if (event.has_latest_record_time()) {
+        block->mutable_latest_record_time()->CopyFrom(event.latest_record_time());
+      }
+
+      valid_size = stream.ByteCount();
+    }
+
+    if (!clean_eof) {
+      LOG_WARNING("Journal {} has a broken tail after {} bytes. Truncate it.", journal_path.string(), valid_size);
+      file.close();
+      std::error_code ec;
+      fs::resize_file(journal_path, valid_size, ec);
+      if (ec) {
+        return Error::InternalError(
+            fmt::format("Failed to truncate journal {}: {}", journal_path.string(), ec.message()));
+      }
+    }
+
+    return Error::kOk;
+  }
+
+  struct CachedBlock {
+    BlockSPtr block;
+    size_t size;
+    io::IMappedFile::SPtr mapped_file;  // shared by the readers of the block
+    RecordIndex index;                  // records sorted by timestamp
+  };
+
+  using LruList = std::list<CachedBlock>;
+
+  /**
+   * Approximate size of a parsed descriptor in memory.
+   * It is cheap to calculate, so we can update it every time we touch the block
+   */
+  static size_t EstimateSize(const proto::Block& block) {
+    return sizeof(proto::Block) +
+           block.records_size() * (sizeof(proto::Record) + sizeof(Timestamp) + sizeof(int64_t) + sizeof(int) + 1);
+  }
+
+  static RecordIndex BuildIndex(const proto::Block& block) {
+    std::vector<int> order(block.records_size());
+    std::iota(order.begin(), order.end(), 0);
+
+    std::vector<int64_t> timestamps(order.size());
+    for (int i = 0; i < block.records_size(); ++i) {
+      timestamps[i] = TimeUtil::TimestampToMicroseconds(block.records(i).timestamp());
+    }
+    std::ranges::stable_sort(order, {}, [&timestamps](int i) { return timestamps[i]; });
+
+    RecordIndex index;
+    index.timestamps.reserve(order.size());
+    index.indexes.reserve(order.size());
+    index.states.reserve(order.size());
+    for (auto i : order) {
+      index.timestamps.push_back(timestamps[i]);
+      index.indexes.push_back(i);
+      index.states.push_back(static_cast<uint8_t>(block.records(i).state()));
+      AddLabels(&index, block, i);
+    }
+    return index;
+  }
+
+  static void AddLabels(RecordIndex* index, const proto::Block& block, int record_index) {
+    for (const auto& label : block.records(record_index).meta_data()) {
+      auto& bitmap = index->labels[label.key()][label.value()];
+      if (bitmap.size() <= static_cast<size_t>(record_index)) {
+        bitmap.resize(block.records_size());
+      }
+      bitmap[record_index] = true;
+    }
+  }
+
+  /**
+   * Inserts a new record into the sorted index. Usually it is the latest one, so it goes to the end
+   */
+  static void AddToIndex(RecordIndex* index, const proto::Block& block, int record_index) {
+    if (static_cast<int>(index->size()) >= block.records_size()) {
+      return;  // the record is already indexed
+    }
+
+    const auto& record = block.records(record_index);
+    const auto ts = TimeUtil::TimestampToMicroseconds(record.timestamp());
+    const auto pos = std::ranges::upper_bound(index->timestamps, ts) - index->timestamps.begin();
+    index->timestamps.insert(index->timestamps.begin() + pos, ts);
+    index->indexes.insert(index->indexes.begin() + pos, record_index);
+    index->states.insert(index->states.begin() + pos, static_cast<uint8_t>(record.state()));
+    AddLabels(index, block, record_index);
+  }
+
+  BlockSPtr GetFromCache(int64_t begin_time) {
+    auto it = cache_index_.find(begin_time);
+    if (it == cache_index_.end()) {
+      // the descriptor may be evicted but still used, e.g. by a query, so we must not load its copy
+      if (auto evicted = evicted_.extract(begin_time)) {
+        if (auto block = evicted.mapped().lock()) {
+          stats_.hits++;
+          PutToCache(block);
+          return block;
+        }
+      }
+
+      stats_.misses++;
+      return nullptr;
+    }
+
+    stats_.hits++;
+    Touch(it->second);
+    return it->second->block;
+  }
+
+  void PutToCache(const BlockSPtr& block) {
+    if (auto it = cache_index_.find(BeginTime(*block)); it != cache_index_.end()) {
+      if (it->second->block != block) {
+        it->second->block = block;
+        it->second->index = BuildIndex(*block);
+      }
+      Touch(it->second);
+    } else {
+      lru_.push_front(CachedBlock{.block = block, .size = 0, .index = BuildIndex(*block)});
+      cache_index_[BeginTime(*block)] = lru_.begin();
+      Touch(lru_.begin());
+    }
+
+    // Keep at least the block which we've just used
+    while (stats_.size > cache_size_ && lru_.size() > 1) {
+      const auto& evicted = lru_.back().block;
+      if (evicted.use_count() > 1) {
+        evicted_[BeginTime(*evicted)] = evicted;
+      }
+      RemoveFromCache(BeginTime(*evicted));
+    }
+  }
+
+  void RemoveFromCache(int64_t begin_time) {
+    auto it = cache_index_.find(begin_time);
+    if (it == cache_index_.end()) {
+      return;
+    }
+
+    stats_.size -= it->second->size;
+    lru_.erase(it->second);
+    cache_index_.erase(it);
+    stats_.count = lru_.size();
+  }
+
+  /**
+   * Moves the block to the head of the LRU list and updates its size, because the block may have grown
+   */
+  void Touch(LruList::iterator it) {
+    lru_.splice(lru_.begin(), lru_, it);
+
+    const auto size = EstimateSize(*it->block);
+    stats_.size = stats_.size - it->size + size;
+    stats_.count = lru_.size();
+    it->size = size;
+  }
+
+  /**
+   * Chooses the best reader for the record
+   */
+  async::IAsyncReader::UPtr BuildReader(const BlockSPtr& block, AsyncReaderParameters params) {
+#ifdef REDUCT_IO_URING
+    // page faults of a mapping would block the loop, so the ring goes first
+    if (io::IIoRing::IsSupported()) {
+      return io::BuildRingAsyncReader(*block, std::move(params));
+    }
+#endif
+
+    if (auto mapped_file = MapBlock(block, params)) {
+      return BuildMappedAsyncReader(*block, std::move(params), std::move(mapped_file));
+    }
+
+    return BuildAsyncReader(*block, std::move(params));
+  }
+
+  async::IAsyncWriter::UPtr BuildWriter(const BlockSPtr& block, AsyncWriterParameters params) {
+    auto callback = [this, ts = BeginTime(*block), alive = std::weak_ptr(alive_)](int index, auto state) {
+      if (alive.expired()) {
+        return;  // the ring finished the record after the entry was removed
+      }
+
+      auto [blk, load_err] = LoadBlock(ts);
+      if (load_err) {
+        LOG_ERROR("{}", load_err.ToString());
+        return;
+      }
+
+      if (auto err = UpdateRecordState(blk, index, state)) {
+        LOG_ERROR("{}", err.ToString());
+        return;
+      }
+
+      if (state == proto::Record::kFinished && on_record_finished_) {
+        on_record_finished_(TimeUtil::TimestampToMicroseconds(blk->records(index).timestamp()));
+      }
+    };
+
+#ifdef REDUCT_IO_URING
+    if (io::IIoRing::IsSupported()) {
+      return io::BuildRingAsyncWriter(*block, std::move(params), std::move(callback));
+    }
+#endif
+
+    return BuildAsyncWriter(*block, std::move(params), std::move(callback));
+  }
+
+  /**
+   * Maps the block file to read a finished record without copying.
+   * The data of finished records doesn't change, so the mapping is shared by all the readers of the block
+   * and remapped only when a reader needs a record written after the block was mapped.
+   * @return nullptr if the record should be read with a stream
+   */
+  io::IMappedFile::SPtr MapBlock(const BlockSPtr& block, const AsyncReaderParameters& params) {
+    const auto& record = block->records(params.record_index);
+    auto it = cache_index_.find(BeginTime(*block));
+    if (record.state() != proto::Record::kFinished || it == cache_index_.end()) {
+      return nullptr;
+    }
+
+    auto& mapped_file = it->second->mapped_file;
+    if (!mapped_file || mapped_file->data().size() < record.end()) {
+      auto [mapping, err] = io::IMappedFile::Build(params.path, block->size());
+      if (err) {
+        LOG_DEBUG("{}. Read with stream", err.ToString());
+        return nullptr;
+      }
+
+      mapped_file = std::move(mapping);
+    }
+
+    return mapped_file;
+  }
+
   std::vector<std::weak_ptr<async::IAsyncReader>>& RemoveDeadReaders(const BlockSPtr& block) {
-    auto& readers = current_readers_[block->begin_time()];
+    auto& readers = current_readers_[BeginTime(*block)];
     std::erase_if(readers, [](auto reader) { return !reader.lock() || reader.lock()->is_done(); });
     return readers;
   }
 
   std::vector<std::weak_ptr<async::IAsyncWriter>>& RemoveDeadWriters(const BlockSPtr& block) {
-    auto& writers = current_writers_[block->begin_time()];
+    auto& writers = current_writers_[BeginTime(*block)];
     std::erase_if(writers, [](auto reader) { return !reader.lock() || reader.lock()->is_done(); });
     return writers;
   }
 
   fs::path parent_;
-  BlockSPtr latest_loaded_;
-  std::map<Timestamp, std::vector<std::weak_ptr<async::IAsyncReader>>> current_readers_;
-  std::map<Timestamp, std::vector<std::weak_ptr<async::IAsyncWriter>>> current_writers_;
+  size_t cache_size_;
+  io::IFileSyncer::SPtr syncer_;
+  CacheStats stats_;
+  LruList lru_;  // the most recently used descriptors are in the front
+  std::unordered_map<int64_t, LruList::iterator> cache_index_;  // blocks by their begin times in microseconds
+  std::unordered_map<int64_t, std::weak_ptr<proto::Block>> evicted_;  // evicted descriptors which were still in use
+  std::ofstream journal_;
+  int64_t journal_ts_;
+  std::unordered_map<int64_t, std::vector<std::weak_ptr<async::IAsyncReader>>> current_readers_;
+  std::unordered_map<int64_t, std::vector<std::weak_ptr<async::IAsyncWriter>>> current_writers_;
+  std::function<void(int64_t)> on_record_finished_;
+  std::shared_ptr<bool> alive_ = std::make_shared<bool>(true);  // writers finished by the ring check it
 };
 
-std::unique_ptr<IBlockManager> IBlockManager::Build(const std::filesystem::path& parent) {
-  return std::make_unique<BlockManager>(parent);
+std::unique_ptr<IBlockManager> IBlockManager::Build(const std::filesystem::path& parent, size_t cache_size,
+                                                    io::IFileSyncer::SPtr syncer) {
+  return std::make_unique<BlockManager>(parent, cache_size, std::move(syncer));
 }
 }  // namespace reduct::storage
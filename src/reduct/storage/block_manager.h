@@ -9,42 +9,82 @@
 #include <google/protobuf/timestamp.pb.h>
 
 #include <filesystem>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
 
+#include "reduct/config.h"
 #include "reduct/core/error.h"
 #include "reduct/core/result.h"
 #include "reduct/proto/storage/entry.pb.h"
+#include "reduct/proto/storage/manifest.pb.h"
 #include "reduct/storage/io/async_reader.h"
 #include "reduct/storage/io/async_writer.h"
+#include "reduct/storage/io/file_syncer.h"
 
 namespace reduct::storage {
 
 static constexpr std::string_view kBlockExt = ".blk";
 static constexpr std::string_view kMetaExt = ".meta";
+static constexpr std::string_view kJournalExt = ".jrn";
+static constexpr std::string_view kSummaryExt = ".sum";
 
 /**
  * Creates, loads removes blocks of data
- * @note It has to be only one in the app, because caches the last loaded block
+ * @note It has to be only one per entry, because it caches the loaded block descriptors
  */
 class IBlockManager {
  public:
   using BlockSPtr = std::shared_ptr<proto::Block>;
 
+  /**
+   * Statistics of the descriptor cache
+   */
+  struct CacheStats {
+    size_t hits;    // number of descriptors taken from the cache
+    size_t misses;  // number of descriptors loaded from disk
+    size_t count;   // number of descriptors in the cache
+    size_t size;    // approximate size of cached descriptors in bytes
+
+    std::strong_ordering operator<=>(const CacheStats& rhs) const = default;
+  };
+
+  /**
+   * Records of a block sorted by timestamp. The columns are stored separately,
+   * so that a query scans only the column it needs
+   */
+  struct RecordIndex {
+    using Bitmap = std::vector<bool>;  // a bit for each record by its index in the block
+    using LabelIndex = std::map<std::string, std::map<std::string, Bitmap>>;
+
+    std::vector<int64_t> timestamps;  // timestamps of the records in microseconds
+    std::vector<int> indexes;         // indexes of the records in the block
+    std::vector<uint8_t> states;      // proto::Record::State of the records
+    LabelIndex labels;                // dictionary of label names and values with the records which have them
+
+    [[nodiscard]] size_t size() const { return timestamps.size(); }
+    [[nodiscard]] bool empty() const { return timestamps.empty(); }
+
+    bool operator==(const RecordIndex& rhs) const = default;
+  };
+
   virtual ~IBlockManager() = default;
 
   /**
    * Load a block and save in a cache
-   * @param proto_ts
+   * @param begin_time begin time of the block in microseconds
    * @return
    */
-  virtual core::Result<BlockSPtr> LoadBlock(const google::protobuf::Timestamp& proto_ts) = 0;
+  virtual core::Result<BlockSPtr> LoadBlock(int64_t begin_time) = 0;
 
   /**
    * Starts a new block and save it a cache
-   * @param proto_ts
+   * @param begin_time begin time of the block in microseconds
    * @param max_block_size
    * @return
    */
-  virtual core::Result<BlockSPtr> StartBlock(const google::protobuf::Timestamp& proto_ts, size_t max_block_size) = 0;
+  virtual core::Result<BlockSPtr> StartBlock(int64_t begin_time, size_t max_block_size) = 0;
 
   /**
    * Save a block to filesystem
@@ -54,11 +94,44 @@ class IBlockManager {
   virtual core::Error SaveBlock(const BlockSPtr& block) const = 0;
 
   /**
-   * Finish a block
+   * Append a record to the journal of the block instead of rewriting the whole descriptor
+   * @note the record must be already added to the block
+   * @param block
+   * @param record_index
+   * @return
+   */
+  virtual core::Error AppendRecord(const BlockSPtr& block, int record_index) = 0;
+
+  /**
+   * Update state of a record and append the change to the journal of the block
+   * @param block
+   * @param record_index
+   * @param state
+   * @return
+   */
+  virtual core::Error UpdateRecordState(const BlockSPtr& block, int record_index, proto::Record::State state) = 0;
+
+  /**
+   * Finish a block: shrink its data file, compact its journal into the descriptor and save its summary
    * @param block
    * @return
    */
-  virtual core::Error FinishBlock(const BlockSPtr& block) const = 0;
+  virtual core::Error FinishBlock(const BlockSPtr& block) = 0;
+
+  /**
+   * Save the summary of a finished block next to its descriptor
+   * @param summary
+   * @return
+   */
+  virtual core::Error SaveSummary(const proto::BlockSummary& summary) const = 0;
+
+  /**
+   * Load the summary of a finished block without loading its descriptor
+   * @param begin_time begin time of the block in microseconds
+   * @return error 404 if the block has no summary, error 409 if the block has a journal or its descriptor
+   * doesn't match the size and modification time stamped in the summary
+   */
+  virtual core::Result<proto::BlockSummary> LoadSummary(int64_t begin_time) const = 0;
 
   /**
    * Remove block from disk
@@ -80,12 +153,37 @@ class IBlockManager {
   virtual core::Result<async::IAsyncWriter::SPtr> BeginWrite(const BlockSPtr& block,
                                                              io::AsyncWriterParameters params) = 0;
 
+  /**
+   * Provides records of a block sorted by timestamp for binary search.
+   * The index is built when the block is loaded or started and kept up to date by AppendRecord
+   * @note the reference is valid until the next call of the manager
+   * @param block
+   * @return
+   */
+  virtual const RecordIndex& GetRecordIndex(const BlockSPtr& block) = 0;
+
+  /**
+   * Sets a callback which is called with the timestamp of a record in microseconds when a writer finishes it
+   * @param callback
+   */
+  virtual void SetOnRecordFinished(std::function<void(int64_t)> callback) = 0;
+
+  /**
+   * Provides statistics of the descriptor cache
+   * @return
+   */
+  [[nodiscard]] virtual CacheStats GetCacheStats() const = 0;
+
   /**
    * Factory method
    * @param parent
+   * @param cache_size max size of cached descriptors in bytes. The latest used descriptor is always kept.
+   * @param syncer syncs written blocks and descriptors to disk. If it is nullptr, nothing is synced
    * @return
    */
-  static std::unique_ptr<IBlockManager> Build(const std::filesystem::path& parent);
+  static std::unique_ptr<IBlockManager> Build(const std::filesystem::path& parent,
+                                              size_t cache_size = kDefaultBlockCacheSize,
+                                              io::IFileSyncer::SPtr syncer = nullptr);
 };
 
 /**
@@ -0,0 +1,101 @@
+// Copyright 2022 ReductStore
+// This Source Code Form is subject to the terms of the Mozilla Public
+//    License, v. 2.0. If a copy of the MPL was not distributed with this
+//    file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#include "reduct/storage/block_summary.h"
+
+#include <algorithm>
+#include <array>
+#include <limits>
+
+namespace reduct::storage {
+
+namespace {
+
+/**
+ * FNV-1a hash of "name\0value", it doesn't depend on the standard library
+ */
+uint64_t HashLabel(std::string_view name, std::string_view value) {
+  uint64_t hash = 14695981039346656037ULL;
+  auto update = [&hash](std::string_view str) {
+    for (auto ch : str) {
+      hash ^= static_cast<uint8_t>(ch);
+      hash *= 1099511628211ULL;
+    }
+  };
+
+  update(name);
+  update(std::string_view("\0", 1));
+  update(value);
+  return hash;
+}
+
+/**
+ * Positions of the bits for a label with double hashing
+ */
+std::array<size_t, LabelBloomFilter::kHashes> BitPositions(std::string_view name, std::string_view value) {
+  const auto hash = HashLabel(name, value);
+  const auto h1 = static_cast<uint32_t>(hash);
+  const auto h2 = static_cast<uint32_t>(hash >> 32) | 1;
+
+  std::array<size_t, LabelBloomFilter::kHashes> positions{};
+  for (size_t i = 0; i < positions.size(); ++i) {
+    positions[i] = (h1 + i * h2) % LabelBloomFilter::kBits;
+  }
+  return positions;
+}
+
+}  // namespace
+
+void LabelBloomFilter::Add(std::string_view name, std::string_view value) {
+  if (bits_.size() != kBits / 8) {
+    return;
+  }
+
+  for (auto pos : BitPositions(name, value)) {
+    bits_[pos / 8] = static_cast<char>(bits_[pos / 8] | (1 << (pos % 8)));
+  }
+}
+
+bool LabelBloomFilter::MayContain(std::string_view name, std::string_view value) const {
+  if (bits_.size() != kBits / 8) {
+    return true;
+  }
+
+  return std::ranges::all_of(BitPositions(name, value), [this](size_t pos) {
+    return (bits_[pos / 8] & (1 << (pos % 8))) != 0;
+  });
+}
+
+bool LabelBloomFilter::MayContainAll(const async::LabelMap& labels) const {
+  return std::ranges::all_of(labels, [this](const auto& label) { return MayContain(label.first, label.second); });
+}
+
+proto::BlockSummary SummarizeBlock(const proto::Block& block) {
+  proto::BlockSummary summary;
+  *summary.mutable_begin_time() = block.begin_time();
+  *summary.mutable_latest_record_time() = block.latest_record_time();
+  summary.set_size(block.size());
+  summary.set_record_count(block.records_size());
+
+  LabelBloomFilter filter;
+  uint64_t min_size = std::numeric_limits<uint64_t>::max();
+  uint64_t max_size = 0;
+  for (const auto& record : block.records()) {
+    for (const auto& label : record.meta_data()) {
+      filter.Add(label.key(), label.value());
+    }
+
+    const auto size = record.end() - record.begin();
+    min_size = std::min(min_size, size);
+    max_size = std::max(max_size, size);
+  }
+
+  summary.set_label_filter(filter.bits());
+  summary.set_min_record_size(block.records_size() > 0 ? min_size : 0);
+  summary.set_max_record_size(max_size);
+  return summary;
+}
+
+}  // namespace reduct::storage
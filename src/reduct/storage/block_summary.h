@@ -0,0 +1,65 @@
+// Copyright 2022 ReductStore
+// This Source Code Form is subject to the terms of the Mozilla Public
+//    License, v. 2.0. If a copy of the MPL was not distributed with this
+//    file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#ifndef REDUCT_STORAGE_BLOCK_SUMMARY_H
+#define REDUCT_STORAGE_BLOCK_SUMMARY_H
+
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "reduct/async/io.h"
+#include "reduct/proto/storage/entry.pb.h"
+#include "reduct/proto/storage/manifest.pb.h"
+
+namespace reduct::storage {
+
+/**
+ * Bloom filter of the labels of the records in a block.
+ * It has a fixed size, so a block with many unique labels saturates it and it matches everything.
+ * The hash is stable, because the filter is persisted
+ */
+class LabelBloomFilter {
+ public:
+  static constexpr size_t kBits = 512;
+  static constexpr size_t kHashes = 4;
+
+  LabelBloomFilter() : bits_(kBits / 8, '\0') {}
+
+  /**
+   * Takes the bits of a persisted filter
+   * @param bits must have kBits / 8 bytes, otherwise the filter matches everything
+   */
+  explicit LabelBloomFilter(std::string bits) : bits_(std::move(bits)) {}
+
+  void Add(std::string_view name, std::string_view value);
+
+  /**
+   * @return false if no record in the block has the label
+   */
+  [[nodiscard]] bool MayContain(std::string_view name, std::string_view value) const;
+
+  /**
+   * @return false if no record in the block has all the labels
+   */
+  [[nodiscard]] bool MayContainAll(const async::LabelMap& labels) const;
+
+  [[nodiscard]] const std::string& bits() const { return bits_; }
+
+ private:
+  std::string bits_;
+};
+
+/**
+ * Summarizes a block with the label filter and the sizes of the records, so a query can skip it without loading
+ * the descriptor
+ * @param block
+ * @return
+ */
+proto::BlockSummary SummarizeBlock(const proto::Block& block);
+
+}  // namespace reduct::storage
+
+#endif  // REDUCT_STORAGE_BLOCK_SUMMARY_H
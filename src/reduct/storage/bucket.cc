@@ -7,9 +7,15 @@
 #include <google/protobuf/util/time_util.h>
 
 #include <fstream>
+#include <future>
+#include <mutex>
 #include <numeric>
+#include <optional>
+#include <queue>
 #include <ranges>
 #include <regex>
+#include <set>
+#include <unordered_map>
 
 #include "reduct/config.h"
 #include "reduct/core/logger.h"
@@ -25,16 +31,151 @@ using proto::api::EntryInfo;
 
 using google::protobuf::util::TimeUtil;
 
+/**
+ * Keeps the size, the latest records and a min-heap of the oldest blocks of the entries of a bucket, so the FIFO quota costs
+ * O(log entries) per removed block and the statistics don't load block descriptors.
+ * The entries update it under their own locks, so it has its own mutex and never calls the entries
+ */
+class UsageTracker {
+ public:
+  using Block = std::pair<core::Time, std::string>;  // begin time of the oldest block and name of its entry
+
+  struct Stats {
+    int64_t size;
+    std::optional<core::Time> oldest_record;
+    std::optional<core::Time> latest_record;
+  };
+
+  void Update(const std::string& entry_name, const IEntry::Usage& usage) {
+    std::lock_guard lock(mutex_);
+    size_ += usage.size_delta;
+
+    auto& entry = entries_[entry_name];
+    if (entry.oldest_block != usage.oldest_block) {
+      entry.oldest_block = usage.oldest_block;
+      if (entry.oldest_block) {
+        heap_.emplace(*entry.oldest_block, entry_name);
+      }
+    }
+
+    if (entry.latest_record != usage.latest_record) {
+      EraseLatest(entry.latest_record);
+      entry.latest_record = usage.latest_record;
+      if (entry.latest_record) {
+        latest_records_.insert(*entry.latest_record);
+      }
+    }
+  }
+
+  [[nodiscard]] int64_t size() const {
+    std::lock_guard lock(mutex_);
+    return size_;
+  }
+
+  [[nodiscard]] Stats GetStats() const {
+    std::lock_guard lock(mutex_);
+    DropOutdated();
+    return {
+        .size = size_,
+        .oldest_record = heap_.empty() ? std::nullopt : std::optional(heap_.top().first),
+        .latest_record = latest_records_.empty() ? std::nullopt : std::optional(*latest_records_.rbegin()),
+    };
+  }
+
+  /**
+   * Takes the oldest block of the bucket from the heap. The outdated items are dropped on the way
+   * @return nullopt if there are no blocks
+   */
+  std::optional<Block> PopOldest() {
+    std::lock_guard lock(mutex_);
+    DropOutdated();
+    if (heap_.empty()) {
+      return std::nullopt;
+    }
+
+    auto block = heap_.top();
+    heap_.pop();
+    return block;
+  }
+
+  /**
+   * Puts back a block which wasn't removed
+   */
+  void Push(Block block) {
+    std::lock_guard lock(mutex_);
+    if (IsActual(block)) {
+      heap_.push(std::move(block));
+    }
+  }
+
+  [[nodiscard]] bool HasBlocks(const std::string& entry_name) const {
+    std::lock_guard lock(mutex_);
+    auto it = entries_.find(entry_name);
+    return it != entries_.end() && it->second.oldest_block;
+  }
+
+  void Remove(const std::string& entry_name) {
+    std::lock_guard lock(mutex_);
+    auto it = entries_.find(entry_name);
+    if (it != entries_.end()) {
+      EraseLatest(it->second.latest_record);
+      entries_.erase(it);
+    }
+  }
+
+ private:
+  struct EntryState {
+    std::optional<core::Time> oldest_block;
+    std::optional<core::Time> latest_record;
+  };
+
+  [[nodiscard]] bool IsActual(const Block& block) const {
+    auto it = entries_.find(block.second);
+    return it != entries_.end() && it->second.oldest_block == block.first;
+  }
+
+  void DropOutdated() const {
+    while (!heap_.empty() && !IsActual(heap_.top())) {
+      heap_.pop();
+    }
+  }
+
+  void EraseLatest(const std::optional<core::Time>& latest_record) {
+    if (!latest_record) {
+      return;
+    }
+
+    // the value may be missing, e.g. after restoring from a stale manifest
+    if (auto it = latest_records_.find(*latest_record); it != latest_records_.end()) {
+      latest_records_.erase(it);
+    }
+  }
+
+  int64_t size_{};
+  std::unordered_map<std::string, EntryState> entries_;
+  mutable std::priority_queue<Block, std::vector<Block>, std::greater<>> heap_;
+  std::multiset<core::Time> latest_records_;
+  mutable std::mutex mutex_;
+};
+
+/**
+ * Bucket of entries.
+ * It is safe to use from many threads: the public methods lock the bucket, then the entries lock themselves
+ */
 class Bucket : public IBucket {
  public:
   explicit Bucket(fs::path full_path, BucketSettings settings)
-      : full_path_(std::move(full_path)), name_(full_path_.filename().string()), entry_map_() {
+      : full_path_(std::move(full_path)),
+        name_(full_path_.filename().string()),
+        entry_map_(),
+        usage_(std::make_shared<UsageTracker>()) {
     if (fs::exists(full_path_)) {
       throw std::runtime_error(fmt::format("Path '{}' already exists", full_path_.string()));
     }
 
     const auto& default_settings = Bucket::GetDefaults();
     settings_ = InitSettings(std::move(settings), default_settings);
+    syncer_ = io::IFileSyncer::Build(GetSyncerOptions());
 
     fs::create_directories(full_path_);
     auto err = SaveDescriptor();
@@ -43,8 +184,12 @@ class Bucket : public IBucket {
     }
   }
 
-  explicit Bucket(fs::path full_path)
-      : settings_{}, full_path_(std::move(full_path)), name_(full_path_.filename().string()), entry_map_() {
+  Bucket(fs::path full_path, async::ThreadPoolExecutor* executor, const proto::BucketManifest* manifest)
+      : settings_{},
+        full_path_(std::move(full_path)),
+        name_(full_path_.filename().string()),
+        entry_map_(),
+        usage_(std::make_shared<UsageTracker>()) {
     if (!fs::exists(full_path_)) {
       throw std::runtime_error(fmt::format("Path '{}' doesn't exist", full_path_.string()));
     }
@@ -56,25 +201,53 @@ class Bucket : public IBucket {
     }
 
     settings_.ParseFromIstream(&settings_file);
+    syncer_ = io::IFileSyncer::Build(GetSyncerOptions());
+
+    std::map<std::string, const proto::EntryManifest*> entry_manifests;
+    if (manifest) {
+      for (const auto& entry_manifest : manifest->entries()) {
+        entry_manifests[entry_manifest.name()] = &entry_manifest;
+      }
+    }
 
+    // entries scan their blocks, so they are restored in parallel if there is a pool
+    std::vector<std::pair<std::string, std::future<IEntry::UPtr>>> entries;
     for (const auto& folder : fs::directory_iterator(full_path_)) {
       if (fs::is_directory(folder)) {
         auto entry_name = folder.path().filename().string();
-        auto entry = IEntry::Build(folder.path().filename().string(), folder.path().parent_path().string(),
-                                   {
-                                       .max_block_size = settings_.max_block_size(),
-                                       .max_block_records = settings_.max_block_records(),
-                                   });
-        if (entry) {
-          entry_map_[entry_name] = std::move(entry);
+        auto entry_manifest = entry_manifests.contains(entry_name) ? entry_manifests[entry_name] : nullptr;
+        auto restore = [this, folder = folder.path(), entry_manifest] {
+          return IEntry::Build(folder.filename().string(), folder.parent_path().string(),
+                               {
+                                   .max_block_size = settings_.max_block_size(),
+                                   .max_block_records = settings_.max_block_records(),
+                                   .syncer = syncer_,
+                               },
+                               entry_manifest);
+        };
+
+        if (executor) {
+          entries.emplace_back(entry_name, executor->Commit(std::move(restore)));
         } else {
-          LOG_ERROR("Failed to restore entry '{}'", entry_name);
+          std::promise<IEntry::UPtr> restored;
+          restored.set_value(restore());
+          entries.emplace_back(entry_name, restored.get_future());
         }
       }
     }
+
+    for (auto& [entry_name, future] : entries) {
+      if (auto entry = executor ? executor->Wait(std::move(future)) : future.get()) {
+        TrackUsage(entry_name, entry.get());
+        entry_map_[entry_name] = std::move(entry);
+      } else {
+        LOG_ERROR("Failed to restore entry '{}'", entry_name);
+      }
+    }
   }
 
   core::Result<IEntry::WPtr> GetOrCreateEntry(const std::string& name) override {
+    std::lock_guard lock(mutex_);
     if (name.empty()) {
       return {{}, {.code = 422, .message = "An empty entry name is not allowed"}};
     }
@@ -92,9 +265,11 @@ class Bucket : public IBucket {
                                  {
                                      .max_block_size = settings_.max_block_size(),
                                      .max_block_records = settings_.max_block_records(),
+                                     .syncer = syncer_,
                                  });
 
       if (entry) {
+        TrackUsage(name, entry.get());
         std::shared_ptr<IEntry> ptr = std::move(entry);
         entry_map_[name] = ptr;
         return {ptr, Error::kOk};
@@ -104,99 +279,182 @@ class Bucket : public IBucket {
     return {std::weak_ptr<IEntry>(), Error{.code = 500, .message = fmt::format("Failed to create bucket '{}'", name)}};
   }
 
+  core::Result<IEntry::WPtr> GetEntry(const std::string& name) const override {
+    std::lock_guard lock(mutex_);
+    auto it = entry_map_.find(name);
+    if (it == entry_map_.end()) {
+      return {{}, Error::NotFound(fmt::format("Entry '{}' is not found", name))};
+    }
+
+    return {it->second, Error::kOk};
+  }
+
   [[nodiscard]] Error Clean() override {
+    std::lock_guard lock(mutex_);
     fs::remove_all(full_path_);
     entry_map_ = {};
+    usage_ = std::make_shared<UsageTracker>();
     return Error::kOk;
   }
 
-  [[nodiscard]] Error KeepQuota() override {
-    auto err = Error::kOk;
-    switch (settings_.quota_type()) {
-      case BucketSettings::NONE:
-        break;
-      case BucketSettings::FIFO:
-        size_t bucket_size = GetInfo().size();
-        while (bucket_size > settings_.quota_size()) {
-          LOG_DEBUG("Size of bucket '{}' is {} bigger than quota {}. Remove the oldest record",
-                    full_path_.filename().string(), bucket_size, settings_.quota_size());
-
-          auto rr =
-              entry_map_ | std::views::values | std::views::transform([](auto entry) { return entry->GetInfo(); });
-
-          std::vector<EntryInfo> candidates(std::ranges::begin(rr), std::ranges::end(rr));
-          std::ranges::sort(candidates, [](auto& a, auto& b) { return a.oldest_record() < b.oldest_record(); });
-
-          bool success = false;
-          for (auto& entry : candidates) {
-            LOG_DEBUG("Remove the oldest block in entry '{}'", entry.name());
-            auto entry_ptr = entry_map_.at(entry.name());
-            err = entry_ptr->RemoveOldestBlock();
-            if (!err) {
-              if (entry_ptr->GetInfo().block_count() == 0) {
-                entry_map_.erase(entry.name());
-                fs::remove(full_path_ / entry.name());
-              }
-
-              bucket_size = GetInfo().size();
-              success = true;
-              break;
-            }
-          }
-
-          if (!success) {
-            return {.code = 500, .message = "No blocks to remove"};
-          }
-        }
+  [[nodiscard]] Error KeepQuota(size_t reserve) override {
+    std::lock_guard lock(mutex_);
+    if (settings_.quota_type() != BucketSettings::FIFO) {
+      return Error::kOk;
+    }
+
+    // a record bigger than the quota leaves the bucket empty
+    const auto limit =
+        std::max<int64_t>(static_cast<int64_t>(settings_.quota_size()) - static_cast<int64_t>(reserve), 0);
+    while (true) {
+      auto [removed, err] = ReclaimOldestBlockOver(limit);
+      if (err || removed == 0) {
+        return err;
+      }
+    }
+  }
+
+  [[nodiscard]] core::Result<size_t> ReclaimOldestBlock(double fill) override {
+    std::lock_guard lock(mutex_);
+    if (settings_.quota_type() != BucketSettings::FIFO) {
+      return {0, Error::kOk};
+    }
+
+    return ReclaimOldestBlockOver(static_cast<int64_t>(fill * static_cast<double>(settings_.quota_size())));
+  }
+
+  [[nodiscard]] double GetQuotaFill() const override {
+    std::lock_guard lock(mutex_);
+    if (settings_.quota_type() == BucketSettings::NONE) {
+      return 0;
     }
-    return err;
+
+    if (settings_.quota_size() == 0) {
+      return usage_->size() > 0 ? std::numeric_limits<double>::infinity() : 0;
+    }
+
+    return static_cast<double>(usage_->size()) / static_cast<double>(settings_.quota_size());
   }
 
   Error SetSettings(BucketSettings settings) override {
+    std::lock_guard lock(mutex_);
     settings_ = InitSettings(std::move(settings), settings_);
+    syncer_->SetOptions(GetSyncerOptions());
     for (auto [key, entry] : entry_map_) {
       entry->SetOptions({
           .max_block_size = settings_.max_block_size(),
           .max_block_records = settings_.max_block_records(),
+          .syncer = syncer_,
       });
     }
     return SaveDescriptor();
   }
 
   std::vector<EntryInfo> GetEntryList() const override {
+    std::lock_guard lock(mutex_);
     auto rr = entry_map_ | std::views::values | std::views::transform([](auto entry) { return entry->GetInfo(); });
     return std::vector(std::ranges::begin(rr), std::ranges::end(rr));
   }
 
-  bool HasEntry(const std::string& name) const override { return entry_map_.contains(name); }
+  bool HasEntry(const std::string& name) const override {
+    std::lock_guard lock(mutex_);
+    return entry_map_.contains(name);
+  }
 
   [[nodiscard]] BucketInfo GetInfo() const override {
-    size_t record_count = 0;
-    size_t size = 0;
-    uint64_t oldest_ts = std::numeric_limits<uint64_t>::max();
-    uint64_t latest_ts = 0;
-
-    for (const auto& [_, entry] : entry_map_) {
-      auto info = entry->GetInfo();
-      record_count += info.record_count();
-      size += info.size();
-
-      oldest_ts = std::min(oldest_ts, info.oldest_record());
-      latest_ts = std::max(latest_ts, info.latest_record());
-    }
+    std::lock_guard lock(mutex_);
+    const auto stats = usage_->GetStats();
 
     BucketInfo info;
     info.set_name(name_);
-    info.set_size(size);
+    info.set_size(stats.size);
     info.set_entry_count(entry_map_.size());
-    info.set_oldest_record(oldest_ts);
-    info.set_latest_record(latest_ts);
+    if (stats.oldest_record) {
+      info.set_oldest_record(core::ToMicroseconds(*stats.oldest_record));
+      info.set_latest_record(core::ToMicroseconds(*stats.latest_record));
+    } else {
+      // the entries without blocks have zero times
+      info.set_oldest_record(entry_map_.empty() ? std::numeric_limits<uint64_t>::max() : 0);
+      info.set_latest_record(0);
+    }
     return info;
   }
 
-  [[nodiscard]] const BucketSettings& GetSettings() const override { return settings_; }
+  [[nodiscard]] proto::BucketManifest GetManifest() const override {
+    std::lock_guard lock(mutex_);
+    proto::BucketManifest manifest;
+    manifest.set_name(name_);
+    for (const auto& [_, entry] : entry_map_) {
+      *manifest.add_entries() = entry->GetManifest();
+    }
+    return manifest;
+  }
+
+  [[nodiscard]] BucketSettings GetSettings() const override {
+    std::lock_guard lock(mutex_);
+    return settings_;
+  }
 
  private:
+  /**
+   * Removes the oldest block which isn't in use if the bucket is bigger than the limit
+   * @note the bucket must be locked
+   * @return size of the removed block, 0 if the bucket fits the limit
+   */
+  core::Result<size_t> ReclaimOldestBlockOver(int64_t limit) {
+    core::Result<size_t> result{0, Error::kOk};
+    std::vector<UsageTracker::Block> busy_blocks;  // blocks with readers or writers go back to the heap
+    while (usage_->size() > limit) {
+      LOG_DEBUG("Size of bucket '{}' is {} bigger than {}. Remove the oldest block", name_, usage_->size(), limit);
+
+      auto block = usage_->PopOldest();
+      if (!block) {
+        result.error = {.code = 500, .message = "No blocks to remove"};
+        break;
+      }
+
+      const auto& entry_name = block->second;
+      auto entry_it = entry_map_.find(entry_name);
+      if (entry_it == entry_map_.end()) {
+        continue;
+      }
+
+      LOG_DEBUG("Remove the oldest block in entry '{}'", entry_name);
+      const auto size = usage_->size();
+      if (entry_it->second->RemoveOldestBlock()) {
+        busy_blocks.push_back(std::move(*block));
+        continue;
+      }
+
+      result.result = std::max<int64_t>(size - usage_->size(), 0);  // writers may grow the bucket meanwhile
+      if (!usage_->HasBlocks(entry_name)) {
+        entry_map_.erase(entry_it);
+        usage_->Remove(entry_name);
+
+        // the folder may still have journals or summaries, and this runs in the reclaimer thread, so don't throw
+        std::error_code ec;
+        fs::remove_all(full_path_ / entry_name, ec);
+        if (ec) {
+          result.error = Error::InternalError(fmt::format("Failed to remove entry '{}': {}", entry_name, ec.message()));
+        }
+      }
+      break;
+    }
+
+    for (auto& busy_block : busy_blocks) {
+      usage_->Push(std::move(busy_block));
+    }
+    return result;
+  }
+
+  /**
+   * Subscribes the usage tracker to the changes of the entry
+   */
+  void TrackUsage(const std::string& entry_name, IEntry* entry) {
+    entry->SetOnUsageChanged(
+        [tracker = usage_, entry_name](const IEntry::Usage& usage) { tracker->Update(entry_name, usage); });
+  }
+
   static BucketSettings InitSettings(BucketSettings&& settings, const BucketSettings& default_settings) {
     if (!settings.has_max_block_size()) {
       settings.set_max_block_size(default_settings.max_block_size());
@@ -214,9 +472,21 @@ class Bucket : public IBucket {
       settings.set_max_block_records(default_settings.max_block_records());
     }
 
+    if (!settings.has_durability()) {
+      settings.set_durability(default_settings.durability());
+    }
+
     return settings;
   }
 
+  [[nodiscard]] io::IFileSyncer::Options GetSyncerOptions() const {
+    return {
+        .durability = settings_.durability(),
+        .sync_interval = std::chrono::milliseconds(kDefaultSyncInterval),
+        .sync_size = kDefaultSyncSize,
+    };
+  }
+
   core::Error SaveDescriptor() const {
     const auto settings_path = full_path_ / kSettingsName;
     std::ofstream settings_file(settings_path, std::ios::binary);
@@ -242,7 +512,10 @@ class Bucket : public IBucket {
   fs::path full_path_;
   std::string name_;
   BucketSettings settings_;
+  io::IFileSyncer::SPtr syncer_;
   std::map<std::string, std::shared_ptr<IEntry>> entry_map_;
+  std::shared_ptr<UsageTracker> usage_;  // shared with the callbacks of the entries which may outlive the bucket
+  mutable std::recursive_mutex mutex_;
 };
 
 std::unique_ptr<IBucket> IBucket::Build(std::filesystem::path full_path, BucketSettings settings) {
@@ -256,9 +529,10 @@ std::unique_ptr<IBucket> IBucket::Build(std::filesystem::path full_path, BucketS
   return bucket;
 }
 
-std::unique_ptr<IBucket> IBucket::Restore(std::filesystem::path full_path) {
+std::unique_ptr<IBucket> IBucket::Restore(std::filesystem::path full_path, async::ThreadPoolExecutor* executor,
+                                          const proto::BucketManifest* manifest) {
   try {
-    return std::make_unique<Bucket>(std::move(full_path));
+    return std::make_unique<Bucket>(std::move(full_path), executor, manifest);
   } catch (const std::exception& err) {
     LOG_ERROR(err.what());
   }
@@ -273,6 +547,7 @@ const BucketSettings& IBucket::GetDefaults() {
     default_settings.set_quota_type(BucketSettings::NONE);
     default_settings.set_quota_size(0);
     default_settings.set_max_block_records(kDefaultMaxBlockRecords);
+    default_settings.set_durability(BucketSettings::NO_SYNC);
   }
 
   return default_settings;
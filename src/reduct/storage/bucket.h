@@ -8,6 +8,7 @@
 #include <filesystem>
 #include <ostream>
 
+#include "reduct/async/thread_pool.h"
 #include "reduct/proto/api/bucket.pb.h"
 #include "reduct/storage/entry.h"
 
@@ -30,6 +31,13 @@ class IBucket {
    */
   [[nodiscard]] virtual core::Result<IEntry::WPtr> GetOrCreateEntry(const std::string& name) = 0;
 
+  /**
+   * @brief Gets an existing entry by name
+   * @param name
+   * @return 404 error if there is no entry with the name
+   */
+  [[nodiscard]] virtual core::Result<IEntry::WPtr> GetEntry(const std::string& name) const = 0;
+
   /**
    * @brief Remove data of all the buckets
    * @return
@@ -40,10 +48,24 @@ class IBucket {
    * @brief Bucket checks if it has data more than quota and remove some data
    * Depends on quota type:
    * kNone - does nothing
-   * kFifo - removes the oldest block in the bucket
+   * kFifo - removes the oldest blocks in the bucket until it fits the quota
+   * @param reserve size of data which is going to be written, so it must fit the quota too
    * @return error 500 if something goes wrong
    */
-  [[nodiscard]] virtual core::Error KeepQuota() = 0;
+  [[nodiscard]] virtual core::Error KeepQuota(size_t reserve = 0) = 0;
+
+  /**
+   * @brief Removes the oldest block if the bucket has FIFO quota and uses more than a share of it
+   * @param fill share of the quota size, 1.0 is the quota itself
+   * @return size of the removed block, 0 if nothing to remove, or error 500 if all the blocks are in use
+   */
+  [[nodiscard]] virtual core::Result<size_t> ReclaimOldestBlock(double fill) = 0;
+
+  /**
+   * @brief Returns the used share of the quota
+   * @return 0 if the bucket has no quota
+   */
+  [[nodiscard]] virtual double GetQuotaFill() const = 0;
 
   /**
    * @brief SetS bucket settings and save in descriptor
@@ -59,10 +81,16 @@ class IBucket {
   [[nodiscard]] virtual proto::api::BucketInfo GetInfo() const = 0;
 
   /**
-   * @brief Returns options of the bucket
+   * @brief Provides the manifests of the entries for the storage manifest
    * @return
    */
-  [[nodiscard]] virtual const proto::api::BucketSettings& GetSettings() const = 0;
+  [[nodiscard]] virtual proto::BucketManifest GetManifest() const = 0;
+
+  /**
+   * @brief Returns options of the bucket
+   * @return a copy, because another thread may change the settings
+   */
+  [[nodiscard]] virtual proto::api::BucketSettings GetSettings() const = 0;
 
   /**
    * Return list of entry names
@@ -82,9 +110,12 @@ class IBucket {
   /**
    * @brief Restores a bucket from folder
    * @param full_path
+   * @param executor if it is set, the entries are restored in parallel by the pool. It can be called in a task of the pool
+   * @param manifest if it is set, the entries which haven't changed since the checkpoint don't load their blocks
    * @return
    */
-  static IBucket::UPtr Restore(std::filesystem::path full_path);
+  static IBucket::UPtr Restore(std::filesystem::path full_path, async::ThreadPoolExecutor* executor = nullptr,
+                               const proto::BucketManifest* manifest = nullptr);
 
   /**
    * Gets default settings for a new bucket
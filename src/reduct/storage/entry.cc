@@ -8,7 +8,11 @@
 #include <fmt/core.h>
 #include <google/protobuf/util/time_util.h>
 
+#include <algorithm>
+#include <deque>
 #include <filesystem>
+#include <map>
+#include <mutex>
 #include <ranges>
 
 #include "reduct/async/io.h"
@@ -17,108 +21,529 @@
 #include "reduct/core/result.h"
 #include "reduct/proto/storage/entry.pb.h"
 #include "reduct/storage/block_manager.h"
+#include "reduct/storage/block_summary.h"
 #include "reduct/storage/io/async_reader.h"
 #include "reduct/storage/io/async_writer.h"
+#include "reduct/storage/query/filter.h"
 
 namespace reduct::storage {
 
 using core::Error;
 using core::Result;
+using core::FromMicroseconds;
 using core::Time;
+using core::ToMicroseconds;
 using io::AsyncReaderParameters;
 using proto::api::EntryInfo;
+using proto::api::RecordInfo;
+using proto::api::RecordInfoList;
 using query::IQuery;
 
-using google::protobuf::Timestamp;
 using google::protobuf::util::TimeUtil;
 auto to_time_t = core::Time::clock::to_time_t;
 
 namespace fs = std::filesystem;
 
+// the file systems keep mtime with a resolution of 1 ns..2 s
+constexpr auto kMtimeResolution = std::chrono::seconds(2);
+
+using EntryMutex = std::shared_ptr<std::recursive_mutex>;
+
+/**
+ * Writer which locks its entry, because the writer changes the block descriptor and notifies subscribers
+ */
+class LockedWriter : public async::IAsyncWriter {
+ public:
+  LockedWriter(async::IAsyncWriter::SPtr writer, EntryMutex mutex)
+      : writer_(std::move(writer)), mutex_(std::move(mutex)) {}
+
+  ~LockedWriter() override {
+    // the writer may finish its record in the destructor
+    std::lock_guard lock(*mutex_);
+    writer_.reset();
+  }
+
+  core::Error Write(std::string_view chunk, bool last) noexcept override {
+    std::lock_guard lock(*mutex_);
+    return writer_->Write(chunk, last);
+  }
+
+  [[nodiscard]] bool is_done() const noexcept override {
+    std::lock_guard lock(*mutex_);
+    return writer_->is_done();
+  }
+
+  [[nodiscard]] std::optional<core::Error> sync_result() noexcept override {
+    std::lock_guard lock(*mutex_);
+    return writer_->sync_result();
+  }
+
+ private:
+  async::IAsyncWriter::SPtr writer_;
+  EntryMutex mutex_;
+};
+
+/**
+ * Reader which locks its entry, because the block manager tracks readers of its blocks
+ */
+class LockedReader : public async::IAsyncReader {
+ public:
+  LockedReader(async::IAsyncReader::SPtr reader, EntryMutex mutex)
+      : reader_(std::move(reader)), mutex_(std::move(mutex)) {}
+
+  core::Result<DataChunk> Read() noexcept override {
+    std::lock_guard lock(*mutex_);
+    return reader_->Read();
+  }
+
+  [[nodiscard]] bool is_done() const noexcept override {
+    std::lock_guard lock(*mutex_);
+    return reader_->is_done();
+  }
+
+  [[nodiscard]] core::Time timestamp() const noexcept override { return reader_->timestamp(); }
+  [[nodiscard]] size_t size() const noexcept override { return reader_->size(); }
+  [[nodiscard]] const async::LabelMap& labels() const noexcept override { return reader_->labels(); }
+
+ private:
+  async::IAsyncReader::SPtr reader_;
+  EntryMutex mutex_;
+};
+
+/**
+ * Entry of a bucket.
+ * It is safe to use from many threads: each public method locks the entry and its readers and writers do the same.
+ */
 class Entry : public IEntry {
  public:
   /**
    * Create a new entry
    * @param options
    */
-  Entry(std::string_view name, std::filesystem::path path, Options options)
-      : name_(name), options_(std::move(options)), block_set_(), size_counter_{}, record_counter_{} {
+  Entry(std::string_view name, std::filesystem::path path, Options options, const proto::EntryManifest* manifest)
+      : name_(name),
+        options_(std::move(options)),
+        blocks_(),
+        size_counter_{},
+        record_counter_{},
+        latest_record_{},
+        mutex_(std::make_shared<std::recursive_mutex>()) {
     full_path_ = path / name_;
-    block_manager_ = IBlockManager::Build(full_path_);
-    if (!fs::create_directories(full_path_)) {
-      for (const auto& file : fs::directory_iterator(full_path_)) {
-        auto path = file.path();
-        if (fs::is_regular_file(file) && path.extension() == kMetaExt) {
-          try {
-            auto ts = TimeUtil::MicrosecondsToTimestamp(std::stoull(path.stem().c_str()));
-            auto [block, err] = block_manager_->LoadBlock(ts);
-
-            if (err || block->begin_time().seconds() == 0 || block->invalid()) {
-              LOG_WARNING("Block {} looks broken. Remove it.", path.string());
-              std::error_code ec;
-              if (!fs::remove(path, ec)) {
-                LOG_ERROR("Failed to remove {}: {}", path.string(), ec.message());
-              }
-
-              path = path.parent_path() / fmt::format("{}{}", path.stem().string(), kBlockExt);
-              if (!fs::remove(path, ec)) {
-                LOG_ERROR("Failed to remove {}: {}", path.string(), ec.message());
-              }
-              continue;
+    block_manager_ = IBlockManager::Build(full_path_, kDefaultBlockCacheSize, options_.syncer);
+    block_manager_->SetOnRecordFinished([this](int64_t ts) {
+      for (const auto& [id, callback] : subscribers_) {
+        callback(FromMicroseconds(ts));
+      }
+    });
+    if (!fs::create_directories(full_path_) && !(manifest && RestoreFromManifest(*manifest))) {
+      ScanBlocks();
+    }
+
+    for (const auto& summary : blocks_) {
+      size_counter_ += summary.size;
+      record_counter_ += summary.record_count;
+      latest_record_ = std::max(latest_record_, summary.latest_record);
+    }
+  }
+
+  ~Entry() override {
+    // the io ring may finish a record of a gone writer under the lock, it must find the block manager alive or gone
+    std::lock_guard lock(*mutex_);
+    block_manager_.reset();
+  }
+
+  [[nodiscard]] Result<async::IAsyncWriter::SPtr> BeginWrite(const Time& time, size_t content_size,
+                                                             const async::LabelMap& labels) override {
+    std::lock_guard lock(*mutex_);
+    auto [writer, err] = BeginWriteUnlocked(time, content_size, labels);
+    if (err) {
+      return {nullptr, err};
+    }
+
+    return {std::make_shared<LockedWriter>(std::move(writer), mutex_), Error::kOk};
+  }
+
+  [[nodiscard]] Result<async::IAsyncReader::SPtr> BeginRead(const Time& time, ReadMode mode) const override {
+    std::lock_guard lock(*mutex_);
+    auto record_time = time;
+    if (mode != ReadMode::kExact) {
+      auto [ts, err] = FindRecordTime(ToMicroseconds(time), mode);
+      if (err) {
+        return err;
+      }
+      record_time = FromMicroseconds(ts);
+    }
+
+    auto [reader, err] = BeginReadUnlocked(record_time);
+    if (err) {
+      return {nullptr, err};
+    }
+
+    return {std::make_shared<LockedReader>(std::move(reader), mutex_), Error::kOk};
+  }
+
+  core::Result<uint64_t> Query(const std::optional<Time>& start, const std::optional<Time>& stop,
+                               const query::IQuery::Options& options) override {
+    std::lock_guard lock(*mutex_);
+    RemoveOutDatedQueries();
+
+    queries_[next_query_id_] = QueryInfo{
+        .stop = (stop ? *stop : Time::max()),
+        .last_update = Time::clock::now(),
+        .options = options,
+        .cursor = {.next_ts = ToMicroseconds(start ? *start : Time::min())},
+    };
+
+    return {next_query_id_++, Error::kOk};
+  }
+
+  Result<NextRecord> Next(uint64_t query_id) const override {
+    std::lock_guard lock(*mutex_);
+    auto [next, err] = NextUnlocked(query_id);
+    if (err != Error::kOk) {
+      return {{}, err};
+    }
+
+    next.reader = std::make_shared<LockedReader>(std::move(next.reader), mutex_);
+    return {next, Error::kOk};
+  }
+
+  Error RemoveOldestBlock() override {
+    std::lock_guard lock(*mutex_);
+    if (blocks_.empty()) {
+      return Error::InternalError("Tries to remove a block in empty entry");
+    }
+
+    auto [first_block, err] = block_manager_->LoadBlock(blocks_.front().begin_time);
+    if (err) {
+      return err;
+    }
+
+    if (auto remove_err = block_manager_->RemoveBlock(first_block)) {
+      return remove_err;
+    }
+
+    // the cursors on the removed block will find the next one
+    for (auto& [id, query] : queries_) {
+      if (query.cursor.block && query.cursor.block_ts == blocks_.front().begin_time) {
+        query.cursor.block = nullptr;
+      }
+    }
+
+    size_counter_ -= first_block->size();
+    record_counter_ -= first_block->records_size();
+    blocks_.pop_front();
+    if (blocks_.empty()) {
+      latest_record_ = 0;
+    }
+
+    NotifyUsage(-static_cast<int64_t>(first_block->size()));
+    return Error::kOk;
+  }
+
+  [[nodiscard]] EntryInfo GetInfo() const override {
+    std::lock_guard lock(*mutex_);
+    EntryInfo info;
+    info.set_name(name_);
+    info.set_size(size_counter_);
+    info.set_record_count(record_counter_);
+    info.set_block_count(blocks_.size());
+    info.set_oldest_record(blocks_.empty() ? 0 : blocks_.front().begin_time);
+    info.set_latest_record(latest_record_);
+
+    return info;
+  }
+
+  [[nodiscard]] Result<RecordInfoList> List(const std::optional<Time>& start, const std::optional<Time>& stop,
+                                            size_t limit) const override {
+    std::lock_guard lock(*mutex_);
+    const auto start_ts = ToMicroseconds(start ? *start : Time::min());
+    const auto stop_ts = ToMicroseconds(stop ? *stop : Time::max());
+
+    RecordInfoList list;
+    list.set_last(true);
+    if (blocks_.empty()) {
+      return {std::move(list), Error::kOk};
+    }
+
+    // only the descriptors are loaded, the records are taken from the sorted index
+    for (auto it = FindBlockIt(start_ts); it != blocks_.end() && it->begin_time < stop_ts; ++it) {
+      auto [block, err] = block_manager_->LoadBlock(it->begin_time);
+      if (err) {
+        return {{}, std::move(err)};
+      }
+
+      const auto& index = block_manager_->GetRecordIndex(block);
+      auto pos = std::ranges::lower_bound(index.timestamps, start_ts) - index.timestamps.begin();
+      for (; pos < static_cast<int64_t>(index.size()) && index.timestamps[pos] < stop_ts; ++pos) {
+        if (static_cast<size_t>(list.records_size()) == limit) {
+          list.set_last(false);
+          return {std::move(list), Error::kOk};
+        }
+
+        const auto& record = block->records(index.indexes[pos]);
+        auto info = list.add_records();
+        info->set_ts(index.timestamps[pos]);
+        info->set_size(record.end() - record.begin());
+        info->set_state(static_cast<RecordInfo::State>(record.state()));
+      }
+    }
+
+    return {std::move(list), Error::kOk};
+  }
+
+  [[nodiscard]] proto::EntryManifest GetManifest() const override {
+    std::lock_guard lock(*mutex_);
+    proto::EntryManifest manifest;
+    manifest.set_name(name_);
+
+    // a change in the same tick of the file system clock keeps the mtime, so only an old mtime proves the blocks
+    std::error_code ec;
+    const auto mtime = fs::last_write_time(full_path_, ec);
+    if (!ec && fs::file_time_type::clock::now() - mtime > kMtimeResolution) {
+      manifest.set_mtime(std::chrono::duration_cast<std::chrono::nanoseconds>(mtime.time_since_epoch()).count());
+    }
+
+    for (const auto& summary : blocks_) {
+      *manifest.add_blocks() = ToProto(summary);
+    }
+    return manifest;
+  }
+
+  uint64_t Subscribe(OnRecordFinished callback) override {
+    std::lock_guard lock(*mutex_);
+    subscribers_[next_subscriber_id_] = std::move(callback);
+    return next_subscriber_id_++;
+  }
+
+  void Unsubscribe(uint64_t id) override {
+    std::lock_guard lock(*mutex_);
+    subscribers_.erase(id);
+  }
+
+  void SetOnUsageChanged(OnUsageChanged callback) override {
+    std::lock_guard lock(*mutex_);
+    on_usage_changed_ = std::move(callback);
+    NotifyUsage(static_cast<int64_t>(size_counter_));
+  }
+
+  [[nodiscard]] Options GetOptions() const override {
+    std::lock_guard lock(*mutex_);
+    return options_;
+  }
+
+  void SetOptions(const Options& options) override {
+    std::lock_guard lock(*mutex_);
+    options_ = options;
+  }
+
+ private:
+  /**
+   * Summary of a block, so that the entry finds blocks and keeps statistics without loading descriptors
+   */
+  struct BlockSummary {
+    int64_t begin_time;        // begin time of the block in microseconds
+    int64_t latest_record;     // timestamp of the latest record in microseconds
+    uint64_t size;             // size of the records in bytes
+    uint64_t record_count;     // number of the records
+    std::string label_filter;  // bloom filter of the labels, empty if the block isn't finished
+    uint64_t min_record_size;  // size of the smallest record in bytes, if the block is finished
+    uint64_t max_record_size;  // size of the largest record in bytes, if the block is finished
+  };
+
+  // a flat sorted list: new blocks go to the end and the FIFO quota removes them from the front
+  using BlockList = std::deque<BlockSummary>;
+
+  /**
+   * Takes the valid summaries of the finished blocks, loads the descriptors of the others (replaying their journals)
+   * and removes the broken ones
+   */
+  void ScanBlocks() {
+    for (const auto& file : fs::directory_iterator(full_path_)) {
+      auto path = file.path();
+      if (fs::is_regular_file(file) && path.extension() == kMetaExt) {
+        try {
+          const auto begin_time = std::stoll(path.stem().c_str());
+          if (auto [summary, summary_err] = block_manager_->LoadSummary(begin_time); !summary_err) {
+            PutSummary(FromProto(summary));  // the block is finished and unchanged, so its descriptor isn't needed
+            continue;
+          }
+
+          auto [block, err] = block_manager_->LoadBlock(begin_time);
+
+          if (err || block->begin_time().seconds() == 0 || block->invalid()) {
+            LOG_WARNING("Block {} looks broken. Remove it.", path.string());
+            std::error_code ec;
+            if (!fs::remove(path, ec)) {
+              LOG_ERROR("Failed to remove {}: {}", path.string(), ec.message());
             }
 
-            block_set_.insert(ts);
-            size_counter_ += block->size();
-            record_counter_ += block->records_size();
-          } catch (std::exception& err) {
-            LOG_ERROR("Wrong filename format {}: {}", path.string(), err.what());
+            path = path.parent_path() / fmt::format("{}{}", path.stem().string(), kBlockExt);
+            if (!fs::remove(path, ec)) {
+              LOG_ERROR("Failed to remove {}: {}", path.string(), ec.message());
+            }
+
+            path.replace_extension(kJournalExt);
+            fs::remove(path, ec);
+            path.replace_extension(kSummaryExt);
+            fs::remove(path, ec);
+            continue;
           }
+
+          PutSummary(Summarize(*block));
+        } catch (std::exception& err) {
+          LOG_ERROR("Wrong filename format {}: {}", path.string(), err.what());
         }
       }
     }
   }
 
-  [[nodiscard]] Result<async::IAsyncWriter::SPtr> BeginWrite(const Time& time, size_t content_size) override {
+  /**
+   * Takes the blocks from the manifest if the folder of the entry hasn't changed since the checkpoint.
+   * The latest block is written without changing the folder, so its descriptor is loaded anyway
+   * @return false if the manifest is stale
+   */
+  bool RestoreFromManifest(const proto::EntryManifest& manifest) {
+    std::error_code ec;
+    const auto mtime = fs::last_write_time(full_path_, ec);
+    if (ec || manifest.mtime() == 0 ||
+        manifest.mtime() != std::chrono::duration_cast<std::chrono::nanoseconds>(mtime.time_since_epoch()).count()) {
+      LOG_DEBUG("Manifest of entry '{}' is stale", name_);
+      return false;
+    }
+
+    for (const auto& summary : manifest.blocks()) {
+      PutSummary(FromProto(summary));
+    }
+
+    if (!blocks_.empty()) {
+      auto [block, err] = block_manager_->LoadBlock(blocks_.back().begin_time);
+      if (err || block->begin_time().seconds() == 0 || block->invalid()) {
+        blocks_.clear();
+        return false;
+      }
+
+      blocks_.back() = Summarize(*block);
+    }
+
+    return true;
+  }
+
+  /**
+   * Summarizes a block which is being written, it has no label filter
+   */
+  static BlockSummary Summarize(const proto::Block& block) {
+    return {
+        .begin_time = TimeUtil::TimestampToMicroseconds(block.begin_time()),
+        .latest_record = TimeUtil::TimestampToMicroseconds(block.latest_record_time()),
+        .size = block.size(),
+        .record_count = static_cast<uint64_t>(block.records_size()),
+        .label_filter = {},
+        .min_record_size = 0,
+        .max_record_size = 0,
+    };
+  }
+
+  static BlockSummary FromProto(const proto::BlockSummary& summary) {
+    return {
+        .begin_time = TimeUtil::TimestampToMicroseconds(summary.begin_time()),
+        .latest_record = TimeUtil::TimestampToMicroseconds(summary.latest_record_time()),
+        .size = summary.size(),
+        .record_count = summary.record_count(),
+        .label_filter = summary.label_filter(),
+        .min_record_size = summary.min_record_size(),
+        .max_record_size = summary.max_record_size(),
+    };
+  }
+
+  static proto::BlockSummary ToProto(const BlockSummary& summary) {
+    proto::BlockSummary proto_summary;
+    *proto_summary.mutable_begin_time() = TimeUtil::MicrosecondsToTimestamp(summary.begin_time);
+    *proto_summary.mutable_latest_record_time() = TimeUtil::MicrosecondsToTimestamp(summary.latest_record);
+    proto_summary.set_size(summary.size);
+    proto_summary.set_record_count(summary.record_count);
+    proto_summary.set_label_filter(summary.label_filter);
+    proto_summary.set_min_record_size(summary.min_record_size);
+    proto_summary.set_max_record_size(summary.max_record_size);
+    return proto_summary;
+  }
+
+  /**
+   * Checks the label filter of a finished block. The latest block is being written, so it may have any labels
+   * @return false if no record in the block has all the labels
+   */
+  bool MayHaveLabels(const BlockSummary& summary, const async::LabelMap& labels) const {
+    if (labels.empty() || summary.label_filter.empty() || summary.begin_time == blocks_.back().begin_time) {
+      return true;
+    }
+
+    return LabelBloomFilter(summary.label_filter).MayContainAll(labels);
+  }
+
+  /**
+   * Inserts or updates the summary of a block. Usually it is the latest block, so it goes to the end
+   */
+  void PutSummary(const BlockSummary& summary) {
+    auto it = std::ranges::lower_bound(blocks_, summary.begin_time, {}, &BlockSummary::begin_time);
+    if (it != blocks_.end() && it->begin_time == summary.begin_time) {
+      *it = summary;
+    } else {
+      blocks_.insert(it, summary);
+    }
+  }
+
+  /**
+   * Finds the block which can have a record with the timestamp
+   * @return the last block which begins before or at the timestamp, or the first block if there is no such one
+   */
+  [[nodiscard]] BlockList::const_iterator FindBlockIt(int64_t ts) const {
+    auto it = std::ranges::upper_bound(blocks_, ts, {}, &BlockSummary::begin_time);
+    return it == blocks_.begin() ? it : std::prev(it);
+  }
+
+  Result<async::IAsyncWriter::SPtr> BeginWriteUnlocked(const Time& time, size_t content_size,
+                                                       const async::LabelMap& labels) {
     enum class RecordType { kLatest, kBelated, kBelatedFirst };
     RecordType type = RecordType::kLatest;
 
-    const auto proto_ts = FromTimePoint(time);
+    const auto ts = ToMicroseconds(time);
 
-    auto start_new_block = [this](const Timestamp& ts, size_t content_size) -> Result<IBlockManager::BlockSPtr> {
+    auto start_new_block = [this](int64_t ts, size_t content_size) -> Result<IBlockManager::BlockSPtr> {
       auto [block, err] = block_manager_->StartBlock(ts, std::max(options_.max_block_size, content_size));
       if (err) {
         return {{}, err};
       }
 
-      block_set_.insert(block->begin_time());
+      PutSummary(Summarize(*block));
+      NotifyUsage(0);
       return {block, Error::kOk};
     };
 
     auto get_block = [this, content_size, &start_new_block](auto ts) {
-      if (!block_set_.empty()) {
+      if (!blocks_.empty()) {
         // Load last block if it exists
-        return block_manager_->LoadBlock(*block_set_.rbegin());
+        return block_manager_->LoadBlock(blocks_.back().begin_time);
       } else {
         return start_new_block(ts, content_size);
       }
     };
 
-    auto [block, get_err] = get_block(proto_ts);
+    auto [block, get_err] = get_block(ts);
     if (get_err) {
       return {{}, std::move(get_err)};
     }
 
-    if (block->has_latest_record_time() && block->latest_record_time() >= proto_ts) {
-      LOG_DEBUG("Timestamp {} is belated. Finding proper block", TimeUtil::ToString(proto_ts));
+    if (block->has_latest_record_time() && TimeUtil::TimestampToMicroseconds(block->latest_record_time()) >= ts) {
+      LOG_DEBUG("Timestamp {} is belated. Finding proper block", ts);
 
       Result<IBlockManager::BlockSPtr> ret;
-      if (*block_set_.begin() > proto_ts) {
+      if (blocks_.front().begin_time > ts) {
         LOG_DEBUG("Timestamp earlier than first record");
         type = RecordType::kBelatedFirst;
-        ret = start_new_block(proto_ts, content_size);
+        ret = start_new_block(ts, content_size);
       } else {
         type = RecordType::kBelated;
-        ret = FindBlock(proto_ts);
+        ret = FindBlock(ts);
       }
 
       if (ret.error) {
@@ -126,14 +551,12 @@ class Entry : public IEntry {
       }
       block = ret.result;
       // Check if block doesn't have the record already
-      auto exist =
-          std::ranges::any_of(block->records(), [proto_ts](auto& record) { return record.timestamp() == proto_ts; });
-      if (exist) {
-        return Error::Conflict(
-            fmt::format("A record with timestamp {} already exists", TimeUtil::TimestampToMicroseconds(proto_ts)));
+      if (FindRecord(block, ts) != -1) {
+        return Error::Conflict(fmt::format("A record with timestamp {} already exists", ts));
       }
     }
 
+    const auto proto_ts = TimeUtil::MicrosecondsToTimestamp(ts);
     if (!block->has_begin_time()) {
       LOG_DEBUG("First record_entry for current block");
       block->mutable_begin_time()->CopyFrom(proto_ts);
@@ -146,9 +569,11 @@ class Entry : public IEntry {
       LOG_DEBUG("Create a new block");
       if (auto err = block_manager_->FinishBlock(block)) {
         LOG_WARNING("Failed to finish the current block: {}", err.ToString());
+      } else {
+        PutSummary(FromProto(SummarizeBlock(*block)));
       }
 
-      auto ret = start_new_block(proto_ts, content_size);
+      auto ret = start_new_block(ts, content_size);
       if (ret.error) {
         LOG_ERROR("Failed to create a next block");
         return ret.error;
@@ -163,25 +588,47 @@ class Entry : public IEntry {
     record->mutable_timestamp()->CopyFrom(proto_ts);
     record->set_begin(block->size());
     record->set_end(block->size() + content_size);
+    for (const auto& [name, value] : labels) {
+      auto label = record->add_meta_data();
+      label->set_key(name);
+      label->set_value(value);
+    }
 
     block->set_size(block->size() + content_size);
 
-    // Update counters
-    record_counter_++;
-    size_counter_ += content_size;
-
+    auto summary = Summarize(*block);
     switch (type) {
       case RecordType::kLatest:
         block->mutable_latest_record_time()->CopyFrom(proto_ts);
+        summary.latest_record = ts;
+        latest_record_ = ts;
         break;
       case RecordType::kBelatedFirst:
         block->mutable_begin_time()->CopyFrom(proto_ts);
         break;
       case RecordType::kBelated:
+        if (summary.begin_time != blocks_.back().begin_time) {
+          // the block is finished, its summary must have the labels before the record is written
+          auto finished_summary = SummarizeBlock(*block);
+          if (auto err = block_manager_->SaveSummary(finished_summary)) {
+            return {{}, std::move(err)};
+          }
+          summary = FromProto(finished_summary);
+
+          // the manifest checks the entry by the mtime of its folder and loads only the latest block
+          std::error_code ec;
+          fs::last_write_time(full_path_, fs::file_time_type::clock::now(), ec);
+        }
         break;
     }
 
-    if (auto err = block_manager_->SaveBlock(block)) {
+    // Update counters
+    PutSummary(summary);
+    record_counter_++;
+    size_counter_ += content_size;
+    NotifyUsage(static_cast<int64_t>(content_size));
+
+    if (auto err = block_manager_->AppendRecord(block, block->records_size() - 1)) {
       return {{}, std::move(err)};
     }
 
@@ -189,37 +636,97 @@ class Entry : public IEntry {
                                                  .path = BlockPath(full_path_, *block),
                                                  .record_index = block->records_size() - 1,
                                                  .size = content_size,
+                                                 .mutex = mutex_,
                                              });
   }
 
-  [[nodiscard]] Result<async::IAsyncReader::SPtr> BeginRead(const Time& time) const override {
-    const auto proto_ts = FromTimePoint(time);
+  void NotifyUsage(int64_t size_delta) const {
+    if (on_usage_changed_) {
+      on_usage_changed_({
+          .size_delta = size_delta,
+          .oldest_block = blocks_.empty() ? std::nullopt : std::optional(FromMicroseconds(blocks_.front().begin_time)),
+          .latest_record = blocks_.empty() ? std::nullopt : std::optional(FromMicroseconds(latest_record_)),
+      });
+    }
+  }
 
-    LOG_DEBUG("Read a record for ts={}", TimeUtil::ToString(proto_ts));
+  /**
+   * Finds the timestamp of the finished record which matches the timestamp in the given mode.
+   * It walks the blocks from the one which can have the timestamp, searches in their sorted indexes
+   * and skips the records which are being written or broken by their states
+   * @return timestamp of the record in microseconds or 404 if there is no such record
+   */
+  Result<int64_t> FindRecordTime(int64_t ts, ReadMode mode) const {
+    const auto not_found = Error::NotFound("No records for this timestamp");
+    if (blocks_.empty()) {
+      return not_found;
+    }
+
+    std::optional<int64_t> before;
+    if (mode == ReadMode::kBefore || mode == ReadMode::kNearest) {
+      for (auto it = std::make_reverse_iterator(std::next(FindBlockIt(ts))); it != blocks_.rend(); ++it) {
+        auto [block, err] = block_manager_->LoadBlock(it->begin_time);
+        if (err) {
+          return err;
+        }
 
-    if (block_set_.empty() || proto_ts < *block_set_.begin()) {
-      return Error::NotFound("No records for this timestamp");
+        const auto& index = block_manager_->GetRecordIndex(block);
+        auto pos = std::ranges::upper_bound(index.timestamps, ts) - index.timestamps.begin();
+        while (pos > 0 && index.states[pos - 1] != proto::Record::kFinished) {
+          --pos;
+        }
+
+        if (pos > 0) {
+          before = index.timestamps[pos - 1];
+          break;
+        }
+      }
     }
 
-    if (auto err = CheckLatestRecord(proto_ts)) {
-      return {{}, std::move(err)};
+    std::optional<int64_t> after;
+    if ((mode == ReadMode::kAfter || mode == ReadMode::kNearest) && before != ts) {
+      for (auto it = FindBlockIt(ts); it != blocks_.end(); ++it) {
+        auto [block, err] = block_manager_->LoadBlock(it->begin_time);
+        if (err) {
+          return err;
+        }
+
+        const auto& index = block_manager_->GetRecordIndex(block);
+        const auto from = std::ranges::lower_bound(index.timestamps, ts) - index.timestamps.begin();
+        if (auto pos = query::FindState(index.states, from, proto::Record::kFinished); pos < index.size()) {
+          after = index.timestamps[pos];
+          break;
+        }
+      }
     }
 
-    auto [block, err] = FindBlock(proto_ts);
-    if (err) {
-      LOG_ERROR("No block in entry '{}' for ts={}", name_, TimeUtil::ToString(proto_ts));
-      return Error::InternalError("Failed to find the needed block in descriptor");
+    if (before && (!after || ts - *before <= *after - ts)) {
+      return *before;
     }
 
-    int record_index = -1;
-    for (int i = 0; i < block->records_size(); ++i) {
-      const auto& current_record = block->records(i);
-      if (current_record.timestamp() == proto_ts) {
-        record_index = i;
-        break;
-      }
+    if (after) {
+      return *after;
+    }
+
+    return not_found;
+  }
+
+  Result<async::IAsyncReader::SPtr> BeginReadUnlocked(const Time& time) const {
+    const auto ts = ToMicroseconds(time);
+
+    LOG_DEBUG("Read a record for ts={}", ts);
+
+    if (blocks_.empty() || ts < blocks_.front().begin_time || ts > blocks_.back().latest_record) {
+      return Error::NotFound("No records for this timestamp");
     }
 
+    auto [block, err] = FindBlock(ts);
+    if (err) {
+      LOG_ERROR("No block in entry '{}' for ts={}", name_, ts);
+      return Error::InternalError("Failed to find the needed block in descriptor");
+    }
+
+    const int record_index = FindRecord(block, ts);
     if (record_index == -1) {
       return Error::NotFound("No records for this timestamp");
     }
@@ -227,7 +734,7 @@ class Entry : public IEntry {
     auto block_path = BlockPath(full_path_, *block);
     LOG_DEBUG("Found block {} with needed record", block_path.string());
 
-    auto record = block->records(record_index);
+    const auto& record = block->records(record_index);
     if (record.state() == proto::Record::kStarted) {
       return Error::TooEarly("Record is still being written");
     }
@@ -236,126 +743,56 @@ class Entry : public IEntry {
       return Error::InternalError("Record is broken");
     }
 
-    return block_manager_->BeginRead(
-        block, AsyncReaderParameters{
-                   .path = block_path, .record_index = record_index, .chunk_size = kDefaultMaxReadChunk, .time = time});
-  }
-
-  core::Result<uint64_t> Query(const std::optional<Time>& start, const std::optional<Time>& stop,
-                               const query::IQuery::Options& options) override {
-    static uint64_t query_id = 0;
-
-    RemoveOutDatedQueries();
-
-    const auto current_time = Time::clock::now();
-    queries_[query_id] = QueryInfo{
-        .start = (start ? *start : Time::min()),
-        .stop = (stop ? *stop : Time::max()),
-        .last_update = Time::clock::now(),
-        .options = options,
-    };
-
-    return {query_id++, Error::kOk};
+    return block_manager_->BeginRead(block, AsyncReaderParameters{.path = block_path,
+                                                                  .record_index = record_index,
+                                                                  .chunk_size = kDefaultMaxReadChunk,
+                                                                  .time = time,
+                                                                  .labels = Labels(record)});
   }
 
-  Result<NextRecord> Next(uint64_t query_id) const override {
+  Result<NextRecord> NextUnlocked(uint64_t query_id) const {
     RemoveOutDatedQueries();
 
     if (!queries_.contains(query_id)) {
       return Error::NotFound(fmt::format("Query id={} doesn't exist. It expired or was finished", query_id));
     }
 
-    if (block_set_.empty()) {
+    if (blocks_.empty()) {
       return Error::NoContent("No records in the entry");
     }
 
     auto& query_info = queries_[query_id];
     query_info.last_update = Time::clock::now();
 
-    auto start_ts = FromTimePoint(query_info.start);
-    if (query_info.next_record) {
-      start_ts = FromTimePoint(*query_info.next_record);
-    }
-    auto stop_ts = FromTimePoint(query_info.stop);
-
-    // Find start block
-    auto start_block = block_set_.upper_bound(start_ts);
-    if (start_block == block_set_.end()) {
-      start_block = std::prev(start_block);
-    } else if (start_block != block_set_.begin()) {
-      start_block = std::prev(start_block);
-    }
-
-    auto [block, err] = block_manager_->LoadBlock(*start_block);
-    if (err) {
+    if (auto err = MoveCursor(&query_info); err != Error::kOk) {
       queries_.erase(query_id);
-      return {{}, err};
-    }
-
-    // Check if it is valid
-    if (block->invalid()) {
-      start_block = std::next(start_block);
-      if (start_block != std::end(block_set_) && *start_block < stop_ts) {
-        const auto [next_block, next_err] = block_manager_->LoadBlock(*start_block);
-        if (next_err) {
-          queries_.erase(query_id);
-          return {{}, next_err};
-        }
-
-        block = next_block;
-      } else {
-        queries_.erase(query_id);
-        return Error::NoContent();
-      }
-    }
-
-    std::vector<int> records;
-    records.reserve(block->records_size());
-    for (auto record_index = 0; record_index < block->records_size(); ++record_index) {
-      const auto& record = block->records(record_index);
-      if (record.timestamp() >= start_ts && record.timestamp() < stop_ts &&
-          record.state() == proto::Record::kFinished) {
-        records.push_back(record_index);
-      }
+      return err;
     }
 
-    if (records.empty()) {
-      queries_.erase(query_id);
-      return Error::NoContent();
-    }
+    const auto block = query_info.cursor.block;
+    const auto& index = block_manager_->GetRecordIndex(block);
+    const auto ts = index.timestamps[query_info.cursor.position];
+    const auto record_index = index.indexes[query_info.cursor.position];
+    const auto time = FromMicroseconds(ts);
 
-    auto get_timestamp = [block](int index) { return block->records(index).timestamp(); };
-    std::ranges::sort(records, {}, get_timestamp);
-    auto& record_index = records[0];
+    query_info.cursor.position++;
+    query_info.cursor.next_ts = ts + 1;
 
+    // look ahead to know if the record is the last one
     bool last = false;
-    if (records.size() > 1) {
-      query_info.next_record = ToTimePoint(get_timestamp(records[1]));
-    } else {
-      // Only one record in current block check next one
-      auto next_block_it = std::next(start_block);
-      if (next_block_it != std::end(block_set_)) {
-        if (*next_block_it < stop_ts) {
-          query_info.next_record = ToTimePoint(*next_block_it);
-        } else {
-          // no records in next block
-          last = true;
-        }
-      } else {
-        // no next block
-        last = true;
-      }
-    }
-
-    if (last) {
+    if (auto err = MoveCursor(&query_info); err.code == Error::kNoContent) {
+      last = true;
       queries_.erase(query_id);
+    } else if (err) {
+      LOG_ERROR("{}", err.ToString());  // the next call will try again
     }
 
     auto [reader, reader_err] =
         block_manager_->BeginRead(block, AsyncReaderParameters{.path = BlockPath(full_path_, *block),
                                                                .record_index = record_index,
                                                                .chunk_size = kDefaultMaxReadChunk,
-                                                               .time = ToTimePoint(get_timestamp(record_index))});
+                                                               .time = time,
+                                                               .labels = Labels(block->records(record_index))});
     if (reader_err) {
       return reader_err;
     }
@@ -368,85 +805,26 @@ class Entry : public IEntry {
     return {next_record, Error::kOk};
   }
 
-  Error RemoveOldestBlock() override {
-    if (block_set_.empty()) {
-      return Error::InternalError("Tries to remove a block in empty entry");
-    }
-
-    auto [first_block, err] = block_manager_->LoadBlock(*block_set_.begin());
-    if (err) {
-      return err;
+  static async::LabelMap Labels(const proto::Record& record) {
+    async::LabelMap labels;
+    for (const auto& label : record.meta_data()) {
+      labels[label.key()] = label.value();
     }
-
-    if (auto remove_err = block_manager_->RemoveBlock(first_block)) {
-      return remove_err;
-    }
-
-    size_counter_ -= first_block->size();
-    record_counter_ -= first_block->records_size();
-    block_set_.erase(block_set_.begin());
-    return Error::kOk;
+    return labels;
   }
 
-  [[nodiscard]] EntryInfo GetInfo() const override {
-    Timestamp oldest_record, latest_record;
-    if (!block_set_.empty()) {
-      auto [latest_block, err] = block_manager_->LoadBlock(*block_set_.rbegin());
-      if (err) {
-        LOG_ERROR("{}", err.ToString());
-      }
-
-      oldest_record = *block_set_.begin();
-      latest_record = latest_block->latest_record_time();
-    }
-
-    EntryInfo info;
-    info.set_name(name_);
-    info.set_size(size_counter_);
-    info.set_record_count(record_counter_);
-    info.set_block_count(block_set_.size());
-    info.set_oldest_record(TimeUtil::TimestampToMicroseconds(oldest_record));
-    info.set_latest_record(TimeUtil::TimestampToMicroseconds(latest_record));
-
-    return info;
+  Result<IBlockManager::BlockSPtr> FindBlock(int64_t ts) const {
+    return block_manager_->LoadBlock(FindBlockIt(ts)->begin_time);
   }
 
-  [[nodiscard]] const Options& GetOptions() const override { return options_; }
-
-  void SetOptions(const Options& options) override { options_ = options; }
-
- private:
-  Result<IBlockManager::BlockSPtr> FindBlock(Timestamp proto_ts) const {
-    auto ts = block_set_.upper_bound(proto_ts);
-    if (ts == block_set_.end()) {
-      proto_ts = *block_set_.rbegin();
-    } else {
-      proto_ts = *std::prev(ts);
-    }
-
-    return block_manager_->LoadBlock(proto_ts);
-  }
-
-  static google::protobuf::Timestamp FromTimePoint(const Time& time) {
-    auto microseconds = std::chrono::duration_cast<std::chrono::microseconds>(time.time_since_epoch()).count();
-    return TimeUtil::MicrosecondsToTimestamp(microseconds);
-  }
-
-  static Time ToTimePoint(const google::protobuf::Timestamp& time) {
-    return Time() + std::chrono::microseconds(TimeUtil::TimestampToMicroseconds(time));
-  }
-
-  Error CheckLatestRecord(const Timestamp& proto_ts) const {
-    auto [block, err] = block_manager_->LoadBlock(*block_set_.rbegin());
-    if (err) {
-      return err;
-    }
-
-    if (block->latest_record_time() < proto_ts) {
-      return Error::NotFound("No records for this timestamp");
-    }
-
-    return Error::kOk;
+  /**
+   * Finds a record in the block with binary search
+   * @return index of the record or -1 if there is no record with this timestamp
+   */
+  int FindRecord(const IBlockManager::BlockSPtr& block, int64_t ts) const {
+    const auto& index = block_manager_->GetRecordIndex(block);
+    auto it = std::ranges::lower_bound(index.timestamps, ts);
+    return it != index.timestamps.end() && *it == ts ? index.indexes[it - index.timestamps.begin()] : -1;
   }
 
   void RemoveOutDatedQueries() const {
@@ -462,25 +840,128 @@ class Entry : public IEntry {
   Options options_;
   fs::path full_path_;
 
-  std::set<google::protobuf::Timestamp> block_set_;
+  BlockList blocks_;  // summaries of the blocks sorted by their begin times
   std::shared_ptr<IBlockManager> block_manager_;
   size_t size_counter_;
   size_t record_counter_;
+  int64_t latest_record_;  // kept in memory, so the statistics don't load the latest block
+
+  /**
+   * Position of a query in the entry, so that Next doesn't search for the record from scratch
+   */
+  struct QueryCursor {
+    int64_t block_ts;                              // begin time of the current block
+    IBlockManager::BlockSPtr block;                // pinned descriptor, nullptr if the cursor isn't in a block yet
+    size_t position;                               // position of the next record in the sorted index of the block
+    size_t index_size;                             // size of the index when the position was found
+    int64_t next_ts;                               // the next record is not earlier than this timestamp in us
+  };
 
   struct QueryInfo {
-    Time start;
     Time stop;
-    std::optional<Time> next_record;
     Time last_update;
 
     query::IQuery::Options options;
+    QueryCursor cursor;
   };
 
+  /**
+   * Moves the cursor of the query to the next finished record in the query interval.
+   * It loads a descriptor only when the cursor crosses a block boundary
+   * @param query
+   * @return Error::NoContent if there are no more records
+   */
+  Error MoveCursor(QueryInfo* query) const {
+    auto& cursor = query->cursor;
+    const auto stop_ts = ToMicroseconds(query->stop);
+
+    auto pin_block = [this, &cursor](int64_t block_ts) {
+      auto [block, err] = block_manager_->LoadBlock(block_ts);
+      if (err) {
+        return err;
+      }
+
+      cursor.block_ts = block_ts;
+      cursor.block = std::move(block);
+      cursor.index_size = 0;
+      cursor.position = 0;
+      return Error::kOk;
+    };
+
+    // the summaries of finished blocks tell which blocks have no records with the labels, so they aren't loaded
+    auto may_match = [this, query](const BlockSummary& summary) {
+      return MayHaveLabels(summary, query->options.include);
+    };
+
+    if (!cursor.block) {
+      // start with the block which can have the next record
+      auto block_it = std::find_if(FindBlockIt(cursor.next_ts), blocks_.end(), may_match);
+      if (block_it == blocks_.end() || block_it->begin_time >= stop_ts) {
+        return Error::NoContent();
+      }
+
+      if (auto err = pin_block(block_it->begin_time)) {
+        return err;
+      }
+    }
+
+    while (true) {
+      const auto& index = block_manager_->GetRecordIndex(cursor.block);
+      if (cursor.index_size != index.size()) {
+        // new records could be inserted before the position
+        cursor.position = std::ranges::lower_bound(index.timestamps, cursor.next_ts) - index.timestamps.begin();
+        cursor.index_size = index.size();
+      }
+
+      // the label index tells at once if the block has no records with the labels
+      const query::LabelFilter filter(index, query->options.include, query->options.exclude);
+      if (cursor.block->invalid() || filter.rejects_block()) {
+        cursor.position = index.size();
+      }
+
+      // the index is sorted, so the stop is found with binary search and only the states are scanned
+      const auto end = std::ranges::lower_bound(index.timestamps, stop_ts) - index.timestamps.begin();
+      const auto states = std::span(index.states).first(end);
+      while (cursor.position < static_cast<size_t>(end)) {
+        cursor.position = query::FindState(states, cursor.position, proto::Record::kFinished);
+        if (cursor.position == static_cast<size_t>(end)) {
+          break;
+        }
+
+        if (filter.empty() || filter(index.indexes[cursor.position])) {
+          return Error::kOk;
+        }
+        cursor.position++;
+      }
+
+      if (cursor.position < index.size()) {
+        return Error::NoContent();  // the record at the position is after the stop
+      }
+
+      // the blocks before the cursor may be removed, so the next one is found by time
+      auto next_block_it = std::find_if(
+          std::ranges::upper_bound(blocks_, cursor.block_ts, {}, &BlockSummary::begin_time), blocks_.end(), may_match);
+      if (next_block_it == blocks_.end() || next_block_it->begin_time >= stop_ts) {
+        return Error::NoContent();
+      }
+
+      if (auto err = pin_block(next_block_it->begin_time)) {
+        return err;
+      }
+    }
+  }
+
   mutable std::unordered_map<uint64_t, QueryInfo> queries_;
+  uint64_t next_query_id_{};
+  std::map<uint64_t, OnRecordFinished> subscribers_;
+  OnUsageChanged on_usage_changed_;
+  uint64_t next_subscriber_id_{};
+  EntryMutex mutex_;
 };
 
-IEntry::UPtr IEntry::Build(std::string_view name, const fs::path& path, IEntry::Options options) {
-  return std::make_unique<Entry>(name, path, options);
+IEntry::UPtr IEntry::Build(std::string_view name, const fs::path& path, IEntry::Options options,
+                           const proto::EntryManifest* manifest) {
+  return std::make_unique<Entry>(name, path, options, manifest);
 }
 
 };  // namespace reduct::storage
@@ -7,6 +7,8 @@
 #define REDUCT_STORAGE_ENTRY_H
 
 #include <filesystem>
+#include <functional>
+#include <optional>
 #include <ostream>
 #include <vector>
 
@@ -14,7 +16,9 @@
 #include "reduct/core/result.h"
 #include "reduct/core/time.h"
 #include "reduct/proto/api/entry.pb.h"
+#include "reduct/proto/storage/manifest.pb.h"
 #include "reduct/storage/io/async_io.h"
+#include "reduct/storage/io/file_syncer.h"
 #include "reduct/storage/query/quiery.h"
 
 namespace reduct::storage {
@@ -34,12 +38,46 @@ class IEntry : public io::IAsyncIO, public query::IQuery {
    * Options
    */
   struct Options {
-    size_t max_block_size;     // max block quota_size after that we create a new one
-    size_t max_block_records;  // max number of records in a block
+    size_t max_block_size;         // max block quota_size after that we create a new one
+    size_t max_block_records;      // max number of records in a block
+    io::IFileSyncer::SPtr syncer;  // syncs written data to disk, nothing is synced if it is nullptr
 
     std::strong_ordering operator<=>(const Options& rhs) const = default;
   };
 
+  using OnRecordFinished = std::function<void(const core::Time&)>;
+
+  /**
+   * @brief Subscribes to records which are written completely
+   * @param callback is called with the timestamp of a finished record
+   * @return id of the subscription
+   */
+  virtual uint64_t Subscribe(OnRecordFinished callback) = 0;
+
+  /**
+   * @brief Removes a subscription
+   * @param id
+   */
+  virtual void Unsubscribe(uint64_t id) = 0;
+
+  /**
+   * Change of the entry's usage, so the bucket can keep its quota and statistics without scanning the entries
+   */
+  struct Usage {
+    int64_t size_delta;                        // bytes added to (positive) or removed from (negative) the entry
+    std::optional<core::Time> oldest_block;   // begin time of the oldest block, nullopt if the entry has no blocks
+    std::optional<core::Time> latest_record;  // time of the latest record, nullopt if the entry has no blocks
+  };
+
+  using OnUsageChanged = std::function<void(const Usage&)>;
+
+  /**
+   * @brief Sets a callback for changes of the size, the oldest block and the latest record
+   * The callback is called at once with the current usage and then under the entry lock, so it mustn't call the entry
+   * @param callback
+   */
+  virtual void SetOnUsageChanged(OnUsageChanged callback) = 0;
+
   /**
    * @brief Remove the oldest block from disk
    * @return
@@ -52,10 +90,27 @@ class IEntry : public io::IAsyncIO, public query::IQuery {
   [[nodiscard]] virtual proto::api::EntryInfo GetInfo() const = 0;
 
   /**
-   * @brief Provides current options of the entry
+   * @brief Lists the records of a time interval from the block descriptors without reading their data
+   * @param start start point of time interval. If it is nullopt then first record
+   * @param stop stop point of time interval. If it is nullopt then last record
+   * @param limit max number of records in the list
+   * @return records sorted by timestamp
+   */
+  [[nodiscard]] virtual core::Result<proto::api::RecordInfoList> List(const std::optional<core::Time>& start,
+                                                                      const std::optional<core::Time>& stop,
+                                                                      size_t limit) const = 0;
+
+  /**
+   * @brief Provides the summaries of the blocks for the storage manifest
    * @return
    */
-  [[nodiscard]] virtual const Options& GetOptions() const = 0;
+  [[nodiscard]] virtual proto::EntryManifest GetManifest() const = 0;
+
+  /**
+   * @brief Provides current options of the entry
+   * @return a copy, because another thread may change the options
+   */
+  [[nodiscard]] virtual Options GetOptions() const = 0;
 
   /**
    * @brief Set options
@@ -64,12 +119,13 @@ class IEntry : public io::IAsyncIO, public query::IQuery {
   virtual void SetOptions(const Options&) = 0;
 
   /**
-   * @brief Creates a new entry.
-   * Directory path/name must be empty
+   * @brief Creates a new entry or restores it from path/name
    * @param options
+   * @param manifest if it isn't stale, the entry takes its blocks from it and loads only the latest block
    * @return pointer to entre or nullptr if failed to create
    */
-  static IEntry::UPtr Build(std::string_view name, const std::filesystem::path& path, Options options);
+  static IEntry::UPtr Build(std::string_view name, const std::filesystem::path& path, Options options,
+                            const proto::EntryManifest* manifest = nullptr);
 };
 
 }  // namespace reduct::storage
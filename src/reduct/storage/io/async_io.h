@@ -15,22 +15,36 @@ namespace reduct::storage::io {
 
 class IAsyncIO {
  public:
+  /**
+   * How BeginRead matches the timestamp with the stored records
+   */
+  enum class ReadMode {
+    kExact,    // the record with the timestamp
+    kBefore,   // the latest record at or before the timestamp
+    kAfter,    // the earliest record at or after the timestamp
+    kNearest,  // the record closest to the timestamp, the earlier one if there are two
+  };
+
   /**
    * @brief Write a data with timestamp to corresponding block
    * The method provides the best performance if a new timestamp is always new the stored ones.
    * Then the engine doesn't need to find a proper block and just records data into the current one.
    * @param time timestamp of the data
+   * @param size size of the data
+   * @param labels labels of the record, they are stored in its descriptor
    * @return async writer or error
    */
-  [[nodiscard]] virtual core::Result<async::IAsyncWriter::SPtr> BeginWrite(const core::Time& time, size_t size) = 0;
+  [[nodiscard]] virtual core::Result<async::IAsyncWriter::SPtr> BeginWrite(const core::Time& time, size_t size,
+                                                                           const async::LabelMap& labels = {}) = 0;
 
   /**
    * @brief Finds the record for the timestamp and read the blob
-   * Current implementation provide only exact matching.
    * @param time timestamp of record to read
+   * @param mode how to match the timestamp, the reader provides the timestamp of the found record
    * @return async reader or error (404 - if no record found, 500 some internal errors)
    */
-  [[nodiscard]] virtual core::Result<async::IAsyncReader::SPtr> BeginRead(const core::Time& time) const = 0;
+  [[nodiscard]] virtual core::Result<async::IAsyncReader::SPtr> BeginRead(const core::Time& time,
+                                                                          ReadMode mode = ReadMode::kExact) const = 0;
 };
 }  // namespace reduct::storage::io
 #endif  // REDUCT_STORAGE_ASYNC_IO_H
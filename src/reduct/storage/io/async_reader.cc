@@ -5,10 +5,17 @@
 
 #include "async_reader.h"
 
+#include <fmt/core.h>
 #include <google/protobuf/util/time_util.h>
 
-#include <fstream>
+#ifdef REDUCT_IO_URING
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 #include <algorithm>
+#include <cstring>
+#include <fstream>
 
 #include "reduct/core/logger.h"
 
@@ -36,10 +43,11 @@ class AsyncReader : public async::IAsyncReader {
       return {chunk, Error::InternalError("Bad block")};
     }
 
-    chunk.data.resize(std::min(parameters_.chunk_size, size_ - read_bytes_));
-    file_.read(chunk.data.data(), chunk.data.size());
-    read_bytes_ += chunk.data.size();
+    buffer_.resize(std::min(parameters_.chunk_size, size_ - read_bytes_));
+    file_.read(buffer_.data(), buffer_.size());
+    read_bytes_ += buffer_.size();
 
+    chunk.data = buffer_;
     chunk.last = size_ == read_bytes_;
 
     return {chunk, Error::kOk};
@@ -48,16 +56,144 @@ class AsyncReader : public async::IAsyncReader {
   size_t size() const noexcept override { return size_; }
   bool is_done() const noexcept override { return size_ == read_bytes_; }
   core::Time timestamp() const noexcept override { return parameters_.time; }
+  const async::LabelMap& labels() const noexcept override { return parameters_.labels; }
 
  private:
   AsyncReaderParameters parameters_;
   size_t size_;
   size_t read_bytes_;
   std::ifstream file_;
+  std::string buffer_;
 };
 
+/**
+ * @class Reader of a mapped block
+ * @brief Slices the record in the mapping, so the data isn't copied
+ */
+class MappedAsyncReader : public async::IAsyncReader {
+ public:
+  MappedAsyncReader(const proto::Block& block, AsyncReaderParameters parameters, IMappedFile::SPtr mapped_file)
+      : parameters_(std::move(parameters)), mapped_file_(std::move(mapped_file)), read_bytes_{} {
+    const auto& record = block.records(parameters_.record_index);
+    record_ = mapped_file_->data().substr(record.begin(), record.end() - record.begin());
+  }
+
+  core::Result<DataChunk> Read() noexcept override {
+    DataChunk chunk{
+        .data = record_.substr(read_bytes_, parameters_.chunk_size),
+    };
+
+    read_bytes_ += chunk.data.size();
+    chunk.last = record_.size() == read_bytes_;
+    return {chunk, Error::kOk};
+  }
+
+  size_t size() const noexcept override { return record_.size(); }
+  bool is_done() const noexcept override { return record_.size() == read_bytes_; }
+  core::Time timestamp() const noexcept override { return parameters_.time; }
+  const async::LabelMap& labels() const noexcept override { return parameters_.labels; }
+
+ private:
+  AsyncReaderParameters parameters_;
+  IMappedFile::SPtr mapped_file_;
+  std::string_view record_;
+  size_t read_bytes_;
+};
+
+#ifdef REDUCT_IO_URING
+/**
+ * @class Reader based on io_uring
+ * @brief Submits reading of the next chunk and returns Error::Continue until it is completed
+ */
+class RingAsyncReader : public async::IAsyncReader {
+ public:
+  RingAsyncReader(const proto::Block& block, AsyncReaderParameters parameters)
+      : parameters_(std::move(parameters)), read_bytes_{} {
+    fd_ = ::open(parameters_.path.c_str(), O_RDONLY);
+
+    const auto& record = block.records(parameters_.record_index);
+    offset_ = record.begin();
+    size_ = record.end() - record.begin();
+  }
+
+  ~RingAsyncReader() override {
+    if (fd_ >= 0) {
+      ::close(fd_);
+    }
+  }
+
+  core::Result<DataChunk> Read() noexcept override {
+    DataChunk chunk;
+    if (fd_ < 0) {
+      return {chunk, Error::InternalError("Bad block")};
+    }
+
+    if (!ring_ && !(ring_ = IIoRing::Instance())) {
+      return {chunk, Error::InternalError("No io_uring in the thread")};
+    }
+
+    if (!operation_) {
+      operation_ = std::make_shared<IIoRing::Operation>();
+      operation_->buffer.resize(std::min(parameters_.chunk_size, size_ - read_bytes_));
+      if (auto err = ring_->SubmitRead(fd_, offset_ + read_bytes_, operation_)) {
+        operation_.reset();
+        return {chunk, std::move(err)};
+      }
+    }
+
+    ring_->Poll();
+    if (!operation_->completed) {
+      return {chunk, Error::Continue("Chunk is being read")};
+    }
+
+    auto operation = std::move(operation_);
+    if (operation->result < 0) {
+      return {chunk, Error::InternalError(fmt::format("Failed to read a chunk from a block: {}",
+                                                      std::strerror(static_cast<int>(-operation->result))))};
+    }
+
+    if (operation->result == 0 && !operation->buffer.empty()) {
+      return {chunk, Error::InternalError("Bad block")};
+    }
+
+    // a short read is fine, we read the rest with the next chunk
+    buffer_ = std::move(operation->buffer);
+    buffer_.resize(operation->result);
+    read_bytes_ += buffer_.size();
+
+    chunk.data = buffer_;
+    chunk.last = size_ == read_bytes_;
+    return {chunk, Error::kOk};
+  }
+
+  size_t size() const noexcept override { return size_; }
+  bool is_done() const noexcept override { return size_ == read_bytes_; }
+  core::Time timestamp() const noexcept override { return parameters_.time; }
+  const async::LabelMap& labels() const noexcept override { return parameters_.labels; }
+
+ private:
+  AsyncReaderParameters parameters_;
+  IIoRing::SPtr ring_;  // of the thread of the first read
+  int fd_;
+  size_t offset_;
+  size_t size_;
+  size_t read_bytes_;
+  IIoRing::OperationSPtr operation_;
+  std::string buffer_;
+};
+
+async::IAsyncReader::UPtr BuildRingAsyncReader(const proto::Block& block, AsyncReaderParameters parameters) {
+  return std::make_unique<RingAsyncReader>(block, std::move(parameters));
+}
+#endif
+
 async::IAsyncReader::UPtr BuildAsyncReader(const proto::Block& block, AsyncReaderParameters parameters) {
   return std::make_unique<AsyncReader>(block, std::move(parameters));
 }
 
+async::IAsyncReader::UPtr BuildMappedAsyncReader(const proto::Block& block, AsyncReaderParameters parameters,
+                                                 IMappedFile::SPtr mapped_file) {
+  return std::make_unique<MappedAsyncReader>(block, std::move(parameters), std::move(mapped_file));
+}
+
 }  // namespace reduct::storage::io
@@ -9,8 +9,14 @@
 #include <filesystem>
 
 #include "reduct/async/io.h"
+#include "reduct/config.h"
 #include "reduct/core/time.h"
 #include "reduct/proto/storage/entry.pb.h"
+#include "reduct/storage/io/mapped_file.h"
+
+#ifdef REDUCT_IO_URING
+#include "reduct/storage/io/io_ring.h"
+#endif
 
 namespace reduct::storage::io {
 
@@ -19,10 +25,38 @@ struct AsyncReaderParameters {
   int record_index;
   size_t chunk_size;
   core::Time time;
+  async::LabelMap labels;
 };
 
+/**
+ * Builds a reader which reads a record from the block file with a stream and copies it chunk by chunk
+ * @param block
+ * @param parameters
+ * @return
+ */
 async::IAsyncReader::UPtr BuildAsyncReader(const proto::Block& block, AsyncReaderParameters parameters);
 
+/**
+ * Builds a reader which provides slices of the mapped block file without copying
+ * @param block
+ * @param parameters
+ * @param mapped_file mapping of the block, it must contain the record
+ * @return
+ */
+async::IAsyncReader::UPtr BuildMappedAsyncReader(const proto::Block& block, AsyncReaderParameters parameters,
+                                                 IMappedFile::SPtr mapped_file);
+
+#ifdef REDUCT_IO_URING
+/**
+ * Builds a reader which submits reading to io_uring and doesn't block.
+ * IAsyncReader::Read returns Error::Continue until a chunk is read
+ * @param block
+ * @param parameters
+ * @return
+ */
+async::IAsyncReader::UPtr BuildRingAsyncReader(const proto::Block& block, AsyncReaderParameters parameters);
+#endif
+
 }  // namespace reduct::storage::io
 
 #endif  // REDUCT_STORAGE_IO_ASYNC_READER_H
@@ -5,8 +5,17 @@
 
 #include "async_writer.h"
 
+#include <fmt/core.h>
+
+#ifdef REDUCT_IO_URING
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <cstring>
 #include <filesystem>
 #include <fstream>
+#include <mutex>
 #include <utility>
 
 #include "reduct/core/logger.h"
@@ -58,7 +67,13 @@ class AsyncWriter : public async::IAsyncWriter {
       }
 
       update_record_(record, proto::Record::kFinished);
-      file_ << std::flush;
+      file_.close();  // the writer may wait for syncing, it mustn't keep the file open
+
+      if (parameters_.syncer) {
+        auto journal_path = parameters_.path;
+        journal_path.replace_extension(kJournalExt);
+        sync_result_ = parameters_.syncer->Sync({parameters_.path, journal_path}, writen_size_);
+      }
     }
 
     return Error::kOk;
@@ -66,13 +81,204 @@ class AsyncWriter : public async::IAsyncWriter {
 
   bool is_done() const noexcept override { return writen_size_ == parameters_.size; }
 
+  std::optional<Error> sync_result() noexcept override {
+    if (!is_done()) {
+      return std::nullopt;
+    }
+
+    if (!sync_result_.valid()) {
+      return Error::kOk;
+    }
+
+    if (sync_result_.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+      return std::nullopt;
+    }
+
+    return sync_result_.get();
+  }
+
  private:
   std::ofstream file_;
   AsyncWriterParameters parameters_;
   size_t writen_size_;
   OnStateUpdated update_record_;
+  std::shared_future<Error> sync_result_;
+};
+
+#ifdef REDUCT_IO_URING
+/**
+ * @class Writer based on io_uring
+ * @brief Copies chunks and submits them to the ring, so the loop doesn't wait for the disk.
+ * The record is marked as finished only after all the chunks are written.
+ */
+class RingAsyncWriter : public async::IAsyncWriter {
+ public:
+  RingAsyncWriter(const proto::Block& block, AsyncWriterParameters parameters, OnStateUpdated callback)
+      : state_(std::make_shared<State>()) {
+    state_->parameters = std::move(parameters);
+    state_->update_record = std::move(callback);
+    state_->fd = ::open(state_->parameters.path.c_str(), O_WRONLY);
+    offset_ = block.records(state_->parameters.record_index).begin();
+  }
+
+  ~RingAsyncWriter() override {
+    if (!state_->last || state_->result) {
+      return;
+    }
+
+    ring_->Poll();
+    if (state_->Finish()) {
+      return;
+    }
+
+    // the record must get its final state even if nobody waits for it, the ring finishes it in the loop
+    ring_->Adopt([state = state_] {
+      std::unique_lock<std::recursive_mutex> lock;
+      if (state->parameters.mutex) {
+        lock = std::unique_lock(*state->parameters.mutex);
+      }
+      return state->Finish().has_value();
+    });
+  }
+
+  Error Write(std::string_view chunk, bool last) noexcept override {
+    const auto& record = state_->parameters.record_index;
+    if (state_->fd < 0) {
+      state_->update_record(record, proto::Record::kInvalid);
+      return Error::InternalError("Bad block");
+    }
+
+    if (!ring_ && !(ring_ = IIoRing::Instance())) {
+      state_->update_record(record, proto::Record::kInvalid);
+      return Error::InternalError("No io_uring in the thread");
+    }
+
+    state_->writen_size += chunk.size();
+    if (state_->writen_size > state_->parameters.size) {
+      state_->update_record(record, proto::Record::kErrored);
+      return Error::BadRequest("Content is bigger than in content-length");
+    }
+
+    if (last && state_->writen_size < state_->parameters.size) {
+      state_->update_record(record, proto::Record::kErrored);
+      return Error::BadRequest("Content is smaller than in content-length");
+    }
+
+    auto operation = std::make_shared<IIoRing::Operation>();
+    operation->buffer = chunk;
+    if (auto err = ring_->SubmitWrite(state_->fd, offset_, operation)) {
+      state_->update_record(record, proto::Record::kInvalid);
+      return err;
+    }
+
+    offset_ += chunk.size();
+    state_->pending.push_back(std::move(operation));
+    state_->last = last;
+    return Error::kOk;
+  }
+
+  bool is_done() const noexcept override { return state_->result.has_value(); }
+
+  std::optional<Error> sync_result() noexcept override {
+    if (state_->result || !ring_) {
+      return state_->result;  // nothing is submitted yet
+    }
+
+    ring_->Poll();
+    return state_->Finish();
+  }
+
+ private:
+  /**
+   * The part of the writer which finishes the record. The ring may keep it after the writer is destroyed
+   */
+  struct State {
+    AsyncWriterParameters parameters;
+    size_t writen_size{};
+    OnStateUpdated update_record;
+    int fd{-1};
+    bool last{};
+    std::vector<IIoRing::OperationSPtr> pending;
+    Error error;
+    std::shared_future<Error> sync_future;
+    std::optional<Error> result;
+
+    ~State() {
+      if (fd >= 0) {
+        ::close(fd);  // the submitted operations hold the file in the kernel
+      }
+    }
+
+    /**
+     * Checks the polled operations and finishes the record when all of them are completed
+     * @return std::nullopt if the record is still being written or synced
+     */
+    std::optional<Error> Finish() noexcept {
+      if (result) {
+        return result;
+      }
+
+      std::erase_if(pending, [this](const auto& operation) {
+        if (!operation->completed) {
+          return false;
+        }
+
+        if (operation->result < 0) {
+          error = Error::InternalError(fmt::format("Failed to write a chunk into a block: {}",
+                                                   std::strerror(static_cast<int>(-operation->result))));
+        } else if (operation->result != operation->buffer.size()) {
+          error = Error::InternalError("Failed to write a chunk into a block");
+        }
+        return true;
+      });
+
+      if (!last || !pending.empty()) {
+        return std::nullopt;
+      }
+
+      if (fd >= 0) {
+        ::close(fd);  // all the chunks are written, so the record waits for the sync without holding the file
+        fd = -1;
+      }
+
+      if (!sync_future.valid()) {
+        if (error) {
+          update_record(parameters.record_index, proto::Record::kInvalid);
+          result = error;
+          return result;
+        }
+
+        update_record(parameters.record_index, proto::Record::kFinished);
+        if (!parameters.syncer) {
+          result = Error::kOk;
+          return result;
+        }
+
+        auto journal_path = parameters.path;
+        journal_path.replace_extension(kJournalExt);
+        sync_future = parameters.syncer->Sync({parameters.path, journal_path}, writen_size);
+      }
+
+      if (sync_future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        return std::nullopt;
+      }
+
+      result = sync_future.get();
+      return result;
+    }
+  };
+
+  std::shared_ptr<State> state_;
+  IIoRing::SPtr ring_;  // of the thread of the first write
+  size_t offset_;
 };
 
+async::IAsyncWriter::UPtr BuildRingAsyncWriter(const proto::Block& block, AsyncWriterParameters parameters,
+                                               OnStateUpdated callback) {
+  return std::make_unique<RingAsyncWriter>(block, std::move(parameters), std::move(callback));
+}
+#endif
+
 async::IAsyncWriter::UPtr BuildAsyncWriter(const proto::Block& block, AsyncWriterParameters parameters,
                                            OnStateUpdated callback) {
   return std::make_unique<AsyncWriter>(block, std::move(parameters), std::move(callback));
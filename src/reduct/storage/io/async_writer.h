@@ -7,9 +7,16 @@
 #define REDUCT_STORAGE_IO_ASYNC_WRITER_H
 
 #include <filesystem>
+#include <mutex>
 
 #include "reduct/async/io.h"
+#include "reduct/config.h"
 #include "reduct/proto/storage/entry.pb.h"
+#include "reduct/storage/io/file_syncer.h"
+
+#ifdef REDUCT_IO_URING
+#include "reduct/storage/io/io_ring.h"
+#endif
 
 namespace reduct::storage::io {
 
@@ -17,6 +24,8 @@ struct AsyncWriterParameters {
   std::filesystem::path path;
   int record_index;
   size_t size;
+  IFileSyncer::SPtr syncer;  // nullptr if the data needn't be synced
+  std::shared_ptr<std::recursive_mutex> mutex;  // lock of the entry to finish the record after the writer is gone
 };
 
 using OnStateUpdated = std::function<void(int, proto::Record::State)>;
@@ -24,6 +33,19 @@ using OnStateUpdated = std::function<void(int, proto::Record::State)>;
 async::IAsyncWriter::UPtr BuildAsyncWriter(const proto::Block& block, AsyncWriterParameters parameters,
                                            OnStateUpdated callback);
 
+#ifdef REDUCT_IO_URING
+/**
+ * Builds a writer which submits chunks to io_uring and doesn't block.
+ * The record is finished when IAsyncWriter::sync_result finds all the chunks written
+ * @param block
+ * @param parameters
+ * @param callback
+ * @return
+ */
+async::IAsyncWriter::UPtr BuildRingAsyncWriter(const proto::Block& block, AsyncWriterParameters parameters,
+                                               OnStateUpdated callback);
+#endif
+
 }  // namespace reduct::storage::io
 
 #endif  // REDUCT_STORAGE_IO_ASYNC_WRITER_H
@@ -0,0 +1,210 @@
+// Copyright 2022 ReductStore
+// This Source Code Form is subject to the terms of the Mozilla Public
+//    License, v. 2.0. If a copy of the MPL was not distributed with this
+//    file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#include "reduct/storage/io/file_syncer.h"
+
+#include <fcntl.h>
+#include <fmt/core.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <set>
+#include <thread>
+
+#include "reduct/core/logger.h"
+
+namespace reduct::storage::io {
+
+using core::Error;
+using proto::api::BucketSettings;
+
+namespace fs = std::filesystem;
+
+Error SyncFile(const fs::path& path) {
+#ifdef _WIN32
+  if (fs::is_directory(path)) {
+    return Error::kOk;  // Windows can't sync directories
+  }
+
+  int fd = _open(path.string().c_str(), _O_RDWR | _O_BINARY);
+#else
+  int fd = ::open(path.c_str(), O_RDONLY);
+#endif
+  if (fd < 0) {
+    if (errno == ENOENT) {
+      return Error::kOk;
+    }
+    return Error::InternalError(fmt::format("Failed to open {} to sync: {}", path.string(), std::strerror(errno)));
+  }
+
+#if defined(_WIN32)
+  int ret = _commit(fd);
+  _close(fd);
+#elif defined(__linux__)
+  int ret = ::fdatasync(fd);
+  ::close(fd);
+#else
+  int ret = ::fsync(fd);
+  ::close(fd);
+#endif
+
+  if (ret != 0) {
+    return Error::InternalError(fmt::format("Failed to sync {}: {}", path.string(), std::strerror(errno)));
+  }
+
+  return Error::kOk;
+}
+
+static std::shared_future<Error> MakeReadyFuture(Error err) {
+  std::promise<Error> promise;
+  promise.set_value(std::move(err));
+  return promise.get_future().share();
+}
+
+static Error SyncFiles(const std::set<fs::path>& paths) {
+  Error result;
+  for (const auto& path : paths) {
+    if (auto err = SyncFile(path)) {
+      LOG_ERROR("{}", err.ToString());
+      result = std::move(err);
+    }
+  }
+
+  return result;
+}
+
+/**
+ * Group commit: collects dirty files and syncs them in a background thread,
+ * so that many writes pay for one sync and the writers never wait for the disk.
+ * With STRICT_SYNC the thread syncs the files as soon as they come
+ */
+class FileSyncer : public IFileSyncer {
+ public:
+  explicit FileSyncer(Options options) : options_(std::move(options)), stop_{}, pending_size_{} {
+    batch_future_ = batch_promise_.get_future().share();
+    if (options_.durability != BucketSettings::NO_SYNC) {
+      worker_ = std::thread([this] { Run(); });
+    }
+  }
+
+  ~FileSyncer() override {
+    {
+      std::lock_guard lock(mutex_);
+      stop_ = true;
+    }
+
+    cv_.notify_all();
+    if (worker_.joinable()) {
+      worker_.join();
+    }
+  }
+
+  std::shared_future<Error> Sync(std::vector<fs::path> paths, size_t size) override {
+    std::lock_guard lock(mutex_);
+    if (options_.durability == BucketSettings::NO_SYNC) {
+      return MakeReadyFuture(Error::kOk);
+    }
+
+    pending_paths_.insert(std::make_move_iterator(paths.begin()), std::make_move_iterator(paths.end()));
+    pending_size_ += size;
+    if (IsSyncNeeded()) {
+      cv_.notify_one();
+    }
+    return batch_future_;
+  }
+
+  Error SyncNow(const std::vector<fs::path>& paths) override {
+    if (GetOptions().durability == BucketSettings::NO_SYNC) {
+      return Error::kOk;
+    }
+
+    return SyncFiles(std::set<fs::path>(paths.begin(), paths.end()));
+  }
+
+  [[nodiscard]] Options GetOptions() const override {
+    std::lock_guard lock(mutex_);
+    return options_;
+  }
+
+  void SetOptions(const Options& options) override {
+    bool stop;
+    {
+      std::lock_guard lock(mutex_);
+      if (options_ == options) {
+        return;
+      }
+
+      options_ = options;
+      stop_ = options_.durability == BucketSettings::NO_SYNC;
+      stop = stop_;
+    }
+
+    cv_.notify_all();
+    if (stop && worker_.joinable()) {
+      worker_.join();  // the worker syncs the pending files before it stops
+    } else if (!stop && !worker_.joinable()) {
+      worker_ = std::thread([this] { Run(); });
+    }
+  }
+
+ private:
+  /**
+   * Checks if the pending files must be synced without waiting for the interval
+   * @note must be called under the lock
+   */
+  [[nodiscard]] bool IsSyncNeeded() const {
+    if (options_.durability == BucketSettings::STRICT_SYNC) {
+      return !pending_paths_.empty();
+    }
+
+    return pending_size_ >= options_.sync_size;
+  }
+
+  void Run() {
+    std::unique_lock lock(mutex_);
+    while (true) {
+      cv_.wait_for(lock, options_.sync_interval, [this] { return stop_ || IsSyncNeeded(); });
+      if (!pending_paths_.empty()) {
+        auto paths = std::move(pending_paths_);
+        auto promise = std::move(batch_promise_);
+
+        pending_paths_ = {};
+        pending_size_ = 0;
+        batch_promise_ = {};
+        batch_future_ = batch_promise_.get_future().share();
+
+        lock.unlock();
+        promise.set_value(SyncFiles(paths));
+        lock.lock();
+      }
+
+      if (stop_) {
+        break;
+      }
+    }
+  }
+
+  Options options_;
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+  std::thread worker_;
+  bool stop_;
+
+  std::set<fs::path> pending_paths_;
+  size_t pending_size_;
+  std::promise<Error> batch_promise_;
+  std::shared_future<Error> batch_future_;
+};
+
+IFileSyncer::SPtr IFileSyncer::Build(Options options) { return std::make_shared<FileSyncer>(std::move(options)); }
+
+}  // namespace reduct::storage::io
@@ -0,0 +1,87 @@
+// Copyright 2022 ReductStore
+// This Source Code Form is subject to the terms of the Mozilla Public
+//    License, v. 2.0. If a copy of the MPL was not distributed with this
+//    file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#ifndef REDUCT_STORAGE_IO_FILE_SYNCER_H
+#define REDUCT_STORAGE_IO_FILE_SYNCER_H
+
+#include <chrono>
+#include <filesystem>
+#include <future>
+#include <memory>
+#include <vector>
+
+#include "reduct/core/error.h"
+#include "reduct/proto/api/bucket.pb.h"
+
+namespace reduct::storage::io {
+
+/**
+ * Syncs written files to disk according to the durability of a bucket
+ */
+class IFileSyncer {
+ public:
+  using SPtr = std::shared_ptr<IFileSyncer>;
+  using Durability = proto::api::BucketSettings::Durability;
+
+  struct Options {
+    Durability durability;
+    std::chrono::milliseconds sync_interval;  // max interval between syncs for BATCHED_SYNC
+    size_t sync_size;                         // max size of unsynced data for BATCHED_SYNC
+
+    std::strong_ordering operator<=>(const Options& rhs) const = default;
+  };
+
+  virtual ~IFileSyncer() = default;
+
+  /**
+   * @brief Syncs the files according to the durability
+   * NO_SYNC - does nothing
+   * BATCHED_SYNC - marks the files as dirty, a background thread syncs them with the other dirty files
+   * STRICT_SYNC - the background thread syncs the files immediately
+   * @param paths files or directories to sync
+   * @param size size of written data in bytes
+   * @return future which is ready when the files are synced
+   */
+  virtual std::shared_future<core::Error> Sync(std::vector<std::filesystem::path> paths, size_t size) = 0;
+
+  /**
+   * @brief Syncs the files immediately if the durability isn't NO_SYNC
+   * It is for the rare operations which mustn't be reordered with a crash, e.g. compacting a block descriptor
+   * @param paths files or directories to sync
+   * @return
+   */
+  virtual core::Error SyncNow(const std::vector<std::filesystem::path>& paths) = 0;
+
+  /**
+   * @brief Provides current options
+   * @return
+   */
+  [[nodiscard]] virtual Options GetOptions() const = 0;
+
+  /**
+   * @brief Set options. The dirty files are synced if the durability changes
+   * @param options
+   */
+  virtual void SetOptions(const Options& options) = 0;
+
+  /**
+   * Builds a syncer. It starts the background thread for BATCHED_SYNC and STRICT_SYNC
+   * @param options
+   * @return
+   */
+  static SPtr Build(Options options);
+};
+
+/**
+ * Syncs data of a file or a directory to disk
+ * @note missed files are ignored, because they could be removed before syncing
+ * @param path
+ * @return
+ */
+core::Error SyncFile(const std::filesystem::path& path);
+
+}  // namespace reduct::storage::io
+
+#endif  // REDUCT_STORAGE_IO_FILE_SYNCER_H
@@ -0,0 +1,216 @@
+// Copyright 2022 ReductStore
+// This Source Code Form is subject to the terms of the Mozilla Public
+//    License, v. 2.0. If a copy of the MPL was not distributed with this
+//    file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#include "reduct/storage/io/io_ring.h"
+
+#include <fmt/core.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+#include "reduct/async/loop.h"
+#include "reduct/core/logger.h"
+
+namespace reduct::storage::io {
+
+using core::Error;
+
+/**
+ * io_uring with raw system calls, so we don't depend on liburing
+ */
+class IoRing : public IIoRing, public std::enable_shared_from_this<IoRing> {
+ public:
+  static constexpr uint32_t kEntries = 256;
+  static constexpr auto kReapInterval = std::chrono::milliseconds(1);
+
+  ~IoRing() override {
+    // the kernel may still write into buffers of pending operations
+    while (!operations_.empty()) {
+      Enter(0, 1, IORING_ENTER_GETEVENTS);
+      Poll();
+    }
+
+    if (sqes_) {
+      ::munmap(sqes_, params_.sq_entries * sizeof(io_uring_sqe));
+    }
+
+    if (ring_) {
+      ::munmap(ring_, ring_size_);
+    }
+
+    if (fd_ >= 0) {
+      ::close(fd_);
+    }
+  }
+
+  /**
+   * Sets up the ring
+   * @return error if io_uring isn't available, e.g. an old kernel or it is forbidden in a container
+   */
+  Error Init() {
+    fd_ = static_cast<int>(::syscall(__NR_io_uring_setup, kEntries, &params_));
+    if (fd_ < 0) {
+      return Error::InternalError(fmt::format("Failed to setup io_uring: {}", std::strerror(errno)));
+    }
+
+    if (!(params_.features & IORING_FEAT_SINGLE_MMAP)) {
+      return Error::InternalError("io_uring is too old");
+    }
+
+    ring_size_ = std::max(params_.sq_off.array + params_.sq_entries * sizeof(uint32_t),
+                          params_.cq_off.cqes + params_.cq_entries * sizeof(io_uring_cqe));
+    ring_ = ::mmap(nullptr, ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+    if (ring_ == MAP_FAILED) {
+      ring_ = nullptr;
+      return Error::InternalError(fmt::format("Failed to map io_uring: {}", std::strerror(errno)));
+    }
+
+    sqes_ = static_cast<io_uring_sqe*>(::mmap(nullptr, params_.sq_entries * sizeof(io_uring_sqe),
+                                              PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_,
+                                              IORING_OFF_SQES));
+    if (sqes_ == MAP_FAILED) {
+      sqes_ = nullptr;
+      return Error::InternalError(fmt::format("Failed to map io_uring: {}", std::strerror(errno)));
+    }
+
+    return Error::kOk;
+  }
+
+  Error SubmitRead(int fd, size_t offset, OperationSPtr op) override {
+    return Submit(IORING_OP_READ, fd, offset, std::move(op));
+  }
+
+  Error SubmitWrite(int fd, size_t offset, OperationSPtr op) override {
+    return Submit(IORING_OP_WRITE, fd, offset, std::move(op));
+  }
+
+  void Poll() noexcept override {
+    auto* head = Field<uint32_t>(params_.cq_off.head);
+    const auto tail = Field<std::atomic<uint32_t>>(params_.cq_off.tail)->load(std::memory_order_acquire);
+    const auto mask = *Field<uint32_t>(params_.cq_off.ring_mask);
+    const auto* cqes = Field<io_uring_cqe>(params_.cq_off.cqes);
+
+    auto current = *head;
+    for (; current != tail; ++current) {
+      const auto& cqe = cqes[current & mask];
+      auto it = operations_.find(cqe.user_data);
+      if (it != operations_.end()) {
+        it->second->result = cqe.res;
+        it->second->completed = true;
+        operations_.erase(it);
+      }
+    }
+
+    reinterpret_cast<std::atomic<uint32_t>*>(head)->store(current, std::memory_order_release);
+  }
+
+  void Adopt(std::function<bool()> task) override {
+    adopted_.push_back(std::move(task));
+    if (adopted_.size() == 1 && async::ILoop::has_loop()) {
+      ScheduleReap();
+    }
+  }
+
+  size_t Reap() noexcept override {
+    Poll();
+
+    // a task may adopt another one, so we iterate over a copy
+    auto tasks = std::move(adopted_);
+    adopted_ = {};
+    std::erase_if(tasks, [](auto& task) { return task(); });
+    adopted_.insert(adopted_.begin(), std::make_move_iterator(tasks.begin()), std::make_move_iterator(tasks.end()));
+    return adopted_.size();
+  }
+
+ private:
+  void ScheduleReap() {
+    async::ILoop::loop().Schedule(kReapInterval, [weak = weak_from_this()] {
+      if (auto ring = weak.lock(); ring && ring->Reap() > 0) {
+        ring->ScheduleReap();
+      }
+    });
+  }
+
+  Error Submit(uint8_t opcode, int fd, size_t offset, OperationSPtr op) {
+    auto* tail = Field<uint32_t>(params_.sq_off.tail);
+    const auto head = Field<std::atomic<uint32_t>>(params_.sq_off.head)->load(std::memory_order_acquire);
+    const auto mask = *Field<uint32_t>(params_.sq_off.ring_mask);
+    if (*tail - head >= params_.sq_entries) {
+      return Error::InternalError("io_uring submission queue is full");
+    }
+
+    const auto index = *tail & mask;
+    auto& sqe = sqes_[index];
+    std::memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = opcode;
+    sqe.fd = fd;
+    sqe.off = offset;
+    sqe.addr = reinterpret_cast<uint64_t>(op->buffer.data());
+    sqe.len = op->buffer.size();
+    sqe.user_data = ++last_id_;
+
+    Field<uint32_t>(params_.sq_off.array)[index] = index;
+    reinterpret_cast<std::atomic<uint32_t>*>(tail)->store(*tail + 1, std::memory_order_release);
+
+    operations_[last_id_] = std::move(op);
+    if (Enter(1, 0, 0) < 0) {
+      // the kernel didn't take the entry, take it back
+      reinterpret_cast<std::atomic<uint32_t>*>(tail)->store(*tail - 1, std::memory_order_release);
+      operations_.erase(last_id_);
+      return Error::InternalError(fmt::format("Failed to submit io_uring operation: {}", std::strerror(errno)));
+    }
+
+    return Error::kOk;
+  }
+
+  int Enter(uint32_t to_submit, uint32_t min_complete, uint32_t flags) const {
+    return static_cast<int>(::syscall(__NR_io_uring_enter, fd_, to_submit, min_complete, flags, nullptr, 0));
+  }
+
+  template <typename T>
+  T* Field(uint32_t offset) const {
+    return reinterpret_cast<T*>(static_cast<char*>(ring_) + offset);
+  }
+
+  int fd_{-1};
+  io_uring_params params_{};
+  void* ring_{};
+  size_t ring_size_{};
+  io_uring_sqe* sqes_{};
+  uint64_t last_id_{};
+  std::unordered_map<uint64_t, OperationSPtr> operations_;
+  std::vector<std::function<bool()>> adopted_;
+};
+
+IIoRing::SPtr IIoRing::Instance() {
+  thread_local auto ring = []() -> IIoRing::SPtr {
+    auto ring = std::make_shared<IoRing>();
+    if (auto err = ring->Init()) {
+      LOG_WARNING("{}. Use blocking I/O", err.ToString());
+      return nullptr;
+    }
+
+    return ring;
+  }();
+
+  return ring;
+}
+
+bool IIoRing::IsSupported() {
+  static const bool supported = [] {
+    IoRing ring;
+    return ring.Init() == Error::kOk;
+  }();
+
+  return supported;
+}
+
+}  // namespace reduct::storage::io
@@ -0,0 +1,96 @@
+// Copyright 2022 ReductStore
+// This Source Code Form is subject to the terms of the Mozilla Public
+//    License, v. 2.0. If a copy of the MPL was not distributed with this
+//    file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#ifndef REDUCT_STORAGE_IO_IO_RING_H
+#define REDUCT_STORAGE_IO_IO_RING_H
+
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "reduct/core/error.h"
+
+namespace reduct::storage::io {
+
+/**
+ * Queue of asynchronous file operations based on io_uring.
+ * The operations are submitted and reaped without blocking, so the loop can serve other requests while the disk is
+ * busy.
+ */
+class IIoRing {
+ public:
+  using SPtr = std::shared_ptr<IIoRing>;
+
+  /**
+   * A submitted operation. The ring keeps it until the operation is completed,
+   * so the owner may drop it at any moment
+   */
+  struct Operation {
+    std::string buffer;  // data to write or place to read into
+    int64_t result{};    // number of transferred bytes or -errno
+    bool completed{};
+  };
+
+  using OperationSPtr = std::shared_ptr<Operation>;
+
+  virtual ~IIoRing() = default;
+
+  /**
+   * Submits reading of op->buffer.size() bytes
+   * @param fd
+   * @param offset
+   * @param op
+   * @return
+   */
+  virtual core::Error SubmitRead(int fd, size_t offset, OperationSPtr op) = 0;
+
+  /**
+   * Submits writing of op->buffer
+   * @param fd
+   * @param offset
+   * @param op
+   * @return
+   */
+  virtual core::Error SubmitWrite(int fd, size_t offset, OperationSPtr op) = 0;
+
+  /**
+   * Marks completed operations without blocking
+   */
+  virtual void Poll() noexcept = 0;
+
+  /**
+   * Takes the rest of the work of a reader or writer which is destroyed before its operations are completed,
+   * so that its destructor doesn't wait for the disk. The ring calls the task by a timer of the loop
+   * of its thread until the task returns true
+   * @param task
+   */
+  virtual void Adopt(std::function<bool()> task) = 0;
+
+  /**
+   * Polls the ring and calls the adopted tasks
+   * @note it must not be called under a lock of an entry, because the tasks lock their entries
+   * @return number of the tasks which aren't finished yet
+   */
+  virtual size_t Reap() noexcept = 0;
+
+  /**
+   * Ring of the current thread. Readers and writers take the ring of the thread where they submit their first
+   * operation, so they may be built in a worker of the pool and used in the loop, but not in both.
+   * The ring lives until its thread exits. Then it waits for the operations in flight, because the kernel may
+   * still write into their buffers, and drops the adopted tasks: their records stay unfinished as
+   * the records of an aborted request.
+   * @return nullptr if the kernel doesn't support io_uring
+   */
+  static SPtr Instance();
+
+  /**
+   * Checks once if the kernel supports io_uring, without setting up a ring for the current thread
+   */
+  static bool IsSupported();
+};
+
+}  // namespace reduct::storage::io
+
+#endif  // REDUCT_STORAGE_IO_IO_RING_H
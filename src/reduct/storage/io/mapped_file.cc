@@ -0,0 +1,65 @@
+// Copyright 2022 ReductStore
+// This Source Code Form is subject to the terms of the Mozilla Public
+//    License, v. 2.0. If a copy of the MPL was not distributed with this
+//    file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#include "reduct/storage/io/mapped_file.h"
+
+#include <fmt/core.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include <cstring>
+
+namespace reduct::storage::io {
+
+using core::Error;
+
+#ifndef _WIN32
+class MappedFile : public IMappedFile {
+ public:
+  MappedFile(void* addr, size_t size) : addr_(addr), size_(size) {}
+
+  ~MappedFile() override {
+    if (size_ > 0) {
+      ::munmap(addr_, size_);
+    }
+  }
+
+  std::string_view data() const noexcept override { return {static_cast<const char*>(addr_), size_}; }
+
+ private:
+  void* addr_;
+  size_t size_;
+};
+
+core::Result<IMappedFile::SPtr> IMappedFile::Build(const std::filesystem::path& path, size_t size) {
+  if (size == 0) {
+    return {std::make_shared<MappedFile>(nullptr, 0), Error::kOk};  // mmap doesn't map empty ranges
+  }
+
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return Error::InternalError(fmt::format("Failed to open {} to map: {}", path.string(), std::strerror(errno)));
+  }
+
+  void* addr = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);  // the mapping keeps the file
+  if (addr == MAP_FAILED) {
+    return Error::InternalError(fmt::format("Failed to map {}: {}", path.string(), std::strerror(errno)));
+  }
+
+  ::madvise(addr, size, MADV_SEQUENTIAL);
+  return {std::make_shared<MappedFile>(addr, size), Error::kOk};
+}
+#else
+core::Result<IMappedFile::SPtr> IMappedFile::Build(const std::filesystem::path& path, size_t size) {
+  return Error::InternalError("Memory mapping isn't supported on this platform");
+}
+#endif
+
+}  // namespace reduct::storage::io
@@ -0,0 +1,43 @@
+// Copyright 2022 ReductStore
+// This Source Code Form is subject to the terms of the Mozilla Public
+//    License, v. 2.0. If a copy of the MPL was not distributed with this
+//    file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#ifndef REDUCT_STORAGE_IO_MAPPED_FILE_H
+#define REDUCT_STORAGE_IO_MAPPED_FILE_H
+
+#include <filesystem>
+#include <memory>
+#include <string_view>
+
+#include "reduct/core/result.h"
+
+namespace reduct::storage::io {
+
+/**
+ * Read-only memory mapping of a file. The file is unmapped when the last owner releases it
+ */
+class IMappedFile {
+ public:
+  using SPtr = std::shared_ptr<const IMappedFile>;
+
+  virtual ~IMappedFile() = default;
+
+  /**
+   * @brief Mapped content of the file
+   * @return view which is valid while the mapping exists
+   */
+  [[nodiscard]] virtual std::string_view data() const noexcept = 0;
+
+  /**
+   * Maps the beginning of a file into memory
+   * @param path
+   * @param size number of bytes to map, must not be bigger than the file
+   * @return error if the platform doesn't support mapping or it failed
+   */
+  static core::Result<SPtr> Build(const std::filesystem::path& path, size_t size);
+};
+
+}  // namespace reduct::storage::io
+
+#endif  // REDUCT_STORAGE_IO_MAPPED_FILE_H
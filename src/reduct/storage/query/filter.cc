@@ -0,0 +1,124 @@
+// Copyright 2022 ReductStore
+// This Source Code Form is subject to the terms of the Mozilla Public
+//    License, v. 2.0. If a copy of the MPL was not distributed with this
+//    file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#include "reduct/storage/query/filter.h"
+
+#include <algorithm>
+#include <bit>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define REDUCT_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace reduct::storage::query {
+
+namespace {
+
+size_t FindStateScalar(std::span<const uint8_t> states, size_t from, uint8_t state) {
+  for (size_t i = from; i < states.size(); ++i) {
+    if (states[i] == state) {
+      return i;
+    }
+  }
+  return states.size();
+}
+
+#ifdef REDUCT_X86_KERNELS
+// SSE2 is in every x86-64 CPU, so the kernel needs no check
+size_t FindStateSse2(std::span<const uint8_t> states, size_t from, uint8_t state) {
+  const auto needle = _mm_set1_epi8(static_cast<char>(state));
+  size_t i = from;
+  for (; i + 16 <= states.size(); i += 16) {
+    const auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(states.data() + i));
+    const auto mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle)));
+    if (mask != 0) {
+      return i + std::countr_zero(mask);
+    }
+  }
+  return FindStateScalar(states, i, state);
+}
+
+__attribute__((target("avx2"))) size_t FindStateAvx2(std::span<const uint8_t> states, size_t from, uint8_t state) {
+  const auto needle = _mm256_set1_epi8(static_cast<char>(state));
+  size_t i = from;
+  for (; i + 32 <= states.size(); i += 32) {
+    const auto chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(states.data() + i));
+    const auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle)));
+    if (mask != 0) {
+      return i + std::countr_zero(mask);
+    }
+  }
+  return FindStateSse2(states, i, state);
+}
+#endif
+
+}  // namespace
+
+FindStateKernels GetFindStateKernels() {
+  FindStateKernels kernels{.scalar = FindStateScalar, .sse2 = nullptr, .avx2 = nullptr};
+#ifdef REDUCT_X86_KERNELS
+  kernels.sse2 = FindStateSse2;
+  if (__builtin_cpu_supports("avx2")) {
+    kernels.avx2 = FindStateAvx2;
+  }
+#endif
+  return kernels;
+}
+
+size_t FindState(std::span<const uint8_t> states, size_t from, uint8_t state) {
+  static const FindStateKernel kernel = [] {
+    const auto kernels = GetFindStateKernels();
+    return kernels.avx2 ? kernels.avx2 : (kernels.sse2 ? kernels.sse2 : kernels.scalar);
+  }();
+
+  return kernel(states, from, state);
+}
+
+LabelFilter::LabelFilter(const IBlockManager::RecordIndex& index, const async::LabelMap& include,
+                         const async::LabelMap& exclude)
+    : rejects_block_{} {
+  auto find_bitmap = [&index](const std::string& name, const std::string& value) -> const Bitmap* {
+    auto name_it = index.labels.find(name);
+    if (name_it == index.labels.end()) {
+      return nullptr;
+    }
+
+    auto value_it = name_it->second.find(value);
+    return value_it != name_it->second.end() ? &value_it->second : nullptr;
+  };
+
+  for (const auto& [name, value] : include) {
+    const auto bitmap = find_bitmap(name, value);
+    if (!bitmap) {
+      rejects_block_ = true;  // no record in the block has the label
+      return;
+    }
+    include_.push_back(bitmap);
+  }
+
+  for (const auto& [name, value] : exclude) {
+    const auto bitmap = find_bitmap(name, value);
+    if (!bitmap) {
+      exclude_.clear();  // no record in the block has all the labels
+      break;
+    }
+    exclude_.push_back(bitmap);
+  }
+}
+
+bool LabelFilter::operator()(int record_index) const {
+  const auto has_label = [record_index](const Bitmap* bitmap) {
+    return static_cast<size_t>(record_index) < bitmap->size() && (*bitmap)[record_index];
+  };
+
+  if (!std::ranges::all_of(include_, has_label)) {
+    return false;
+  }
+
+  return exclude_.empty() || !std::ranges::all_of(exclude_, has_label);
+}
+
+}  // namespace reduct::storage::query
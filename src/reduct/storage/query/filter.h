@@ -0,0 +1,86 @@
+// Copyright 2022 ReductStore
+// This Source Code Form is subject to the terms of the Mozilla Public
+//    License, v. 2.0. If a copy of the MPL was not distributed with this
+//    file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#ifndef REDUCT_STORAGE_QUERY_FILTER_H
+#define REDUCT_STORAGE_QUERY_FILTER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "reduct/async/io.h"
+#include "reduct/storage/block_manager.h"
+
+namespace reduct::storage::query {
+
+/**
+ * Kernel which finds the first record with a state in the column of states
+ * @param states states of the records
+ * @param from position to start with
+ * @param state state to find
+ * @return position of the record or states.size() if there is no such record
+ */
+using FindStateKernel = size_t (*)(std::span<const uint8_t> states, size_t from, uint8_t state);
+
+/**
+ * Finds the first record with the state with the best kernel for the CPU.
+ * The kernel is chosen once at runtime: AVX2, SSE2 or scalar
+ */
+size_t FindState(std::span<const uint8_t> states, size_t from, uint8_t state);
+
+/**
+ * Kernels for tests and benchmarks. The vector kernels are nullptr if the CPU doesn't support them
+ */
+struct FindStateKernels {
+  FindStateKernel scalar;
+  FindStateKernel sse2;
+  FindStateKernel avx2;
+};
+
+FindStateKernels GetFindStateKernels();
+
+/**
+ * Matches records of a block by their labels with the label index of the block, so the descriptors
+ * of the records and their data aren't touched
+ * @note it keeps pointers to the bitmaps of the index, so it is valid as long as the index
+ */
+class LabelFilter {
+ public:
+  /**
+   * @param index index of the block
+   * @param include a record must have all these labels
+   * @param exclude a record mustn't have all these labels
+   */
+  LabelFilter(const IBlockManager::RecordIndex& index, const async::LabelMap& include,
+              const async::LabelMap& exclude);
+
+  /**
+   * @return true if no record of the block can match, so the block can be skipped
+   */
+  [[nodiscard]] bool rejects_block() const { return rejects_block_; }
+
+  /**
+   * @return true if there are no labels to check
+   */
+  [[nodiscard]] bool empty() const { return include_.empty() && exclude_.empty(); }
+
+  /**
+   * @param record_index index of the record in the block
+   * @return true if the record matches
+   */
+  [[nodiscard]] bool operator()(int record_index) const;
+
+ private:
+  using Bitmap = IBlockManager::RecordIndex::Bitmap;
+
+  std::vector<const Bitmap*> include_;
+  std::vector<const Bitmap*> exclude_;
+  bool rejects_block_;
+};
+
+}  // namespace reduct::storage::query
+
+#endif  // REDUCT_STORAGE_QUERY_FILTER_H
@@ -22,6 +22,8 @@ class IQuery {
    */
   struct Options {
     std::chrono::seconds ttl{5};  // TTL of query in entries cache (time from last request)
+    async::LabelMap include;      // the query takes only records which have all these labels
+    async::LabelMap exclude;      // the query skips records which have all these labels
   };
 
   /**
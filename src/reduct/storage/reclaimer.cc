@@ -0,0 +1,102 @@
+// Copyright 2022 ReductStore
+// This Source Code Form is subject to the terms of the Mozilla Public
+//    License, v. 2.0. If a copy of the MPL was not distributed with this
+//    file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#include "reduct/storage/reclaimer.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "reduct/core/logger.h"
+
+namespace reduct::storage {
+
+class Reclaimer : public IReclaimer {
+ public:
+  Reclaimer(BucketList buckets, Options options)
+      : buckets_(std::move(buckets)), options_(std::move(options)), stop_{} {
+    if (options_.background) {
+      worker_ = std::thread([this] { Run(); });
+    }
+  }
+
+  ~Reclaimer() override {
+    {
+      std::lock_guard lock(mutex_);
+      stop_ = true;
+    }
+
+    cv_.notify_all();
+    if (worker_.joinable()) {
+      worker_.join();
+    }
+  }
+
+  size_t RunOnce() override {
+    size_t removed = 0;
+    for (const auto& [name, bucket] : buckets_()) {
+      if (bucket->GetQuotaFill() > options_.high_watermark && !Reclaim(name, bucket.get(), &removed)) {
+        break;
+      }
+    }
+    return removed;
+  }
+
+ private:
+  void Run() {
+    std::unique_lock lock(mutex_);
+    while (!stop_) {
+      lock.unlock();
+      RunOnce();
+      lock.lock();
+
+      cv_.wait_for(lock, options_.interval, [this] { return stop_; });
+    }
+  }
+
+  /**
+   * Removes the oldest blocks of the bucket down to the low watermark
+   * @param total_removed counter of the removed bytes
+   * @return false if the reclaimer is stopped
+   */
+  bool Reclaim(const std::string& name, IBucket* bucket, size_t* total_removed) {
+    while (true) {
+      auto [removed, err] = bucket->ReclaimOldestBlock(options_.low_watermark);
+      if (err) {
+        LOG_WARNING("Failed to reclaim space in bucket '{}': {}", name, err.ToString());
+        return true;
+      }
+
+      if (removed == 0) {
+        return true;
+      }
+
+      *total_removed += removed;
+
+      // gives the disk to foreground I/O for the time the removal is worth with the max rate
+      std::unique_lock lock(mutex_);
+      const auto pause = options_.max_rate == 0 ? std::chrono::duration<double>::zero()
+                                                : std::chrono::duration<double>(static_cast<double>(removed) /
+                                                                                static_cast<double>(options_.max_rate));
+      if (cv_.wait_for(lock, pause, [this] { return stop_; })) {
+        return false;
+      }
+    }
+  }
+
+  BucketList buckets_;
+  Options options_;
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::thread worker_;
+  bool stop_;
+};
+
+std::unique_ptr<IReclaimer> IReclaimer::Build(BucketList buckets, Options options) {
+  return std::make_unique<Reclaimer>(std::move(buckets), std::move(options));
+}
+
+}  // namespace reduct::storage
@@ -0,0 +1,55 @@
+// Copyright 2022 ReductStore
+// This Source Code Form is subject to the terms of the Mozilla Public
+//    License, v. 2.0. If a copy of the MPL was not distributed with this
+//    file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#ifndef REDUCT_STORAGE_RECLAIMER_H
+#define REDUCT_STORAGE_RECLAIMER_H
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+
+#include "reduct/storage/bucket.h"
+
+namespace reduct::storage {
+
+/**
+ * Removes the oldest blocks of buckets with FIFO quota in a background thread,
+ * so that the writers don't wait for it until a bucket reaches its quota
+ */
+class IReclaimer {
+ public:
+  using BucketList = std::function<std::map<std::string, IBucket::SPtr>()>;
+
+  struct Options {
+    double high_watermark = 0.95;             // share of the quota which starts reclaiming
+    double low_watermark = 0.9;               // share of the quota which stops reclaiming
+    size_t max_rate = 0;                      // max removed bytes per second, 0 - no limit
+    std::chrono::milliseconds interval{100};  // interval between checks of the buckets
+    bool background = true;                   // if false, the space is reclaimed only by RunOnce
+  };
+
+  virtual ~IReclaimer() = default;
+
+  /**
+   * Checks the buckets once and reclaims their space in the calling thread
+   * @return number of the removed bytes
+   */
+  virtual size_t RunOnce() = 0;
+
+  /**
+   * Builds a reclaimer and starts its thread if Options::background is set. The thread stops when the reclaimer
+   * is destroyed
+   * @param buckets provides the buckets to check, it is called from the thread of the reclaimer
+   * @param options
+   * @return
+   */
+  static std::unique_ptr<IReclaimer> Build(BucketList buckets, Options options);
+};
+
+}  // namespace reduct::storage
+
+#endif  // REDUCT_STORAGE_RECLAIMER_H
@@ -4,13 +4,20 @@
 //    file, You can obtain one at https://mozilla.org/MPL/2.0/.
 #include "reduct/storage/storage.h"
 
+#include <atomic>
+#include <condition_variable>
 #include <filesystem>
+#include <fstream>
+#include <mutex>
 #include <regex>
+#include <set>
+#include <thread>
 #include <utility>
 
 #include "reduct/config.h"
 #include "reduct/core/logger.h"
 #include "reduct/proto/api/bucket.pb.h"
+#include "reduct/proto/storage/manifest.pb.h"
 #include "reduct/storage/bucket.h"
 
 namespace reduct::storage {
@@ -28,7 +35,8 @@ namespace fs = std::filesystem;
 
 class Storage : public IStorage {
  public:
-  explicit Storage(Options options) : options_(std::move(options)), buckets_() {
+  explicit Storage(Options options)
+      : options_(std::move(options)), buckets_(), stop_restore_{}, stop_checkpoints_{} {
     if (!fs::exists(options_.data_path)) {
       LOG_INFO("Folder '{}' doesn't exist. Create it.", options_.data_path.string());
       fs::create_directories(options_.data_path);
@@ -36,15 +44,52 @@ class Storage : public IStorage {
 
     for (const auto& folder : fs::directory_iterator(options_.data_path)) {
       if (folder.is_directory()) {
-        auto bucket_name = folder.path().filename().string();
-        if (auto bucket = IBucket::Restore(folder)) {
-          buckets_[bucket_name] = std::move(bucket);
-        }
+        loading_buckets_.insert(folder.path().filename().string());
       }
     }
 
-    LOG_INFO("Load {} buckets", buckets_.size());
+    LoadManifest();
+
     start_time_ = decltype(start_time_)::clock::now();
+    if (options_.background_restore) {
+      restorer_ = std::thread([this] { RestoreBuckets(); });
+    } else {
+      RestoreBuckets();
+    }
+
+    reclaimer_ = IReclaimer::Build(
+        [this] {
+          std::lock_guard lock(mutex_);
+          return buckets_;
+        },
+        options_.reclaimer);
+
+    checkpointer_ = std::thread([this] {
+      std::unique_lock lock(checkpoint_mutex_);
+      while (!checkpoint_cv_.wait_for(lock, options_.checkpoint_interval, [this] { return stop_checkpoints_; })) {
+        if (auto err = SaveManifest()) {
+          LOG_WARNING("Failed to checkpoint the manifest: {}", err.ToString());
+        }
+      }
+    });
+  }
+
+  ~Storage() override {
+    stop_restore_ = true;
+    if (restorer_.joinable()) {
+      restorer_.join();
+    }
+
+    {
+      std::lock_guard lock(checkpoint_mutex_);
+      stop_checkpoints_ = true;
+    }
+    checkpoint_cv_.notify_all();
+    checkpointer_.join();
+
+    if (auto err = SaveManifest()) {
+      LOG_ERROR("Failed to save the manifest: {}", err.ToString());
+    }
   }
 
   /**
@@ -58,6 +103,7 @@ class Storage : public IStorage {
     uint64_t oldest_ts = std::numeric_limits<uint64_t>::max();
     uint64_t latest_ts = 0;
 
+    std::lock_guard lock(mutex_);
     for (const auto& [_, bucket] : buckets_) {
       auto info = bucket->GetInfo();
       usage += info.size();
@@ -79,6 +125,7 @@ class Storage : public IStorage {
   }
 
   [[nodiscard]] core::Result<BucketInfoList> GetList() const override {
+    std::lock_guard lock(mutex_);
     BucketInfoList list;
     for (const auto& [name, bucket] : buckets_) {
       *list.add_buckets() = bucket->GetInfo();
@@ -95,7 +142,8 @@ class Storage : public IStorage {
           .message = "Bucket name can contain only letters, digests and [-,_] symbols"};
     }
 
-    if (buckets_.find(bucket_name) != buckets_.end()) {
+    std::lock_guard lock(mutex_);
+    if (buckets_.contains(bucket_name) || loading_buckets_.contains(bucket_name)) {
       return Error{.code = 409, .message = fmt::format("Bucket '{}' already exists", bucket_name)};
     }
 
@@ -109,6 +157,7 @@ class Storage : public IStorage {
   }
 
   core::Result<IBucket::WPtr> GetBucket(const std::string& bucket_name) const override {
+    std::lock_guard lock(mutex_);
     auto [bucket_it, err] = FindBucket(bucket_name);
     if (err) {
       return {{}, err};
@@ -118,6 +167,7 @@ class Storage : public IStorage {
   }
 
   Error RemoveBucket(const std::string& bucket_name) override {
+    std::lock_guard lock(mutex_);
     auto [bucket_it, err] = FindBucket(bucket_name);
     if (err) {
       return err;
@@ -136,15 +186,129 @@ class Storage : public IStorage {
   [[nodiscard]] std::pair<BucketMap::const_iterator, Error> FindBucket(std::string_view name) const {
     auto it = buckets_.find(std::string{name});
     if (it == buckets_.end()) {
+      if (loading_buckets_.contains(std::string{name})) {
+        return {buckets_.end(), Error{.code = 503, .message = fmt::format("Bucket '{}' is being restored", name)}};
+      }
       return {buckets_.end(), Error{.code = 404, .message = fmt::format("Bucket '{}' is not found", name)}};
     }
 
     return {it, Error::kOk};
   }
 
+  /**
+   * Restores the buckets and their entries in parallel on all cores.
+   * A bucket is available as soon as it is restored
+   */
+  void RestoreBuckets() {
+    std::vector<std::string> names;
+    {
+      std::lock_guard lock(mutex_);
+      names.assign(loading_buckets_.begin(), loading_buckets_.end());
+    }
+
+    {
+      async::ThreadPoolExecutor pool;  // stops when the buckets are restored
+      for (const auto& name : names) {
+        const auto manifest = bucket_manifests_.contains(name) ? bucket_manifests_[name] : nullptr;
+        pool.Commit([this, &pool, name, manifest] {
+          if (stop_restore_) {
+            return;  // the bucket stays loading, so the manifest keeps its checkpoint
+          }
+
+          auto bucket = IBucket::Restore(options_.data_path / name, &pool, manifest);
+          std::lock_guard lock(mutex_);
+          loading_buckets_.erase(name);
+          if (bucket) {
+            buckets_[name] = std::move(bucket);
+          }
+        });
+      }
+    }
+
+    bucket_manifests_.clear();
+    manifest_.Clear();
+
+    std::lock_guard lock(mutex_);
+    LOG_INFO("Load {} buckets", buckets_.size());
+  }
+
+  /**
+   * Reads the manifest of the last checkpoint if it exists
+   */
+  void LoadManifest() {
+    const auto path = options_.data_path / kManifestName;
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+      LOG_DEBUG("No manifest in '{}'. Scan all the entries.", options_.data_path.string());
+      return;
+    }
+
+    if (!manifest_.ParseFromIstream(&file)) {
+      LOG_WARNING("Manifest {} is broken. Scan all the entries.", path.string());
+      manifest_.Clear();
+      return;
+    }
+
+    for (const auto& bucket_manifest : manifest_.buckets()) {
+      bucket_manifests_[bucket_manifest.name()] = &bucket_manifest;
+    }
+  }
+
+  /**
+   * Checkpoints the manifest of all the buckets.
+   * It is written into a temporary file and renamed, so a crash doesn't break the previous checkpoint
+   */
+  Error SaveManifest() const {
+    BucketMap buckets;
+    {
+      std::lock_guard lock(mutex_);
+      if (!loading_buckets_.empty()) {
+        return Error::kOk;  // keep the previous checkpoint for the buckets which aren't restored
+      }
+      buckets = buckets_;
+    }
+
+    proto::StorageManifest manifest;
+    for (const auto& [_, bucket] : buckets) {
+      *manifest.add_buckets() = bucket->GetManifest();
+    }
+
+    const auto path = options_.data_path / kManifestName;
+    auto tmp_path = path;
+    tmp_path += ".tmp";
+    {
+      std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+      if (!file || !manifest.SerializeToOstream(&file) || !file.flush()) {
+        return Error::InternalError(fmt::format("Failed to write {}", tmp_path.string()));
+      }
+    }
+
+    std::error_code ec;
+    fs::rename(tmp_path, path, ec);
+    if (ec) {
+      return Error::InternalError(fmt::format("Failed to rename {}: {}", tmp_path.string(), ec.message()));
+    }
+
+    return Error::kOk;
+  }
+
+  // the name has a dot, so it can't be a bucket name
+  constexpr static std::string_view kManifestName = "storage.manifest";
+
   Options options_;
   BucketMap buckets_;
+  std::set<std::string> loading_buckets_;  // buckets which are being restored
+  proto::StorageManifest manifest_;        // the last checkpoint, it is kept until the buckets are restored
+  std::map<std::string, const proto::BucketManifest*> bucket_manifests_;
+  mutable std::mutex mutex_;  // guards the bucket maps, the buckets synchronize themselves
   std::chrono::steady_clock::time_point start_time_;
+  std::atomic<bool> stop_restore_;
+  std::thread restorer_;
+  std::mutex checkpoint_mutex_;
+  std::condition_variable checkpoint_cv_;
+  bool stop_checkpoints_;
+  std::thread checkpointer_;
+  std::unique_ptr<IReclaimer> reclaimer_;  // declared last to stop before the buckets are destroyed
 };
 
 std::unique_ptr<IStorage> IStorage::Build(IStorage::Options options) {
@@ -5,10 +5,12 @@
 #ifndef REDUCT_STORAGE_STORAGE_H
 #define REDUCT_STORAGE_STORAGE_H
 
+#include <chrono>
 #include <filesystem>
 
 #include "reduct/proto/api/server.pb.h"
 #include "reduct/storage/bucket.h"
+#include "reduct/storage/reclaimer.h"
 
 namespace reduct::storage {
 
@@ -19,6 +21,9 @@ class IStorage {
  public:
   struct Options {
     std::filesystem::path data_path;
+    IReclaimer::Options reclaimer;  // removes data of buckets with FIFO quota in background
+    bool background_restore = false;  // if true, requests to a bucket get 503 until it is restored in background
+    std::chrono::milliseconds checkpoint_interval{60'000};  // interval between checkpoints of the manifest
   };
 
   virtual ~IStorage() = default;
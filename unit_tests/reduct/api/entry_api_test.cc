@@ -7,17 +7,30 @@
 
 #include <catch2/catch.hpp>
 #include <fmt/core.h>
+#include <sys/resource.h>
 
+#include <filesystem>
 #include <thread>
 
+#include "reduct/async/run.h"
+#include "reduct/async/task.h"
+#include "reduct/async/thread_pool.h"
 #include "reduct/helpers.h"
 
 using reduct::ReadOne;
 using reduct::WriteOne;
 using reduct::api::EntryApi;
+using reduct::api::HttpRequestReceiver;
+using reduct::async::Run;
+using reduct::async::Task;
+using reduct::async::ThreadPoolExecutor;
 using reduct::core::Error;
+using reduct::core::Result;
 using reduct::core::Time;
 using reduct::proto::api::QueryInfo;
+using reduct::proto::api::RecordInfo;
+using reduct::proto::api::RecordInfoList;
+using reduct::storage::IBucket;
 using reduct::storage::IStorage;
 
 using google::protobuf::util::JsonStringToMessage;
@@ -41,10 +54,34 @@ TEST_CASE("EntryApi::Write should write data in chunks") {
       REQUIRE(resp.headers.empty());
       REQUIRE(resp.content_length == 0);
 
+      std::optional<Error> ready;
+      while (!(ready = resp.Ready(&resp.headers))) {
+      }
+      REQUIRE(ready == Error::kOk);
+
       auto entry = storage->GetBucket("bucket").result.lock()->GetOrCreateEntry("entry-1").result.lock();
       REQUIRE(ReadOne(*entry, reduct::core::Time() + us(1000001)).result == "1234567890");
     }
 
+    SECTION("labels") {
+      auto [receiver, err] =
+          EntryApi::Write(storage.get(), "bucket", "entry-1", "1000002", "4", {{"anomaly", "true"}, {"camera", "a"}});
+      REQUIRE(err == Error::kOk);
+
+      auto [resp, resp_err] = receiver("abcd", true);
+      REQUIRE(resp_err == Error::kOk);
+      std::optional<Error> ready;
+      while (!(ready = resp.Ready(&resp.headers))) {
+      }
+
+      auto [read_receiver, read_err] = EntryApi::Read(storage.get(), "bucket", "entry-1", "1000002", {});
+      REQUIRE(read_err == Error::kOk);
+
+      auto read_resp = read_receiver("", true).result;
+      REQUIRE(read_resp.headers["x-reduct-label-anomaly"] == "true");
+      REQUIRE(read_resp.headers["x-reduct-label-camera"] == "a");
+    }
+
     SECTION("record already exists") {
       REQUIRE(EntryApi::Write(storage.get(), "bucket", "entry-1", "1000001", "10").error ==
               Error::Conflict("A record with timestamp 1000001 already exists"));
@@ -88,6 +125,39 @@ TEST_CASE("EntryApi::Write should write data in chunks") {
     REQUIRE(entry->BeginRead(reduct::core::Time() + us(1000001)).error.code == 404);
   }
 
+  SECTION("bucket is full") {
+    reduct::proto::api::BucketSettings settings;
+    settings.set_quota_type(reduct::proto::api::BucketSettings::FIFO);
+    settings.set_quota_size(5);
+    REQUIRE(storage->CreateBucket("full", settings) == Error::kOk);
+
+    auto [receiver, err] = EntryApi::Write(storage.get(), "full", "entry-1", "1000001", "10");
+    REQUIRE(err == Error::kOk);  // the unfinished record can't be removed
+
+    REQUIRE(EntryApi::Write(storage.get(), "full", "entry-1", "1000002", "10").error ==
+            Error::InsufficientStorage("Bucket is full: No blocks to remove"));
+  }
+
+  SECTION("record doesn't fit quota") {
+    reduct::proto::api::BucketSettings settings;
+    settings.set_quota_type(reduct::proto::api::BucketSettings::FIFO);
+    settings.set_quota_size(100);
+    settings.set_max_block_size(50);
+    REQUIRE(storage->CreateBucket("small", settings) == Error::kOk);
+
+    auto [receiver, err] = EntryApi::Write(storage.get(), "small", "entry-1", "1000001", "60");
+    REQUIRE(err == Error::kOk);
+    auto [resp, resp_err] = receiver(std::string(60, 'x'), true);
+    REQUIRE(resp_err == Error::kOk);
+    while (!resp.Ready(&resp.headers)) {
+    }
+
+    // the bucket is under the quota, but the old record must be removed to store the new one
+    REQUIRE(EntryApi::Write(storage.get(), "small", "entry-1", "1000002", "60").error == Error::kOk);
+    auto entry = storage->GetBucket("small").result.lock()->GetOrCreateEntry("entry-1").result.lock();
+    REQUIRE(entry->BeginRead(reduct::core::Time() + us(1000001)).error.code == 404);
+  }
+
   SECTION("wrong input") {
     auto [receiver, err] = EntryApi::Write(storage.get(), "bucket", "entry-1", "1000001", "10");
     REQUIRE(err == Error::kOk);
@@ -106,6 +176,140 @@ TEST_CASE("EntryApi::Write should write data in chunks") {
   }
 }
 
+TEST_CASE("EntryApi::WriteBatch should write many records in one request") {
+  auto storage = IStorage::Build({.data_path = BuildTmpDirectory()});
+  REQUIRE(storage->CreateBucket("bucket", {}) == Error::kOk);
+
+  auto bucket = storage->GetBucket("bucket").result.lock();
+  auto [receiver, err] = EntryApi::WriteBatch(storage.get(), "bucket", "1000");
+  REQUIRE(err == Error::kOk);
+
+  auto wait = [](auto& resp) {
+    std::optional<Error> ready;
+    while (!(ready = resp.Ready(&resp.headers))) {
+    }
+    return *ready;
+  };
+
+  SECTION("ok") {
+    REQUIRE(receiver("entry-1 1000001 10\n12345", false).error.code == Error::kContinue);
+    REQUIRE(receiver("67890entry-2 10", false).error.code == Error::kContinue);
+    REQUIRE(receiver("00001 0\nentry-1 2000001 4\nabcd", false).error.code == Error::kContinue);
+
+    auto [resp, resp_err] = receiver("", true);
+    REQUIRE(resp_err == Error::kOk);
+    REQUIRE(wait(resp) == Error::kOk);
+
+    auto entry_1 = bucket->GetOrCreateEntry("entry-1").result.lock();
+    REQUIRE(ReadOne(*entry_1, Time() + us(1000001)).result == "1234567890");
+    REQUIRE(ReadOne(*entry_1, Time() + us(2000001)).result == "abcd");
+
+    auto entry_2 = bucket->GetOrCreateEntry("entry-2").result.lock();
+    REQUIRE(entry_2->GetInfo().record_count() == 1);
+  }
+
+  SECTION("more records than open files") {
+    reduct::proto::api::BucketSettings settings;
+    settings.set_durability(reduct::proto::api::BucketSettings::BATCHED_SYNC);
+    REQUIRE(storage->CreateBucket("synced", settings) == Error::kOk);
+
+    std::string body;
+    for (int i = 0; i < 500; ++i) {
+      body += fmt::format("entry-1 {} 4\nabcd", i + 1);
+    }
+
+    // the writers of written records must be released before the batch is synced
+    rlimit limit{};
+    REQUIRE(getrlimit(RLIMIT_NOFILE, &limit) == 0);
+    const auto open_files = std::distance(std::filesystem::directory_iterator("/proc/self/fd"), {});
+    rlimit small_limit = limit;
+    small_limit.rlim_cur = open_files + 64;
+    REQUIRE(setrlimit(RLIMIT_NOFILE, &small_limit) == 0);
+
+    auto [synced_receiver, synced_err] = EntryApi::WriteBatch(storage.get(), "synced", std::to_string(body.size()));
+    auto [resp, resp_err] = synced_receiver(body, true);
+    REQUIRE(setrlimit(RLIMIT_NOFILE, &limit) == 0);
+
+    REQUIRE(resp_err == Error::kOk);
+    REQUIRE(wait(resp) == Error::kOk);
+    REQUIRE(resp.headers.empty());
+
+    auto entry = storage->GetBucket("synced").result.lock()->GetOrCreateEntry("entry-1").result.lock();
+    REQUIRE(entry->GetInfo().record_count() == 500);
+  }
+
+  SECTION("records don't fit quota") {
+    reduct::proto::api::BucketSettings settings;
+    settings.set_quota_type(reduct::proto::api::BucketSettings::FIFO);
+    settings.set_quota_size(100);
+    settings.set_max_block_size(50);
+    REQUIRE(storage->CreateBucket("small", settings) == Error::kOk);
+
+    auto small_bucket = storage->GetBucket("small").result.lock();
+    REQUIRE(WriteOne(*small_bucket->GetOrCreateEntry("entry-1").result.lock(), std::string(60, 'x'), Time() + us(1)) ==
+            Error::kOk);
+
+    // the whole body is reserved at once, it removes the old record and its entry before the first record
+    const std::string data(30, 'y');
+    const auto body = fmt::format("entry-1 2 30\n{}entry-2 3 30\n{}", data, data);
+    auto [small_receiver, small_err] = EntryApi::WriteBatch(storage.get(), "small", std::to_string(body.size()));
+    REQUIRE(small_err == Error::kOk);
+    REQUIRE_FALSE(small_bucket->HasEntry("entry-1"));
+
+    auto [resp, resp_err] = small_receiver(body, true);
+    REQUIRE(resp_err == Error::kOk);
+    REQUIRE(wait(resp) == Error::kOk);
+
+    auto entry = small_bucket->GetOrCreateEntry("entry-1").result.lock();
+    REQUIRE(entry->GetInfo().record_count() == 1);
+    REQUIRE(ReadOne(*entry, Time() + us(2)).result == data);
+    REQUIRE(small_bucket->GetOrCreateEntry("entry-2").result.lock()->GetInfo().record_count() == 1);
+  }
+
+  SECTION("failed records") {
+    REQUIRE(WriteOne(*bucket->GetOrCreateEntry("entry-1").result.lock(), "abcd", Time() + us(1)) == Error::kOk);
+
+    // the batch goes on after a record which can't be written and reports its status
+    auto [resp, resp_err] =
+        receiver("entry-1 1 4\nefgh" "entry@ 2 4\nefgh" "entry-1 2 4\nefgh" "entry-1 2 2\nij", true);
+    REQUIRE(resp_err == Error::kOk);
+    REQUIRE(wait(resp) == Error::kOk);
+    REQUIRE(resp.headers == reduct::api::StringMap{
+                                {"x-reduct-error-0", "409,A record with timestamp 1 already exists"},
+                                {"x-reduct-error-1", "422,Entry name can contain only letters, digests and [-,_] symbols"},
+                                {"x-reduct-error-3", "409,A record with timestamp 2 already exists"},
+                            });
+
+    auto entry = bucket->GetOrCreateEntry("entry-1").result.lock();
+    REQUIRE(ReadOne(*entry, Time() + us(1)).result == "abcd");
+    REQUIRE(ReadOne(*entry, Time() + us(2)).result == "efgh");
+  }
+
+  SECTION("bad header") {
+    REQUIRE(receiver("entry-1 1000001\n", true).error ==
+            Error::BadRequest("Bad record header 'entry-1 1000001' in batch"));
+    REQUIRE(receiver("entry-1 XXX 10\n", true).error ==
+            Error::UnprocessableEntity("Failed to parse 'ts' parameter: XXX must unix times in microseconds"));
+  }
+
+  SECTION("incomplete record") {
+    REQUIRE(receiver("entry-1 1000001 10\n12345", true).error ==
+            Error::BadRequest("Content is smaller than in content-length"));
+
+    auto entry = bucket->GetOrCreateEntry("entry-1").result.lock();
+    REQUIRE(entry->BeginRead(Time() + us(1000001)).error == Error::InternalError("Record is broken"));
+  }
+
+  SECTION("bucket doesn't exist") {
+    REQUIRE(EntryApi::WriteBatch(storage.get(), "XXX", "10").error == Error::NotFound("Bucket 'XXX' is not found"));
+  }
+
+  SECTION("no content-length") {
+    REQUIRE(EntryApi::WriteBatch(storage.get(), "bucket", "").error ==
+            Error::ContentLengthRequired("Bad or empty content-length"));
+  }
+}
+
 TEST_CASE("EntryApi::Read should read data in chunks with time") {
   auto storage = IStorage::Build({.data_path = BuildTmpDirectory()});
   REQUIRE(storage->CreateBucket("bucket", {}) == Error::kOk);
@@ -145,6 +349,33 @@ TEST_CASE("EntryApi::Read should read data in chunks with time") {
             Error::NotFound("No records for this timestamp"));
   }
 
+  SECTION("mode") {
+    REQUIRE(WriteOne(*entry, "abcd", Time() + us(2000001)) == Error::kOk);
+
+    auto [mode, ts, expected_ts] = GENERATE(std::make_tuple("exact", "2000001", "2000001"),
+                                            std::make_tuple("before", "1999999", "1000001"),
+                                            std::make_tuple("after", "1000002", "2000001"),
+                                            std::make_tuple("nearest", "1600000", "2000001"));
+
+    auto [receiver, err] = EntryApi::Read(storage.get(), "bucket", "entry-1", ts, {}, mode);
+    REQUIRE(err == Error::kOk);
+    REQUIRE(receiver("", true).result.headers["x-reduct-time"] == expected_ts);
+  }
+
+  SECTION("wrong mode") {
+    REQUIRE(EntryApi::Read(storage.get(), "bucket", "entry-1", "1000001", {}, "XXX").error ==
+            Error::UnprocessableEntity(
+                "Failed to parse 'mode' parameter: XXX must be exact, before, after or nearest"));
+    REQUIRE(EntryApi::Read(storage.get(), "bucket", "entry-1", {}, "1", "XXX").error ==
+            Error::UnprocessableEntity(
+                "Failed to parse 'mode' parameter: XXX must be exact, before, after or nearest"));
+  }
+
+  SECTION("mode with query") {
+    REQUIRE(EntryApi::Read(storage.get(), "bucket", "entry-1", {}, "1", "nearest").error ==
+            Error::UnprocessableEntity("'mode' parameter can't be used with 'q' parameter"));
+  }
+
   SECTION("wrong ts") {
     REQUIRE(EntryApi::Write(storage.get(), "bucket", "entry-1", "XXXX", {}).error ==
 
@@ -210,6 +441,130 @@ TEST_CASE("EntryApi::Read should read data in chunks with query id") {
   }
 }
 
+/**
+ * Receives a batch response and collects its body
+ */
+static auto ReadBatchBody(reduct::api::HttpRequestReceiver& receiver) {
+  auto [resp, recv_err] = receiver("", true);
+  REQUIRE(recv_err == Error::kOk);
+
+  std::string body;
+  int empty_chunks = 0;
+  while (body.size() < resp.content_length) {
+    auto [chunk, err] = resp.SendData();
+    if (err.code == Error::kContinue) {
+      continue;
+    }
+
+    REQUIRE(err == Error::kOk);
+
+    // the batch stalls if it doesn't move to the next record
+    empty_chunks = chunk.empty() ? empty_chunks + 1 : 0;
+    REQUIRE(empty_chunks < 10);
+    body.append(chunk);
+  }
+
+  REQUIRE(body.size() == resp.content_length);
+  return std::make_pair(resp.headers, body);
+}
+
+TEST_CASE("EntryApi::ReadBatch should read many records of query") {
+  auto storage = IStorage::Build({.data_path = BuildTmpDirectory()});
+  REQUIRE(storage->CreateBucket("bucket", {}) == Error::kOk);
+
+  auto entry = storage->GetBucket("bucket").result.lock()->GetOrCreateEntry("entry-1").result.lock();
+  REQUIRE(WriteOne(*entry, "1234567890", Time() + us(1000001)) == Error::kOk);
+  REQUIRE(WriteOne(*entry, "abcd", Time() + us(2000001)) == Error::kOk);
+  REQUIRE(WriteOne(*entry, "", Time() + us(3000001)) == Error::kOk);
+
+  const auto id = std::to_string(entry->Query({}, {}, {}).result);
+
+  SECTION("all") {
+    auto [receiver, err] = EntryApi::ReadBatch(storage.get(), "bucket", "entry-1", id, {}, {});
+    REQUIRE(err == Error::kOk);
+
+    auto [headers, body] = ReadBatchBody(receiver);
+    REQUIRE(headers["x-reduct-count"] == "3");
+    REQUIRE(headers["x-reduct-last"] == "1");
+    REQUIRE(body == "1000001 10\n1234567890" "2000001 4\nabcd" "3000001 0\n");
+
+    REQUIRE(EntryApi::ReadBatch(storage.get(), "bucket", "entry-1", id, {}, {}).error ==
+            Error::NotFound(fmt::format("Query id={} doesn't exist. It expired or was finished", id)));
+  }
+
+  SECTION("limited by count") {
+    auto [receiver, err] = EntryApi::ReadBatch(storage.get(), "bucket", "entry-1", id, "2", {});
+    REQUIRE(err == Error::kOk);
+
+    auto [headers, body] = ReadBatchBody(receiver);
+    REQUIRE(headers["x-reduct-count"] == "2");
+    REQUIRE(headers["x-reduct-last"] == "0");
+    REQUIRE(body == "1000001 10\n1234567890" "2000001 4\nabcd");
+  }
+
+  SECTION("limited by size") {
+    auto [receiver, err] = EntryApi::ReadBatch(storage.get(), "bucket", "entry-1", id, {}, "5");
+    REQUIRE(err == Error::kOk);
+
+    auto [headers, body] = ReadBatchBody(receiver);
+    REQUIRE(headers["x-reduct-count"] == "1");
+    REQUIRE(body == "1000001 10\n1234567890");
+
+    auto [next_receiver, next_err] = EntryApi::ReadBatch(storage.get(), "bucket", "entry-1", id, {}, "5");
+    REQUIRE(ReadBatchBody(next_receiver).second == "2000001 4\nabcd" "3000001 0\n");
+  }
+
+  SECTION("wrong parameters") {
+    REQUIRE(EntryApi::ReadBatch(storage.get(), "bucket", "entry-1", "XXX", {}, {}).error ==
+            Error::UnprocessableEntity("Failed to parse 'id' parameter: XXX must be unsigned integer"));
+    REQUIRE(EntryApi::ReadBatch(storage.get(), "bucket", "entry-1", id, "XXX", {}).error ==
+            Error::UnprocessableEntity("Failed to parse 'count' parameter: XXX must be unsigned integer"));
+    REQUIRE(EntryApi::ReadBatch(storage.get(), "bucket", "entry-1", id, {}, "XXX").error ==
+            Error::UnprocessableEntity("Failed to parse 'size' parameter: XXX must be unsigned integer"));
+  }
+}
+
+TEST_CASE("EntryApi::ReadBatch should read all records of long query") {
+  auto storage = IStorage::Build({.data_path = BuildTmpDirectory()});
+  REQUIRE(storage->CreateBucket("bucket", {}) == Error::kOk);
+
+  auto entry = storage->GetBucket("bucket").result.lock()->GetOrCreateEntry("entry-1").result.lock();
+  std::string expected;
+  for (int i = 0; i < 100; ++i) {
+    const auto data = fmt::format("record-{}", i);
+    REQUIRE(WriteOne(*entry, data, Time() + us(i + 1)) == Error::kOk);
+    expected += fmt::format("{} {}\n{}", i + 1, data.size(), data);
+  }
+
+  const auto id = std::to_string(entry->Query({}, {}, {}).result);
+  auto [receiver, err] = EntryApi::ReadBatch(storage.get(), "bucket", "entry-1", id, "100", {});
+  REQUIRE(err == Error::kOk);
+
+  auto [headers, body] = ReadBatchBody(receiver);
+  REQUIRE(headers["x-reduct-count"] == "100");
+  REQUIRE(headers["x-reduct-last"] == "1");
+  REQUIRE(body == expected);
+}
+
+TEST_CASE("EntryApi::ReadBatch should clamp number of records") {
+  auto storage = IStorage::Build({.data_path = BuildTmpDirectory()});
+  REQUIRE(storage->CreateBucket("bucket", {}) == Error::kOk);
+
+  auto entry = storage->GetBucket("bucket").result.lock()->GetOrCreateEntry("entry-1").result.lock();
+  for (int i = 0; i < 1001; ++i) {
+    REQUIRE(WriteOne(*entry, "x", Time() + us(i + 1)) == Error::kOk);
+  }
+
+  const auto id = std::to_string(entry->Query({}, {}, {}).result);
+  auto [receiver, err] = EntryApi::ReadBatch(storage.get(), "bucket", "entry-1", id, "1000000", {});
+  REQUIRE(err == Error::kOk);
+
+  auto [headers, body] = ReadBatchBody(receiver);
+  REQUIRE(headers["x-reduct-count"] == "1000");
+  REQUIRE(headers["x-reduct-last"] == "0");
+  REQUIRE(body.ends_with("1000 1\nx"));
+}
+
 TEST_CASE("EntryApi::Query should query data for time interval") {
   auto storage = IStorage::Build({.data_path = BuildTmpDirectory()});
   REQUIRE(storage->CreateBucket("bucket", {}) == Error::kOk);
@@ -235,6 +590,20 @@ TEST_CASE("EntryApi::Query should query data for time interval") {
     REQUIRE(entry->Next(info.id()).error.code == Error::kNotFound);
   }
 
+  SECTION("ok labels") {
+    REQUIRE(WriteOne(*entry, "xx", Time() + us(3000001), {{"anomaly", "true"}}) == Error::kOk);
+
+    auto [receiver, err] = EntryApi::Query(storage.get(), "bucket", "entry-1", {}, {}, {}, {{"anomaly", "true"}});
+    REQUIRE(err == Error::kOk);
+
+    JsonStringToMessage(receiver("", true).result.SendData().result, &info);
+
+    auto [next, next_err] = entry->Next(info.id());
+    REQUIRE(next_err == Error::kOk);
+    REQUIRE(next.reader->timestamp() == Time() + us(3000001));
+    REQUIRE(next.last);
+  }
+
   SECTION("ok start") {
     auto [receiver, err] = EntryApi::Query(storage.get(), "bucket", "entry-1", "1000002", {}, {});
     REQUIRE(err == Error::kOk);
@@ -305,3 +674,141 @@ TEST_CASE("EntryApi::Query should query data for time interval") {
             Error::UnprocessableEntity("Failed to parse 'ttl' parameter: XXX must be unsigned integer"));
   }
 }
+
+TEST_CASE("EntryApi::List should list records of time interval") {
+  auto storage = IStorage::Build({.data_path = BuildTmpDirectory()});
+  REQUIRE(storage->CreateBucket("bucket", {}) == Error::kOk);
+
+  auto entry = storage->GetBucket("bucket").result.lock()->GetOrCreateEntry("entry-1").result.lock();
+  REQUIRE(WriteOne(*entry, "1234567890", Time() + us(1000001)) == Error::kOk);
+  REQUIRE(WriteOne(*entry, "abcd", Time() + us(2000001)) == Error::kOk);
+
+  RecordInfoList list;
+  SECTION("ok json") {
+    auto [receiver, err] = EntryApi::List(storage.get(), "bucket", "entry-1", {}, {}, {}, {});
+    REQUIRE(err == Error::kOk);
+
+    auto [resp, recv_err] = receiver("", true);
+    REQUIRE(recv_err == Error::kOk);
+    REQUIRE(resp.headers["Content-Type"] == "application/json");
+
+    JsonStringToMessage(resp.SendData().result, &list);
+    REQUIRE(list.records_size() == 2);
+    REQUIRE(list.records(0).ts() == 1000001);
+    REQUIRE(list.records(0).size() == 10);
+    REQUIRE(list.records(1).ts() == 2000001);
+    REQUIRE(list.last());
+  }
+
+  SECTION("ok protobuf") {
+    auto [receiver, err] =
+        EntryApi::List(storage.get(), "bucket", "entry-1", "1000002", {}, "1", "application/x-protobuf");
+    REQUIRE(err == Error::kOk);
+
+    auto [resp, recv_err] = receiver("", true);
+    REQUIRE(recv_err == Error::kOk);
+    REQUIRE(resp.headers["Content-Type"] == "application/x-protobuf");
+
+    auto data = resp.SendData().result;
+    REQUIRE(data.size() == resp.content_length);
+    REQUIRE(list.ParseFromArray(data.data(), static_cast<int>(data.size())));
+    REQUIRE(list.records_size() == 1);
+    REQUIRE(list.records(0).ts() == 2000001);
+    REQUIRE(list.records(0).state() == RecordInfo::FINISHED);
+  }
+
+  SECTION("ok media ranges") {
+    auto content_type = [&storage](std::string_view accept) {
+      auto [receiver, err] = EntryApi::List(storage.get(), "bucket", "entry-1", {}, {}, {}, accept);
+      REQUIRE(err == Error::kOk);
+      return receiver("", true).result.headers["Content-Type"];
+    };
+
+    REQUIRE(content_type("application/x-protobuf, */*;q=0.1") == "application/x-protobuf");
+    REQUIRE(content_type("application/json;q=0.5, Application/X-Protobuf") == "application/x-protobuf");
+    REQUIRE(content_type("application/*;q=0.2, application/x-protobuf;q=0.9") == "application/x-protobuf");
+    REQUIRE(content_type("application/x-protobuf;q=0.5, application/json") == "application/json");
+    REQUIRE(content_type("application/x-protobuf;q=0, */*") == "application/json");
+    REQUIRE(content_type("*/*") == "application/json");
+    REQUIRE(content_type("text/html") == "application/json");
+  }
+
+  SECTION("ok limit") {
+    auto [receiver, err] = EntryApi::List(storage.get(), "bucket", "entry-1", {}, "3000000", "1", {});
+    REQUIRE(err == Error::kOk);
+
+    JsonStringToMessage(receiver("", true).result.SendData().result, &list);
+    REQUIRE(list.records_size() == 1);
+    REQUIRE_FALSE(list.last());
+  }
+
+  SECTION("limit is clamped") {
+    auto [receiver, err] = EntryApi::List(storage.get(), "bucket", "entry-1", {}, {}, "18446744073709551615", {});
+    REQUIRE(err == Error::kOk);
+
+    JsonStringToMessage(receiver("", true).result.SendData().result, &list);
+    REQUIRE(list.records_size() == 2);
+    REQUIRE(list.last());
+  }
+
+  SECTION("entry doesn't exist") {
+    REQUIRE(EntryApi::List(storage.get(), "bucket", "XXX", {}, {}, {}, {}).error ==
+            Error::NotFound("Entry 'XXX' is not found"));
+  }
+
+  SECTION("wrong parameters") {
+    REQUIRE(EntryApi::List(storage.get(), "bucket", "entry-1", "XXX", {}, {}, {}).error ==
+            Error::UnprocessableEntity("Failed to parse 'start' parameter: XXX must unix times in microseconds"));
+    REQUIRE(EntryApi::List(storage.get(), "bucket", "entry-1", {}, "XXX", {}, {}).error ==
+            Error::UnprocessableEntity("Failed to parse 'stop' parameter: XXX must unix times in microseconds"));
+    REQUIRE(EntryApi::List(storage.get(), "bucket", "entry-1", {}, {}, "XXX", {}).error ==
+            Error::UnprocessableEntity("Failed to parse 'limit' parameter: XXX must be unsigned integer"));
+  }
+}
+
+/**
+ * Storage which takes its time to find a bucket, e.g. when the disk is busy
+ */
+class SlowStorage : public IStorage {
+ public:
+  static constexpr std::chrono::milliseconds kDelay{200};
+
+  explicit SlowStorage(std::unique_ptr<IStorage> storage) : storage_(std::move(storage)) {}
+
+  Result<reduct::proto::api::ServerInfo> GetInfo() const override { return storage_->GetInfo(); }
+  Result<reduct::proto::api::BucketInfoList> GetList() const override { return storage_->GetList(); }
+
+  Error CreateBucket(const std::string& bucket_name, const reduct::proto::api::BucketSettings& settings) override {
+    return storage_->CreateBucket(bucket_name, settings);
+  }
+
+  Result<IBucket::WPtr> GetBucket(const std::string& bucket_name) const override {
+    std::this_thread::sleep_for(kDelay);
+    return storage_->GetBucket(bucket_name);
+  }
+
+  Error RemoveBucket(const std::string& bucket_name) override { return storage_->RemoveBucket(bucket_name); }
+
+ private:
+  std::unique_ptr<IStorage> storage_;
+};
+
+Task<Result<HttpRequestReceiver>> WriteInPool(IStorage* storage, ThreadPoolExecutor* pool) {
+  co_return co_await Run<Result<HttpRequestReceiver>, ThreadPoolExecutor>(
+      [storage] { return EntryApi::Write(storage, "bucket", "entry-1", "1000001", "4"); }, pool);
+}
+
+TEST_CASE("EntryApi should run in thread pool without blocking loop") {
+  SlowStorage storage(IStorage::Build({.data_path = BuildTmpDirectory()}));
+  REQUIRE(storage.CreateBucket("bucket", {}) == Error::kOk);
+  ThreadPoolExecutor pool({.threads = 1});
+
+  // the HTTP server awaits the handler in the same way
+  const auto start = std::chrono::steady_clock::now();
+  auto task = WriteInPool(&storage, &pool);
+  REQUIRE(std::chrono::steady_clock::now() - start < SlowStorage::kDelay);  // the loop serves other requests
+
+  auto [receiver, err] = task.Get();
+  REQUIRE(err == Error::kOk);
+  REQUIRE(receiver("abcd", true).error == Error::kOk);
+}
@@ -0,0 +1,100 @@
+// Copyright 2023 ReductStore
+// This Source Code Form is subject to the terms of the Mozilla Public
+//    License, v. 2.0. If a copy of the MPL was not distributed with this
+//    file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#include "reduct/api/subscription.h"
+
+#include <catch2/catch.hpp>
+
+#include <string>
+#include <vector>
+
+#include "reduct/helpers.h"
+
+using reduct::WriteOne;
+using reduct::api::ISubscription;
+using reduct::core::Error;
+using reduct::core::Time;
+using reduct::storage::IStorage;
+
+using us = std::chrono::microseconds;
+
+static Error PumpAll(ISubscription* subscription, const ISubscription::Send& send) {
+  Error err;
+  while ((err = subscription->Pump(send)).code == Error::kContinue) {
+  }
+  return err;
+}
+
+TEST_CASE("ISubscription should send finished records") {
+  auto storage = IStorage::Build({.data_path = BuildTmpDirectory()});
+  REQUIRE(storage->CreateBucket("bucket", {}) == Error::kOk);
+  auto entry = storage->GetBucket("bucket").result.lock()->GetOrCreateEntry("entry").result.lock();
+
+  int notified = 0;
+  std::vector<std::string> messages;
+  auto send = [&messages](std::string_view msg) {
+    messages.emplace_back(msg);
+    return true;
+  };
+
+  SECTION("live") {
+    auto [subscription, err] = ISubscription::Build(storage.get(), "bucket", "entry", "", [&notified] { notified++; });
+    REQUIRE(err == Error::kOk);
+
+    REQUIRE(WriteOne(*entry, "record-1", Time() + us(1)) == Error::kOk);
+    REQUIRE(WriteOne(*entry, "record-2", Time() + us(2)) == Error::kOk);
+    REQUIRE(notified == 2);
+
+    REQUIRE(PumpAll(subscription.get(), send) == Error::kOk);
+    REQUIRE(messages == std::vector<std::string>{"1 8\nrecord-1", "2 8\nrecord-2"});
+  }
+
+  SECTION("resume from timestamp") {
+    REQUIRE(WriteOne(*entry, "record-1", Time() + us(1)) == Error::kOk);
+    REQUIRE(WriteOne(*entry, "record-2", Time() + us(2)) == Error::kOk);
+
+    auto [subscription, err] = ISubscription::Build(storage.get(), "bucket", "entry", "2", [&notified] { notified++; });
+    REQUIRE(err == Error::kOk);
+    REQUIRE(WriteOne(*entry, "record-3", Time() + us(3)) == Error::kOk);
+
+    REQUIRE(PumpAll(subscription.get(), send) == Error::kOk);
+    REQUIRE(messages == std::vector<std::string>{"2 8\nrecord-2", "3 8\nrecord-3"});
+  }
+
+  SECTION("pause on backpressure") {
+    auto [subscription, err] = ISubscription::Build(storage.get(), "bucket", "entry", "", [] {});
+    REQUIRE(WriteOne(*entry, "record-1", Time() + us(1)) == Error::kOk);
+    REQUIRE(WriteOne(*entry, "record-2", Time() + us(2)) == Error::kOk);
+
+    auto busy_send = [&messages](std::string_view msg) {
+      messages.emplace_back(msg);
+      return false;
+    };
+
+    REQUIRE(PumpAll(subscription.get(), busy_send) == Error::kOk);
+    REQUIRE(messages.size() == 1);
+
+    REQUIRE(PumpAll(subscription.get(), busy_send) == Error::kOk);
+    REQUIRE(messages.size() == 2);
+  }
+
+  SECTION("close slow subscriber") {
+    auto [subscription, err] = ISubscription::Build(storage.get(), "bucket", "entry", "", [] {});
+    for (size_t i = 0; i <= ISubscription::kMaxPendingRecords; ++i) {
+      REQUIRE(WriteOne(*entry, "x", Time() + us(i)) == Error::kOk);
+    }
+
+    REQUIRE(PumpAll(subscription.get(), send).code == Error::kServiceUnavailable);
+  }
+
+  SECTION("errors") {
+    REQUIRE(ISubscription::Build(storage.get(), "UNKNOWN", "entry", "", [] {}).error.code == Error::kNotFound);
+    REQUIRE(ISubscription::Build(storage.get(), "bucket", "UNKNOWN", "", [] {}).error ==
+            Error::NotFound("Entry 'UNKNOWN' is not found"));
+    REQUIRE_FALSE(storage->GetBucket("bucket").result.lock()->HasEntry("UNKNOWN"));
+    REQUIRE(ISubscription::Build(storage.get(), "bucket", "entry", "XXX", [] {}).error.code ==
+            Error::kUnprocessableEntity);
+  }
+}
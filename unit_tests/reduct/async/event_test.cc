@@ -0,0 +1,46 @@
+// Copyright 2023 ReductStore
+// This Source Code Form is subject to the terms of the Mozilla Public
+//    License, v. 2.0. If a copy of the MPL was not distributed with this
+//    file, You can obtain one at https://mozilla.org/MPL/2.0/.
+#include "reduct/async/event.h"
+
+#include <catch2/catch.hpp>
+
+#include "reduct/async/task.h"
+
+using reduct::async::Event;
+using reduct::async::Task;
+
+Task<int> WaitEvent(Event* event, int* resumed) {
+  co_await *event;
+  ++*resumed;
+  co_await *event;
+  ++*resumed;
+  co_return 100;
+}
+
+TEST_CASE("async::Event should resume coroutine when it is set", "[event]") {
+  Event event;
+  int resumed = 0;
+  auto task = WaitEvent(&event, &resumed);
+  REQUIRE(resumed == 0);
+
+  event.Set();
+  REQUIRE(resumed == 1);
+
+  event.Set();
+  REQUIRE(resumed == 2);
+  REQUIRE(task.Get() == 100);
+}
+
+TEST_CASE("async::Event shouldn't suspend coroutine if it is already set", "[event]") {
+  Event event;
+  int resumed = 0;
+  event.Set();
+
+  auto task = WaitEvent(&event, &resumed);
+  REQUIRE(resumed == 1);  // the event is reset after resuming
+
+  event.Set();
+  REQUIRE(task.Get() == 100);
+}
@@ -6,10 +6,15 @@
 
 #include <catch2/catch.hpp>
 
+#include <algorithm>
 #include <chrono>
+#include <vector>
 
 #include "reduct/async/task.h"
 
+using reduct::async::ILoop;
+using reduct::async::kMaxBackoff;
+using reduct::async::kTick;
 using reduct::async::Run;
 using reduct::async::RunUntil;
 using reduct::async::Task;
@@ -73,3 +78,37 @@ TEST_CASE("async::RunUntil should run task in loop by default") {
   auto task = RunUntilCoro(func);
   REQUIRE(task.Get() == 20);
 }
+
+TEST_CASE("async::RunUntil should back off while task is pending") {
+  // records the delays instead of sleeping
+  struct RecordingLoop : public ILoop {
+    void Defer(Task&& task) override { task(); }
+
+    void Schedule(std::chrono::microseconds delay, Task&& task) override {
+      delays.push_back(delay);
+      task();
+    }
+
+    std::vector<std::chrono::microseconds> delays;
+  };
+
+  auto& default_loop = ILoop::loop();
+  RecordingLoop loop;
+  ILoop::set_loop(&loop);
+
+  auto task = RunUntilCoro([count = 0]() mutable -> std::optional<int> {
+    if (++count < 20) {
+      return {};
+    }
+    return count;
+  });
+  REQUIRE(task.Get() == 20);
+  ILoop::set_loop(&default_loop);
+
+  // the task isn't deferred again at once, each retry waits longer up to the max delay
+  REQUIRE(loop.delays.size() == 19);
+  REQUIRE(loop.delays[0] == kTick);
+  REQUIRE(loop.delays[1] == kTick * 2);
+  REQUIRE(std::ranges::is_sorted(loop.delays));
+  REQUIRE(loop.delays.back() == kMaxBackoff);
+}
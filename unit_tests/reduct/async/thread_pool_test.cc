@@ -0,0 +1,113 @@
+// Copyright 2023 ReductStore
+// This Source Code Form is subject to the terms of the Mozilla Public
+//    License, v. 2.0. If a copy of the MPL was not distributed with this
+//    file, You can obtain one at https://mozilla.org/MPL/2.0/.
+#include "reduct/async/thread_pool.h"
+
+#include <catch2/catch.hpp>
+
+#include <set>
+
+#include "reduct/async/run.h"
+#include "reduct/async/task.h"
+
+using reduct::async::Run;
+using reduct::async::Task;
+using reduct::async::ThreadPoolExecutor;
+
+using namespace std::chrono_literals;  // NOLINT
+
+TEST_CASE("async::ThreadPoolExecutor should run tasks in workers", "[thread_pool]") {
+  ThreadPoolExecutor pool({.threads = 4});
+  REQUIRE(pool.size() == 4);
+
+  std::vector<std::future<std::thread::id>> futures;
+  for (int i = 0; i < 100; ++i) {
+    futures.push_back(pool.Commit([] {
+      std::this_thread::sleep_for(1ms);
+      return std::this_thread::get_id();
+    }));
+  }
+
+  std::set<std::thread::id> threads;
+  for (auto& future : futures) {
+    threads.insert(future.get());
+  }
+
+  REQUIRE(threads.size() > 1);
+  REQUIRE_FALSE(threads.contains(std::this_thread::get_id()));
+  REQUIRE(pool.pending() == 0);
+}
+
+TEST_CASE("async::ThreadPoolExecutor should run task in caller if queue is full", "[thread_pool]") {
+  ThreadPoolExecutor pool({.threads = 1, .max_queue_size = 1});
+
+  std::promise<void> unblock;
+  auto blocked = pool.Commit([started = unblock.get_future().share()] { started.wait(); });
+  std::this_thread::sleep_for(10ms);  // the worker takes the first task
+
+  auto queued = pool.Commit([] { return std::this_thread::get_id(); });
+  auto overflowed = pool.Commit([] { return std::this_thread::get_id(); });
+  REQUIRE(overflowed.get() == std::this_thread::get_id());
+
+  unblock.set_value();
+  REQUIRE(queued.get() != std::this_thread::get_id());
+}
+
+TEST_CASE("async::ThreadPoolExecutor should finish tasks before stopping", "[thread_pool]") {
+  std::atomic<int> count = 0;
+  {
+    ThreadPoolExecutor pool({.threads = 2});
+    for (int i = 0; i < 10; ++i) {
+      pool.Commit([&count] {
+        std::this_thread::sleep_for(1ms);
+        count++;
+      });
+    }
+  }
+
+  REQUIRE(count == 10);
+}
+
+TEST_CASE("async::ThreadPoolExecutor should run tasks while a task waits", "[thread_pool]") {
+  ThreadPoolExecutor pool({.threads = 1});
+
+  auto outer = pool.Commit([&pool] {
+    auto inner = pool.Commit([] { return 10; });
+    return pool.Wait(std::move(inner)) + 1;
+  });
+
+  REQUIRE(outer.wait_for(1s) == std::future_status::ready);
+  REQUIRE(outer.get() == 11);
+}
+
+TEST_CASE("async::ThreadPoolExecutor should wake up a waiter when a worker finishes the task", "[thread_pool]") {
+  ThreadPoolExecutor pool({.threads = 1});
+
+  std::promise<void> started;
+  std::promise<void> release;
+  auto task = pool.Commit([&started, released = release.get_future()] {
+    started.set_value();
+    released.wait();
+    return 10;
+  });
+  started.get_future().wait();  // the worker runs the task, so the waiter has nothing to run and sleeps
+
+  std::thread releaser([&release] {
+    std::this_thread::sleep_for(10ms);
+    release.set_value();
+  });
+
+  REQUIRE(pool.Wait(std::move(task)) == 10);
+  releaser.join();
+}
+
+Task<int> RunInPool(ThreadPoolExecutor* pool) {
+  co_return co_await Run<int, ThreadPoolExecutor>([] { return 100; }, pool);
+}
+
+TEST_CASE("async::ThreadPoolExecutor should be used by async::Run", "[thread_pool]") {
+  ThreadPoolExecutor pool({.threads = 2});
+  auto task = RunInPool(&pool);
+  REQUIRE(task.Get() == 100);
+}
@@ -57,6 +57,18 @@ static proto::api::BucketSettings MakeDefaultBucketSettings() {
   return settings;
 }
 
+/**
+ * Waits until a writer puts all the data on disk
+ * @param writer
+ * @return
+ */
+inline core::Error WaitWritten(async::IAsyncWriter& writer) {  // NOLINT
+  std::optional<core::Error> result;
+  while (!(result = writer.sync_result())) {
+  }
+  return *result;
+}
+
 /**
  * Simple writing a record in one step
  * @param entry
@@ -64,12 +76,18 @@ static proto::api::BucketSettings MakeDefaultBucketSettings() {
  * @param ts
  * @return
  */
-inline auto WriteOne(storage::IEntry& entry, std::string_view blob, core::Time ts) {  // NOLINT
-  auto [ret, err] = entry.BeginWrite(ts, blob.size());
+inline auto WriteOne(storage::IEntry& entry, std::string_view blob, core::Time ts,  // NOLINT
+                     const async::LabelMap& labels = {}) {
+  auto [ret, err] = entry.BeginWrite(ts, blob.size(), labels);
   if (err) {
     return err;
   }
-  return ret->Write(blob);
+
+  if (auto write_err = ret->Write(blob)) {
+    return write_err;
+  }
+
+  return WaitWritten(*ret);
 }
 
 /**
@@ -85,11 +103,15 @@ inline core::Result<std::string> ReadOne(const storage::IEntry& entry, core::Tim
   }
 
   auto read_res = reader->Read();
+  while (read_res.error.code == core::Error::kContinue) {
+    read_res = reader->Read();
+  }
+
   if (read_res.error) {
     return {{}, read_res.error};
   }
 
-  return {read_res.result.data, core::Error::kOk};
+  return {std::string(read_res.result.data), core::Error::kOk};
 }
 
 
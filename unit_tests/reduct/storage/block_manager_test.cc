@@ -0,0 +1,305 @@
+// Copyright 2022 ReductStore
+// This Source Code Form is subject to the terms of the Mozilla Public
+//    License, v. 2.0. If a copy of the MPL was not distributed with this
+//    file, You can obtain one at https://mozilla.org/MPL/2.0/.
+#include "reduct/storage/block_manager.h"
+
+#include <catch2/catch.hpp>
+#include <google/protobuf/util/time_util.h>
+
+#include <fstream>
+
+#include "reduct/helpers.h"
+#include "reduct/storage/block_descriptor.h"
+#include "reduct/storage/block_summary.h"
+
+using reduct::core::Error;
+using reduct::proto::Record;
+using reduct::storage::BlockDescriptorHeader;
+using reduct::storage::BlockDescriptorRecord;
+using reduct::storage::BlockPath;
+using reduct::storage::IBlockManager;
+using reduct::storage::IsBlockDescriptor;
+using reduct::storage::kJournalExt;
+using reduct::storage::kMetaExt;
+using reduct::storage::kSummaryExt;
+using reduct::storage::LabelBloomFilter;
+
+using google::protobuf::util::TimeUtil;
+
+namespace fs = std::filesystem;
+
+static auto MakeTs(int64_t us) { return TimeUtil::MicrosecondsToTimestamp(us); }
+
+TEST_CASE("storage::BlockManager should cache descriptors", "[block_manager]") {
+  const auto path = BuildTmpDirectory();
+  auto block_manager = IBlockManager::Build(path);
+
+  REQUIRE(block_manager->StartBlock(1, 100).error == Error::kOk);
+  REQUIRE(block_manager->StartBlock(2, 100).error == Error::kOk);
+  REQUIRE(block_manager->GetCacheStats().count == 2);
+
+  SECTION("hit") {
+    auto [block, err] = block_manager->LoadBlock(1);
+    REQUIRE(err == Error::kOk);
+    REQUIRE(block->begin_time() == MakeTs(1));
+
+    REQUIRE(block_manager->LoadBlock(2).error == Error::kOk);
+
+    const auto stats = block_manager->GetCacheStats();
+    REQUIRE(stats.hits == 2);
+    REQUIRE(stats.misses == 0);
+  }
+
+  SECTION("miss") {
+    auto other_manager = IBlockManager::Build(path);
+    REQUIRE(other_manager->LoadBlock(1).error == Error::kOk);
+    REQUIRE(other_manager->LoadBlock(1).error == Error::kOk);
+
+    const auto stats = other_manager->GetCacheStats();
+    REQUIRE(stats.hits == 1);
+    REQUIRE(stats.misses == 1);
+    REQUIRE(stats.count == 1);
+  }
+
+  SECTION("remove block from cache") {
+    auto [block, err] = block_manager->LoadBlock(1);
+    REQUIRE(block_manager->RemoveBlock(block) == Error::kOk);
+    REQUIRE(block_manager->GetCacheStats().count == 1);
+    REQUIRE(block_manager->LoadBlock(1).error.code == 500);
+  }
+}
+
+TEST_CASE("storage::BlockManager should evict least recently used descriptors", "[block_manager]") {
+  const auto path = BuildTmpDirectory();
+  auto block_manager = IBlockManager::Build(path, 1);  // only one descriptor fits
+
+  REQUIRE(block_manager->StartBlock(1, 100).error == Error::kOk);
+  REQUIRE(block_manager->StartBlock(2, 100).error == Error::kOk);
+  REQUIRE(block_manager->GetCacheStats().count == 1);
+
+  REQUIRE(block_manager->LoadBlock(2).error == Error::kOk);
+  REQUIRE(block_manager->LoadBlock(1).error == Error::kOk);
+
+  const auto stats = block_manager->GetCacheStats();
+  REQUIRE(stats.hits == 1);
+  REQUIRE(stats.misses == 1);
+  REQUIRE(stats.count == 1);
+
+  SECTION("evicted descriptor which is still in use") {
+    auto [block, err] = block_manager->LoadBlock(2);
+    REQUIRE(block_manager->LoadBlock(1).error == Error::kOk);
+
+    auto [same_block, same_err] = block_manager->LoadBlock(2);
+    REQUIRE(same_err == Error::kOk);
+    REQUIRE(same_block == block);
+    REQUIRE(block_manager->GetCacheStats().misses == stats.misses + 2);  // only the first two loads
+  }
+}
+
+TEST_CASE("storage::BlockManager should journal records until block is finished", "[block_manager][journal]") {
+  const auto path = BuildTmpDirectory();
+  auto block_manager = IBlockManager::Build(path);
+
+  auto [block, err] = block_manager->StartBlock(1, 100);
+  REQUIRE(err == Error::kOk);
+
+  const auto meta_path = BlockPath(path, *block, kMetaExt);
+  const auto journal_path = BlockPath(path, *block, kJournalExt);
+  const auto meta_size = fs::file_size(meta_path);
+
+  for (int i = 0; i < 3; ++i) {
+    auto record = block->add_records();
+    record->mutable_timestamp()->CopyFrom(MakeTs(i + 1));
+    record->set_begin(block->size());
+    record->set_end(block->size() + 10);
+    block->set_size(record->end());
+    block->mutable_latest_record_time()->CopyFrom(record->timestamp());
+    REQUIRE(block_manager->AppendRecord(block, i) == Error::kOk);
+  }
+  REQUIRE(block_manager->UpdateRecordState(block, 1, Record::kFinished) == Error::kOk);
+
+  REQUIRE(fs::file_size(meta_path) == meta_size);
+  REQUIRE(fs::exists(journal_path));
+
+  SECTION("replay") {
+    auto restored = IBlockManager::Build(path)->LoadBlock(1).result;
+    REQUIRE(restored);
+    REQUIRE(*restored == *block);
+  }
+
+  SECTION("replay with broken tail") {
+    {
+      std::ofstream journal(journal_path, std::ios::binary | std::ios::app);
+      journal << "\x20garbage";
+    }
+
+    auto restored = IBlockManager::Build(path)->LoadBlock(1).result;
+    REQUIRE(restored);
+    REQUIRE(*restored == *block);
+
+    REQUIRE(block_manager->UpdateRecordState(block, 2, Record::kErrored) == Error::kOk);
+    restored = IBlockManager::Build(path)->LoadBlock(1).result;
+    REQUIRE(restored->records(2).state() == Record::kErrored);
+  }
+
+  SECTION("compact") {
+    REQUIRE(block_manager->FinishBlock(block) == Error::kOk);
+    REQUIRE_FALSE(fs::exists(journal_path));
+
+    auto restored = IBlockManager::Build(path)->LoadBlock(1).result;
+    REQUIRE(restored);
+    REQUIRE(*restored == *block);
+  }
+}
+
+TEST_CASE("storage::BlockManager should keep records sorted by timestamp", "[block_manager][index]") {
+  const auto path = BuildTmpDirectory();
+  auto block_manager = IBlockManager::Build(path);
+
+  auto [block, err] = block_manager->StartBlock(1, 100);
+  REQUIRE(err == Error::kOk);
+  REQUIRE(block_manager->GetRecordIndex(block).empty());
+
+  for (auto ts : {10, 30, 20}) {
+    auto record = block->add_records();
+    record->mutable_timestamp()->CopyFrom(MakeTs(ts));
+    REQUIRE(block_manager->AppendRecord(block, block->records_size() - 1) == Error::kOk);
+  }
+
+  const IBlockManager::RecordIndex expected = {
+      .timestamps = {10, 20, 30},
+      .indexes = {0, 2, 1},
+      .states = {Record::kStarted, Record::kStarted, Record::kStarted},
+  };
+  REQUIRE(block_manager->GetRecordIndex(block) == expected);
+
+  SECTION("load") {
+    auto other_manager = IBlockManager::Build(path);
+    auto loaded = other_manager->LoadBlock(1).result;
+    REQUIRE(other_manager->GetRecordIndex(loaded) == expected);
+  }
+}
+
+TEST_CASE("storage::BlockManager should save descriptors in binary format", "[block_manager][descriptor]") {
+  const auto path = BuildTmpDirectory();
+  auto block_manager = IBlockManager::Build(path);
+
+  auto [block, err] = block_manager->StartBlock(1, 100);
+  REQUIRE(err == Error::kOk);
+
+  for (int i = 0; i < 2; ++i) {
+    auto record = block->add_records();
+    record->mutable_timestamp()->CopyFrom(MakeTs(i + 1));
+    record->set_begin(i * 10);
+    record->set_end(i * 10 + 10);
+    record->set_state(Record::kFinished);
+  }
+
+  auto meta = block->mutable_records(1)->add_meta_data();
+  meta->set_key("key");
+  meta->set_value("value");
+  block->set_size(20);
+  block->mutable_latest_record_time()->CopyFrom(MakeTs(2));
+
+  REQUIRE(block_manager->FinishBlock(block) == Error::kOk);
+
+  const auto meta_path = BlockPath(path, *block, kMetaExt);
+  REQUIRE(fs::file_size(meta_path) ==
+          sizeof(BlockDescriptorHeader) + 2 * sizeof(BlockDescriptorRecord) + sizeof(uint32_t) * 3 + 8);
+
+  auto restored = IBlockManager::Build(path)->LoadBlock(1).result;
+  REQUIRE(restored);
+  REQUIRE(*restored == *block);
+
+  SECTION("truncated") {
+    fs::resize_file(meta_path, sizeof(BlockDescriptorHeader) + sizeof(BlockDescriptorRecord));
+    REQUIRE(IBlockManager::Build(path)->LoadBlock(1).error.code == 500);
+  }
+}
+
+TEST_CASE("storage::BlockManager should convert protobuf descriptors", "[block_manager][descriptor]") {
+  const auto path = BuildTmpDirectory();
+  fs::create_directories(path);
+
+  reduct::proto::Block block;
+  block.mutable_begin_time()->CopyFrom(MakeTs(1));
+  block.mutable_latest_record_time()->CopyFrom(MakeTs(1));
+  block.set_size(10);
+  auto record = block.add_records();
+  record->mutable_timestamp()->CopyFrom(MakeTs(1));
+  record->set_end(10);
+  record->set_state(Record::kFinished);
+
+  const auto meta_path = BlockPath(path, block, kMetaExt);
+  {
+    std::ofstream file(meta_path, std::ios::binary);
+    REQUIRE(block.SerializeToOstream(&file));
+  }
+
+  auto loaded = IBlockManager::Build(path)->LoadBlock(1).result;
+  REQUIRE(loaded);
+  REQUIRE(*loaded == block);
+
+  std::ifstream file(meta_path, std::ios::binary);
+  std::string data{std::istreambuf_iterator<char>(file), {}};
+  REQUIRE(IsBlockDescriptor(data));
+}
+
+TEST_CASE("storage::BlockManager should save summary of finished block", "[block_manager][summary]") {
+  const auto path = BuildTmpDirectory();
+  auto block_manager = IBlockManager::Build(path);
+
+  auto [block, err] = block_manager->StartBlock(1, 100);
+  REQUIRE(err == Error::kOk);
+  REQUIRE(block_manager->LoadSummary(1).error == Error::NotFound("Block 1 has no summary"));
+
+  for (int i = 0; i < 3; ++i) {
+    auto record = block->add_records();
+    record->mutable_timestamp()->CopyFrom(MakeTs(i + 1));
+    record->set_begin(i * 10);
+    record->set_end(i * 10 + 5 + i);
+    record->set_state(Record::kFinished);
+
+    auto label = record->add_meta_data();
+    label->set_key("camera");
+    label->set_value(std::to_string(i));
+    REQUIRE(block_manager->AppendRecord(block, i) == Error::kOk);
+  }
+  block->set_size(27);
+  block->mutable_latest_record_time()->CopyFrom(MakeTs(3));
+
+  REQUIRE(block_manager->FinishBlock(block) == Error::kOk);
+
+  auto [summary, summary_err] = IBlockManager::Build(path)->LoadSummary(1);
+  REQUIRE(summary_err == Error::kOk);
+  REQUIRE(summary.begin_time() == MakeTs(1));
+  REQUIRE(summary.latest_record_time() == MakeTs(3));
+  REQUIRE(summary.size() == 27);
+  REQUIRE(summary.record_count() == 3);
+  REQUIRE(summary.min_record_size() == 5);
+  REQUIRE(summary.max_record_size() == 7);
+
+  const LabelBloomFilter filter(summary.label_filter());
+  REQUIRE(filter.MayContain("camera", "0"));
+  REQUIRE(filter.MayContain("camera", "2"));
+  REQUIRE(filter.MayContainAll({{"camera", "1"}}));
+  REQUIRE_FALSE(filter.MayContain("camera", "3"));
+  REQUIRE_FALSE(filter.MayContain("anomaly", "true"));
+
+  SECTION("removed with block") {
+    REQUIRE(block_manager->RemoveBlock(block) == Error::kOk);
+    REQUIRE_FALSE(fs::exists(path / fmt::format("1{}", kSummaryExt)));
+  }
+
+  SECTION("stale if descriptor changed") {
+    std::ofstream(path / fmt::format("1{}", kMetaExt), std::ios::app) << "x";
+    REQUIRE(IBlockManager::Build(path)->LoadSummary(1).error == Error::Conflict("Summary of block 1 is stale"));
+  }
+
+  SECTION("stale if block has journal") {
+    REQUIRE(block_manager->UpdateRecordState(block, 0, Record::kInvalid) == Error::kOk);
+    REQUIRE(fs::exists(path / fmt::format("1{}", kJournalExt)));
+    REQUIRE(IBlockManager::Build(path)->LoadSummary(1).error == Error::Conflict("Summary of block 1 is stale"));
+  }
+}
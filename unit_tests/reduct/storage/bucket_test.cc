@@ -6,6 +6,8 @@
 
 #include <catch2/catch.hpp>
 
+#include <fstream>
+
 #include "reduct/config.h"
 #include "reduct/helpers.h"
 
@@ -56,6 +58,15 @@ TEST_CASE("storage::Bucket should restore from folder", "[bucket]") {
     fs::create_directory(dir_path / "empty_folder");
     REQUIRE_FALSE(IBucket::Restore(dir_path / "empty_folder"));
   }
+
+  SECTION("restore entries in thread pool") {
+    REQUIRE(bucket->GetOrCreateEntry("entry2").error == Error::kOk);
+
+    reduct::async::ThreadPoolExecutor pool({.threads = 2});
+    restored_bucket = IBucket::Restore(dir_path / "bucket", &pool);
+    REQUIRE(restored_bucket->GetInfo() == bucket->GetInfo());
+    REQUIRE(restored_bucket->GetEntryList().size() == 2);
+  }
 }
 
 TEST_CASE("storage::Bucket should create get or create entry", "[bucket][entry]") {
@@ -83,6 +94,14 @@ TEST_CASE("storage::Bucket should create get or create entry", "[bucket][entry]"
     REQUIRE(ref.result.lock()->GetInfo().record_count() == 1);
   }
 
+  SECTION("get only an existing entry") {
+    REQUIRE(bucket->GetEntry("entry_1").error == Error::NotFound("Entry 'entry_1' is not found"));
+    REQUIRE_FALSE(bucket->HasEntry("entry_1"));
+
+    REQUIRE(bucket->GetOrCreateEntry("entry_1").error == Error::kOk);
+    REQUIRE(bucket->GetEntry("entry_1").result.lock());
+  }
+
   SECTION("wrong entry name") {
     auto [_, err] = bucket->GetOrCreateEntry("entry/sak#");
     REQUIRE(err == Error{.code = 422, .message = "Entry name can contain only letters, digests and [-,_] symbols"});
@@ -103,6 +122,46 @@ TEST_CASE("storage::Bucket should remove all entries", "[bucket]") {
   REQUIRE_FALSE(fs::exists(dir_path / "bucket" / "entry_2"));
 }
 
+TEST_CASE("storage::Bucket should keep statistics without loading blocks", "[bucket]") {
+  BucketSettings settings;
+  settings.set_max_block_size(100);
+  const auto path = BuildTmpDirectory();
+  auto bucket = IBucket::Build(path / "bucket", std::move(settings));
+
+  auto info = bucket->GetInfo();
+  REQUIRE(info.size() == 0);
+  REQUIRE(info.oldest_record() == std::numeric_limits<uint64_t>::max());
+  REQUIRE(info.latest_record() == 0);
+
+  auto entry1 = bucket->GetOrCreateEntry("entry_1").result.lock();
+  auto entry2 = bucket->GetOrCreateEntry("entry_2").result.lock();
+
+  const auto ts = Time();
+  std::string blob(400, 'x');
+  REQUIRE(entry1->BeginWrite(ts + seconds(2), blob.size()).result->Write(blob) == Error::kOk);
+  REQUIRE(entry2->BeginWrite(ts + seconds(3), blob.size()).result->Write(blob) == Error::kOk);
+  REQUIRE(entry1->BeginWrite(ts + seconds(1), blob.size()).result->Write(blob) == Error::kOk);
+
+  info = bucket->GetInfo();
+  REQUIRE(info.size() == 1200);
+  REQUIRE(info.entry_count() == 2);
+  REQUIRE(info.oldest_record() == 1'000'000);
+  REQUIRE(info.latest_record() == 3'000'000);
+
+  REQUIRE(entry1->RemoveOldestBlock() == Error::kOk);
+  info = bucket->GetInfo();
+  REQUIRE(info.size() == 800);
+  REQUIRE(info.oldest_record() == 2'000'000);
+
+  REQUIRE(entry2->RemoveOldestBlock() == Error::kOk);
+  info = bucket->GetInfo();
+  REQUIRE(info.size() == 400);
+  REQUIRE(info.latest_record() == 2'000'000);
+
+  auto restored = IBucket::Restore(path / "bucket");
+  REQUIRE(restored->GetInfo() == bucket->GetInfo());
+}
+
 TEST_CASE("storage::Bucket should keep quota", "[bucket][quota]") {
   BucketSettings settings;
   settings.set_max_block_size(100);
@@ -163,6 +222,82 @@ TEST_CASE("storage::Bucket should keep quota", "[bucket][quota]") {
     REQUIRE(bucket->KeepQuota() == Error::kOk);
     REQUIRE(entry1->GetInfo().record_count() == 2);
   }
+
+  SECTION("should remove a belated block first") {
+    REQUIRE(entry1->BeginWrite(ts + seconds(2), blob.size()).result->Write(blob) == Error::kOk);
+    REQUIRE(entry2->BeginWrite(ts + seconds(3), blob.size()).result->Write(blob) == Error::kOk);
+    REQUIRE(entry2->BeginWrite(ts + seconds(1), blob.size()).result->Write(blob) == Error::kOk);
+
+    REQUIRE(bucket->KeepQuota() == Error::kOk);
+    REQUIRE(entry2->BeginRead(ts + seconds(1)).error.code == 404);
+    REQUIRE(entry1->BeginRead(ts + seconds(2)).error == Error::kOk);
+    REQUIRE(entry2->BeginRead(ts + seconds(3)).error == Error::kOk);
+  }
+
+  SECTION("should count size of restored entries") {
+    REQUIRE(entry1->BeginWrite(ts + seconds(1), blob.size()).result->Write(blob) == Error::kOk);
+    REQUIRE(entry2->BeginWrite(ts + seconds(2), blob.size()).result->Write(blob) == Error::kOk);
+    REQUIRE(entry1->BeginWrite(ts + seconds(3), blob.size()).result->Write(blob) == Error::kOk);
+
+    bucket = IBucket::Restore(path / "bucket");
+    REQUIRE(bucket);
+    REQUIRE(bucket->KeepQuota() == Error::kOk);
+    REQUIRE(bucket->GetInfo().size() == 800);
+  }
+}
+
+TEST_CASE("storage::Bucket should reclaim the oldest block over a share of quota", "[bucket][quota]") {
+  BucketSettings settings;
+  settings.set_max_block_size(100);
+  settings.set_quota_type(BucketSettings::FIFO);
+  settings.set_quota_size(1000);
+  const auto path = BuildTmpDirectory();
+  auto bucket = IBucket::Build(path / "bucket", std::move(settings));
+
+  auto entry = bucket->GetOrCreateEntry("entry_1").result.lock();
+  const auto ts = Time();
+  std::string blob(400, 'x');
+  REQUIRE(entry->BeginWrite(ts + seconds(1), blob.size()).result->Write(blob) == Error::kOk);
+  REQUIRE(entry->BeginWrite(ts + seconds(2), blob.size()).result->Write(blob) == Error::kOk);
+  REQUIRE(bucket->GetQuotaFill() == Approx(0.8));
+
+  REQUIRE(bucket->ReclaimOldestBlock(0.9).result == 0);
+  REQUIRE(bucket->ReclaimOldestBlock(0.5).result == 400);
+  REQUIRE(bucket->ReclaimOldestBlock(0.3).result == 400);
+  REQUIRE(bucket->ReclaimOldestBlock(0.3).result == 0);
+
+  REQUIRE(bucket->GetQuotaFill() == 0);
+  REQUIRE(bucket->GetEntryList().empty());
+
+  SECTION("no quota") {
+    BucketSettings no_quota;
+    no_quota.set_quota_type(BucketSettings::NONE);
+    REQUIRE(bucket->SetSettings(no_quota) == Error::kOk);
+    auto entry2 = bucket->GetOrCreateEntry("entry_2").result.lock();
+    REQUIRE(entry2->BeginWrite(ts + seconds(3), blob.size()).result->Write(blob) == Error::kOk);
+
+    REQUIRE(bucket->GetQuotaFill() == 0);
+    REQUIRE(bucket->ReclaimOldestBlock(0).result == 0);
+  }
+}
+
+TEST_CASE("storage::Bucket should remove folder of reclaimed entry with other files", "[bucket][quota]") {
+  BucketSettings settings;
+  settings.set_max_block_size(100);
+  settings.set_quota_type(BucketSettings::FIFO);
+  settings.set_quota_size(1000);
+  const auto path = BuildTmpDirectory();
+  auto bucket = IBucket::Build(path / "bucket", std::move(settings));
+
+  auto entry = bucket->GetOrCreateEntry("entry_1").result.lock();
+  REQUIRE(entry->BeginWrite(Time() + seconds(1), 400).result->Write(std::string(400, 'x')) == Error::kOk);
+  std::ofstream(path / "bucket" / "entry_1" / "leftover.jrn") << "data";
+
+  auto [removed, err] = bucket->ReclaimOldestBlock(0);
+  REQUIRE(err == Error::kOk);
+  REQUIRE(removed == 400);
+  REQUIRE(bucket->GetEntryList().empty());
+  REQUIRE_FALSE(fs::exists(path / "bucket" / "entry_1"));
 }
 
 TEST_CASE("storage::Bucket should not remove block with active reader", "[bucket][quota]") {
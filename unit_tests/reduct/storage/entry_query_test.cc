@@ -6,6 +6,7 @@
 #include <google/protobuf/util/time_util.h>
 
 #include <filesystem>
+#include <fstream>
 #include <thread>
 
 #include "reduct/helpers.h"
@@ -188,9 +189,34 @@ TEST_CASE("storage::Entry should query records", "[entry][query]") {
       REQUIRE(WriteOne(*entry, blob, kTimestamp + seconds(11)) == Error::kOk);
 
       auto id = entry->Query(kTimestamp + seconds(5), kTimestamp + seconds(12), kDefaultOptions).result;
-      REQUIRE(entry->Next(id).error == Error::NoContent());
+      REQUIRE(entry->Next(id).result.reader->timestamp() == kTimestamp + seconds(10));
+
+      auto [record, err] = entry->Next(id);
+      REQUIRE(err == Error::kOk);
+      REQUIRE(record.reader->timestamp() == kTimestamp + seconds(11));
+      REQUIRE(record.last);
     }
   }
+
+  SECTION("records written during query") {
+    REQUIRE(WriteOne(*entry, "blob", kTimestamp) == Error::kOk);
+    REQUIRE(WriteOne(*entry, "blob", kTimestamp + seconds(2)) == Error::kOk);
+    REQUIRE(WriteOne(*entry, "blob", kTimestamp + seconds(4)) == Error::kOk);
+
+    auto id = entry->Query(kTimestamp, kTimestamp + seconds(10), kDefaultOptions).result;
+    REQUIRE(entry->Next(id).result.reader->timestamp() == kTimestamp);
+
+    REQUIRE(WriteOne(*entry, "blob", kTimestamp + seconds(3)) == Error::kOk);
+    REQUIRE(WriteOne(*entry, "blob", kTimestamp + seconds(5)) == Error::kOk);
+
+    REQUIRE(entry->Next(id).result.reader->timestamp() == kTimestamp + seconds(2));
+    REQUIRE(entry->Next(id).result.reader->timestamp() == kTimestamp + seconds(3));
+    REQUIRE(entry->Next(id).result.reader->timestamp() == kTimestamp + seconds(4));
+
+    auto [record, err] = entry->Next(id);
+    REQUIRE(record.reader->timestamp() == kTimestamp + seconds(5));
+    REQUIRE(record.last);
+  }
 }
 
 TEST_CASE("storage::Entry should have TTL", "[entry][query]") {
@@ -241,3 +267,119 @@ TEST_CASE("storage::Entry should handle invalid blocks", "[entry][query]") {
   REQUIRE(record.reader->timestamp() == kTimestamp + seconds(2));
   REQUIRE(record.last);
 }
+
+TEST_CASE("storage::Entry should filter records by labels", "[entry][query][labels]") {
+  auto const path = BuildTmpDirectory();
+  auto entry = IEntry::Build(kName, path, MakeDefaultOptions());
+
+  // two records in a block
+  const std::string blob(40, 'x');
+  REQUIRE(WriteOne(*entry, blob, kTimestamp, {{"anomaly", "true"}, {"camera", "a"}}) == Error::kOk);
+  REQUIRE(WriteOne(*entry, blob, kTimestamp + seconds(1), {{"anomaly", "false"}, {"camera", "a"}}) == Error::kOk);
+  REQUIRE(WriteOne(*entry, blob, kTimestamp + seconds(2), {{"anomaly", "true"}, {"camera", "b"}}) == Error::kOk);
+  REQUIRE(WriteOne(*entry, blob, kTimestamp + seconds(3)) == Error::kOk);
+  REQUIRE(WriteOne(*entry, blob, kTimestamp + seconds(4)) == Error::kOk);
+
+  auto query = [](IEntry& entry, IQuery::Options options) {
+    options.ttl = seconds(1);
+    auto [id, err] = entry.Query({}, {}, options);
+    REQUIRE(err == Error::kOk);
+
+    std::vector<int64_t> timestamps;
+    for (;;) {
+      auto [record, next_err] = entry.Next(id);
+      if (next_err.code == Error::kNoContent) {
+        break;
+      }
+
+      REQUIRE(next_err == Error::kOk);
+      timestamps.push_back((ToMicroseconds(record.reader->timestamp()) - ToMicroseconds(kTimestamp)) / 1'000'000);
+      if (record.last) {
+        break;
+      }
+    }
+    return timestamps;
+  };
+
+  SECTION("include") {
+    REQUIRE(query(*entry, {.include = {{"anomaly", "true"}}}) == std::vector<int64_t>{0, 2});
+    REQUIRE(query(*entry, {.include = {{"anomaly", "true"}, {"camera", "b"}}}) == std::vector<int64_t>{2});
+    REQUIRE(query(*entry, {.include = {{"anomaly", "xxx"}}}).empty());
+    REQUIRE(query(*entry, {.include = {{"xxx", "true"}}}).empty());
+  }
+
+  SECTION("exclude") {
+    REQUIRE(query(*entry, {.exclude = {{"anomaly", "true"}}}) == std::vector<int64_t>{1, 3, 4});
+    REQUIRE(query(*entry, {.exclude = {{"anomaly", "true"}, {"camera", "a"}}}) == std::vector<int64_t>{1, 2, 3, 4});
+    REQUIRE(query(*entry, {.exclude = {{"xxx", "true"}}}) == std::vector<int64_t>{0, 1, 2, 3, 4});
+  }
+
+  SECTION("include and exclude") {
+    REQUIRE(query(*entry, {.include = {{"camera", "a"}}, .exclude = {{"anomaly", "true"}}}) ==
+            std::vector<int64_t>{1});
+  }
+
+  SECTION("restore from disk") {
+    entry = IEntry::Build(kName, path, MakeDefaultOptions());
+    REQUIRE(query(*entry, {.include = {{"anomaly", "true"}}}) == std::vector<int64_t>{0, 2});
+  }
+
+  SECTION("labels of read record") {
+    auto [reader, err] = entry->BeginRead(kTimestamp + seconds(2));
+    REQUIRE(err == Error::kOk);
+    REQUIRE(reader->labels() == reduct::async::LabelMap{{"anomaly", "true"}, {"camera", "b"}});
+  }
+}
+
+TEST_CASE("storage::Entry should skip blocks by their label filters", "[entry][query][labels]") {
+  auto const path = BuildTmpDirectory();
+  auto entry = IEntry::Build(kName, path, MakeDefaultOptions());
+
+  // a record in a block
+  const std::string blob(60, 'x');
+  REQUIRE(WriteOne(*entry, blob, kTimestamp, {{"anomaly", "true"}}) == Error::kOk);
+  REQUIRE(WriteOne(*entry, blob, kTimestamp + seconds(1), {{"anomaly", "false"}}) == Error::kOk);
+  REQUIRE(WriteOne(*entry, blob, kTimestamp + seconds(2)) == Error::kOk);
+  REQUIRE(WriteOne(*entry, blob, kTimestamp + seconds(3), {{"anomaly", "true"}}) == Error::kOk);
+  REQUIRE(entry->GetInfo().block_count() == 4);
+
+  auto query = [](IEntry& entry) {
+    auto [id, err] = entry.Query({}, {}, {.ttl = seconds(1), .include = {{"anomaly", "true"}}});
+    REQUIRE(err == Error::kOk);
+
+    std::vector<Time> timestamps;
+    for (;;) {
+      auto [record, next_err] = entry.Next(id);
+      REQUIRE(next_err == Error::kOk);
+      timestamps.push_back(record.reader->timestamp());
+      if (record.last) {
+        break;
+      }
+    }
+    return timestamps;
+  };
+
+  SECTION("without descriptors") {
+    // the query may not load the broken descriptors of the blocks without the label
+    for (auto ts : {kTimestamp + seconds(1), kTimestamp + seconds(2)}) {
+      std::ofstream(path / kName / fmt::format("{}.meta", ToMicroseconds(ts)), std::ios::trunc);
+    }
+
+    REQUIRE(query(*entry) == std::vector<Time>{kTimestamp, kTimestamp + seconds(3)});
+
+    // the summaries don't match the descriptors anymore, so the restoring validates and removes the broken blocks
+    entry = IEntry::Build(kName, path, MakeDefaultOptions());
+    REQUIRE(entry->GetInfo().block_count() == 2);
+    REQUIRE(entry->GetInfo().record_count() == 2);
+    REQUIRE(query(*entry) == std::vector<Time>{kTimestamp, kTimestamp + seconds(3)});
+  }
+
+  SECTION("belated record") {
+    const auto belated_ts = kTimestamp + seconds(1) + std::chrono::microseconds(1);
+    REQUIRE(WriteOne(*entry, "yy", belated_ts, {{"anomaly", "true"}}) == Error::kOk);
+    REQUIRE(query(*entry) == std::vector<Time>{kTimestamp, belated_ts, kTimestamp + seconds(3)});
+
+    entry = IEntry::Build(kName, path, MakeDefaultOptions());
+    REQUIRE(query(*entry) == std::vector<Time>{kTimestamp, belated_ts, kTimestamp + seconds(3)});
+  }
+}
@@ -9,11 +9,13 @@
 
 #include <filesystem>
 #include <fstream>
+#include <thread>
 
 #include "reduct/helpers.h"
 #include "reduct/proto/storage/entry.pb.h"
 
 using reduct::ReadOne;
+using reduct::WaitWritten;
 using reduct::WriteOne;
 using reduct::core::Error;
 using reduct::core::Time;
@@ -244,6 +246,77 @@ TEST_CASE("storage::Entry should restore itself from folder", "[entry]") {
   }
 }
 
+TEST_CASE("storage::Entry should restore itself from manifest", "[entry][manifest]") {
+  const auto options = MakeDefaultOptions();
+  const auto path = BuildTmpDirectory();
+  auto entry = IEntry::Build(kName, path, options);
+
+  const std::string blob(options.max_block_size, 'x');
+  REQUIRE(WriteOne(*entry, blob, kTimestamp) == Error::kOk);
+  REQUIRE(WriteOne(*entry, blob, kTimestamp + seconds(1)) == Error::kOk);
+  REQUIRE(WriteOne(*entry, "some_data", kTimestamp + seconds(2)) == Error::kOk);
+
+  // a recent mtime can't prove the manifest
+  const auto entry_path = path / kName;
+  REQUIRE(entry->GetManifest().mtime() == 0);
+
+  const auto mtime = fs::file_time_type::clock::now() - seconds(10);
+  fs::last_write_time(entry_path, mtime);
+
+  const auto manifest = entry->GetManifest();
+  REQUIRE(manifest.name() == kName);
+  REQUIRE(manifest.mtime() != 0);
+  REQUIRE(manifest.blocks_size() == 3);
+  REQUIRE(manifest.blocks(0).begin_time() == TimeUtil::MicrosecondsToTimestamp(ToMicroseconds(kTimestamp)));
+  REQUIRE(manifest.blocks(0).size() == 100);
+  REQUIRE(manifest.blocks(0).record_count() == 1);
+
+  const auto first_meta = entry_path / fmt::format("{}.meta", ToMicroseconds(kTimestamp));
+
+  SECTION("should take blocks from manifest") {
+    // the entry doesn't load the descriptors of the blocks, so it doesn't notice the removed one
+    fs::remove(first_meta);
+    fs::last_write_time(entry_path, mtime);
+
+    entry = IEntry::Build(kName, path, options, &manifest);
+    const auto info = entry->GetInfo();
+    REQUIRE(info.block_count() == 3);
+    REQUIRE(info.size() == 209);
+    REQUIRE(info.record_count() == 3);
+    REQUIRE(info.oldest_record() == ToMicroseconds(kTimestamp));
+    REQUIRE(info.latest_record() == ToMicroseconds(kTimestamp + seconds(2)));
+  }
+
+  SECTION("should load the latest block") {
+    REQUIRE(WriteOne(*entry, "next", kTimestamp + seconds(3)) == Error::kOk);
+    fs::last_write_time(entry_path, mtime);
+
+    entry = IEntry::Build(kName, path, options, &manifest);
+    const auto info = entry->GetInfo();
+    REQUIRE(info.block_count() == 3);
+    REQUIRE(info.size() == 213);
+    REQUIRE(info.record_count() == 4);
+    REQUIRE(info.latest_record() == ToMicroseconds(kTimestamp + seconds(3)));
+    REQUIRE(ReadOne(*entry, kTimestamp + seconds(3)).result == "next");
+  }
+
+  SECTION("should scan a stale entry") {
+    fs::remove(first_meta);
+
+    entry = IEntry::Build(kName, path, options, &manifest);
+    REQUIRE(entry->GetInfo().block_count() == 2);
+  }
+
+  SECTION("should scan an entry with a belated record") {
+    REQUIRE(WriteOne(*entry, "belated", kTimestamp + seconds(1) + std::chrono::microseconds(1)) == Error::kOk);
+
+    entry = IEntry::Build(kName, path, options, &manifest);
+    const auto info = entry->GetInfo();
+    REQUIRE(info.record_count() == 4);
+    REQUIRE(info.size() == 216);
+  }
+}
+
 TEST_CASE("storage::Entry should read from empty entry with 404", "[entry]") {
   auto entry = IEntry::Build(kName, BuildTmpDirectory(), MakeDefaultOptions());
 
@@ -323,3 +396,173 @@ TEST_CASE("storage::Entry should wait when write operations finish before removi
 
   REQUIRE(entry->RemoveOldestBlock() == Error::kOk);
 }
+
+TEST_CASE("storage::Entry should be written and read from many threads", "[entry]") {
+  auto entry = IEntry::Build(kName, BuildTmpDirectory(), MakeDefaultOptions());
+  REQUIRE(entry);
+
+  constexpr int kThreads = 4;
+  constexpr int kRecords = 50;
+
+  std::vector<std::thread> threads;
+  std::atomic<int> errors = 0;
+  for (int i = 0; i < kThreads; ++i) {
+    threads.emplace_back([&entry, &errors, i] {
+      for (int j = 0; j < kRecords; ++j) {
+        const auto ts = kTimestamp + std::chrono::microseconds(j * kThreads + i);
+        if (WriteOne(*entry, "some_data", ts) != Error::kOk || ReadOne(*entry, ts).result != "some_data") {
+          errors++;
+        }
+      }
+    });
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  REQUIRE(errors == 0);
+  REQUIRE(entry->GetInfo().record_count() == kThreads * kRecords);
+}
+
+TEST_CASE("storage::Entry should list records without reading data", "[entry][list]") {
+  const auto path = BuildTmpDirectory();
+  auto entry = IEntry::Build(kName, path, MakeDefaultOptions());
+
+  const std::string blob(60, 'x');
+  REQUIRE(WriteOne(*entry, blob, kTimestamp) == Error::kOk);
+  REQUIRE(WriteOne(*entry, "abc", kTimestamp + seconds(1)) == Error::kOk);
+  REQUIRE(WriteOne(*entry, blob, kTimestamp + seconds(2)) == Error::kOk);
+
+  auto timestamps = [](const reduct::proto::api::RecordInfoList& list) {
+    std::vector<uint64_t> result;
+    for (const auto& record : list.records()) {
+      result.push_back(record.ts());
+    }
+    return result;
+  };
+
+  const auto ts = static_cast<uint64_t>(ToMicroseconds(kTimestamp));
+  SECTION("all") {
+    auto [list, err] = entry->List({}, {}, 10);
+    REQUIRE(err == Error::kOk);
+    REQUIRE(list.last());
+    REQUIRE(timestamps(list) == std::vector<uint64_t>{ts, ts + 1'000'000, ts + 2'000'000});
+    REQUIRE(list.records(0).size() == 60);
+    REQUIRE(list.records(1).size() == 3);
+    REQUIRE(list.records(1).state() == reduct::proto::api::RecordInfo::FINISHED);
+  }
+
+  SECTION("time interval") {
+    auto [list, err] = entry->List(kTimestamp + seconds(1), kTimestamp + seconds(2), 10);
+    REQUIRE(err == Error::kOk);
+    REQUIRE(list.last());
+    REQUIRE(timestamps(list) == std::vector<uint64_t>{ts + 1'000'000});
+  }
+
+  SECTION("pages") {
+    auto [list, err] = entry->List({}, {}, 2);
+    REQUIRE(err == Error::kOk);
+    REQUIRE_FALSE(list.last());
+    REQUIRE(timestamps(list) == std::vector<uint64_t>{ts, ts + 1'000'000});
+
+    auto [next, next_err] = entry->List(kTimestamp + seconds(1) + std::chrono::microseconds(1), {}, 2);
+    REQUIRE(next_err == Error::kOk);
+    REQUIRE(next.last());
+    REQUIRE(timestamps(next) == std::vector<uint64_t>{ts + 2'000'000});
+  }
+
+  SECTION("without data files") {
+    for (const auto& file : fs::directory_iterator(path / kName)) {
+      if (file.path().extension() == ".blk") {
+        fs::remove(file.path());
+      }
+    }
+
+    auto [list, err] = entry->List({}, {}, 10);
+    REQUIRE(err == Error::kOk);
+    REQUIRE(list.records_size() == 3);
+  }
+}
+
+TEST_CASE("storage::Entry should read records before, after or nearest to timestamp", "[entry][read]") {
+  auto entry = IEntry::Build(kName, BuildTmpDirectory(), MakeDefaultOptions());
+
+  // the first record in one block, the others in another
+  const std::string blob(60, 'x');
+  REQUIRE(WriteOne(*entry, blob, kTimestamp) == Error::kOk);
+  REQUIRE(WriteOne(*entry, blob, kTimestamp + seconds(2)) == Error::kOk);
+  REQUIRE(WriteOne(*entry, "abc", kTimestamp + seconds(4)) == Error::kOk);
+  REQUIRE(WriteOne(*entry, "abc", kTimestamp + seconds(5)) == Error::kOk);
+  REQUIRE(entry->GetInfo().block_count() == 2);
+
+  using Mode = IEntry::ReadMode;
+  auto read_time = [&entry](Time ts, Mode mode) -> std::optional<Time> {
+    auto [reader, err] = entry->BeginRead(ts, mode);
+    if (err) {
+      REQUIRE(err == Error::NotFound("No records for this timestamp"));
+      return std::nullopt;
+    }
+    return reader->timestamp();
+  };
+
+  SECTION("exact") {
+    REQUIRE(read_time(kTimestamp + seconds(2), Mode::kExact) == kTimestamp + seconds(2));
+    REQUIRE_FALSE(read_time(kTimestamp + seconds(1), Mode::kExact));
+  }
+
+  SECTION("before") {
+    REQUIRE(read_time(kTimestamp + seconds(2), Mode::kBefore) == kTimestamp + seconds(2));
+    REQUIRE(read_time(kTimestamp + seconds(3), Mode::kBefore) == kTimestamp + seconds(2));
+    REQUIRE(read_time(kTimestamp + seconds(2) - std::chrono::microseconds(1), Mode::kBefore) == kTimestamp);
+    REQUIRE(read_time(kTimestamp + seconds(10), Mode::kBefore) == kTimestamp + seconds(5));
+    REQUIRE_FALSE(read_time(kTimestamp - std::chrono::microseconds(1), Mode::kBefore));
+  }
+
+  SECTION("after") {
+    REQUIRE(read_time(kTimestamp, Mode::kAfter) == kTimestamp);
+    REQUIRE(read_time(kTimestamp + std::chrono::microseconds(1), Mode::kAfter) == kTimestamp + seconds(2));
+    REQUIRE(read_time(kTimestamp + seconds(4) + std::chrono::microseconds(1), Mode::kAfter) == kTimestamp + seconds(5));
+    REQUIRE(read_time(Time(), Mode::kAfter) == kTimestamp);
+    REQUIRE_FALSE(read_time(kTimestamp + seconds(5) + std::chrono::microseconds(1), Mode::kAfter));
+  }
+
+  SECTION("nearest") {
+    REQUIRE(read_time(Time(), Mode::kNearest) == kTimestamp);
+    REQUIRE(read_time(kTimestamp + seconds(1) - std::chrono::microseconds(1), Mode::kNearest) == kTimestamp);
+    REQUIRE(read_time(kTimestamp + seconds(1), Mode::kNearest) == kTimestamp);  // the earlier one for equal distance
+    REQUIRE(read_time(kTimestamp + seconds(1) + std::chrono::microseconds(1), Mode::kNearest) == kTimestamp + seconds(2));
+    REQUIRE(read_time(kTimestamp + seconds(10), Mode::kNearest) == kTimestamp + seconds(5));
+  }
+
+  SECTION("unfinished record") {
+    // a started record next to the finished ones is skipped in all directions, but it is still too early to read it
+    auto [writer, err] = entry->BeginWrite(kTimestamp + seconds(6), 10);
+    REQUIRE(err == Error::kOk);
+    REQUIRE(read_time(kTimestamp + seconds(10), Mode::kBefore) == kTimestamp + seconds(5));
+    REQUIRE(read_time(kTimestamp + seconds(6), Mode::kNearest) == kTimestamp + seconds(5));
+    REQUIRE_FALSE(read_time(kTimestamp + seconds(6), Mode::kAfter));
+    REQUIRE(entry->BeginRead(kTimestamp + seconds(6), Mode::kExact).error ==
+            Error::TooEarly("Record is still being written"));
+
+    REQUIRE(WriteOne(*entry, "abc", kTimestamp + seconds(7)) == Error::kOk);
+    REQUIRE(read_time(kTimestamp + seconds(6), Mode::kAfter) == kTimestamp + seconds(7));
+    REQUIRE(read_time(kTimestamp + seconds(6), Mode::kNearest) == kTimestamp + seconds(5));
+    REQUIRE(read_time(kTimestamp + seconds(6) + std::chrono::microseconds(1), Mode::kNearest) ==
+            kTimestamp + seconds(7));
+
+    REQUIRE(writer->Write("0123456789") == Error::kOk);
+    REQUIRE(WaitWritten(*writer) == Error::kOk);
+    REQUIRE(read_time(kTimestamp + seconds(6), Mode::kNearest) == kTimestamp + seconds(6));
+  }
+
+  SECTION("unfinished record in the middle of a block") {
+    REQUIRE(WriteOne(*entry, "abc", kTimestamp + seconds(6)) == Error::kOk);
+    auto [writer, err] = entry->BeginWrite(kTimestamp + seconds(5) + std::chrono::milliseconds(500), 10);
+    REQUIRE(err == Error::kOk);
+
+    const auto started = kTimestamp + seconds(5) + std::chrono::milliseconds(500);
+    REQUIRE(read_time(started, Mode::kBefore) == kTimestamp + seconds(5));
+    REQUIRE(read_time(started, Mode::kAfter) == kTimestamp + seconds(6));
+  }
+}
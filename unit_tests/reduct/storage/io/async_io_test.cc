@@ -13,6 +13,7 @@ using reduct::core::Time;
 using reduct::storage::IEntry;
 
 using reduct::ReadOne;
+using reduct::WaitWritten;
 using reduct::WriteOne;
 using reduct::async::IAsyncReader;
 
@@ -43,6 +44,8 @@ TEST_CASE("AsyncWriter should provide async writing in the same block") {
   REQUIRE(writer_2->Write("bbbbb", false) == Error::kOk);
   REQUIRE(writer_1->Write("ccccc") == Error::kOk);
   REQUIRE(writer_2->Write("ddddd") == Error::kOk);
+  REQUIRE(WaitWritten(*writer_1) == Error::kOk);
+  REQUIRE(WaitWritten(*writer_2) == Error::kOk);
 
   REQUIRE(ReadOne(*entry, kTimestamp).result == "aaaaaccccc");
   REQUIRE(ReadOne(*entry, kTimestamp + seconds(1)).result == "bbbbbddddd");
@@ -108,3 +111,26 @@ TEST_CASE("AsyncReader should not spoil data") {
   REQUIRE(err == Error::kOk);
   REQUIRE(reader->Read().result == IAsyncReader::DataChunk{blob, true});
 }
+
+#ifndef REDUCT_IO_URING  // the ring reader is used instead of mapping
+TEST_CASE("AsyncReader should share mapped block between readers") {
+  auto entry = IEntry::Build(kName, BuildTmpDirectory(), MakeDefaultOptions());
+  REQUIRE(entry);
+
+  REQUIRE(WriteOne(*entry, "1234567890", kTimestamp) == Error::kOk);
+  REQUIRE(WriteOne(*entry, "abcd", kTimestamp + seconds(1)) == Error::kOk);
+
+  auto reader_1 = entry->BeginRead(kTimestamp).result;
+  auto reader_2 = entry->BeginRead(kTimestamp).result;
+  auto reader_3 = entry->BeginRead(kTimestamp + seconds(1)).result;
+
+  auto chunk_1 = reader_1->Read().result;
+  auto chunk_2 = reader_2->Read().result;
+  auto chunk_3 = reader_3->Read().result;
+
+  REQUIRE(chunk_1 == IAsyncReader::DataChunk{"1234567890", true});
+  REQUIRE(chunk_2.data.data() == chunk_1.data.data());
+  REQUIRE(chunk_3 == IAsyncReader::DataChunk{"abcd", true});
+  REQUIRE(chunk_3.data.data() == chunk_1.data.data() + 10);
+}
+#endif
@@ -0,0 +1,136 @@
+// Copyright 2022 ReductStore
+// This Source Code Form is subject to the terms of the Mozilla Public
+//    License, v. 2.0. If a copy of the MPL was not distributed with this
+//    file, You can obtain one at https://mozilla.org/MPL/2.0/.
+#include "reduct/storage/io/file_syncer.h"
+
+#include <catch2/catch.hpp>
+
+#include <fstream>
+#include <thread>
+
+#include "reduct/config.h"
+#include "reduct/helpers.h"
+#include "reduct/storage/entry.h"
+
+using reduct::core::Error;
+using reduct::core::Time;
+using reduct::proto::api::BucketSettings;
+using reduct::storage::IEntry;
+using reduct::storage::io::IFileSyncer;
+using reduct::storage::io::SyncFile;
+
+using std::chrono::milliseconds;
+using std::chrono::seconds;
+
+static auto MakeOptions(IFileSyncer::Durability durability, size_t sync_size = 1000) {
+  return IFileSyncer::Options{
+      .durability = durability,
+      .sync_interval = milliseconds(10),
+      .sync_size = sync_size,
+  };
+}
+
+static auto WaitFor(const std::shared_future<Error>& future) {
+  return future.wait_for(seconds(1)) == std::future_status::ready;
+}
+
+TEST_CASE("storage::io::SyncFile should sync files and directories", "[syncer]") {
+  const auto path = BuildTmpDirectory();
+  std::ofstream(path / "file") << "data";
+
+  REQUIRE(SyncFile(path / "file") == Error::kOk);
+  REQUIRE(SyncFile(path) == Error::kOk);
+  REQUIRE(SyncFile(path / "removed") == Error::kOk);
+}
+
+TEST_CASE("storage::io::FileSyncer should sync according to durability", "[syncer]") {
+  const auto path = BuildTmpDirectory();
+  std::ofstream(path / "file") << "data";
+
+  SECTION("no sync") {
+    auto syncer = IFileSyncer::Build(MakeOptions(BucketSettings::NO_SYNC));
+    auto future = syncer->Sync({path / "file"}, 4);
+    REQUIRE(WaitFor(future));
+    REQUIRE(future.get() == Error::kOk);
+  }
+
+  SECTION("strict") {
+    auto syncer = IFileSyncer::Build({
+        .durability = BucketSettings::STRICT_SYNC,
+        .sync_interval = seconds(100),
+        .sync_size = 1'000'000,
+    });
+
+    // synced in the background thread at once, without waiting for the interval or size
+    auto future = syncer->Sync({path / "file"}, 4);
+    REQUIRE(WaitFor(future));
+    REQUIRE(future.get() == Error::kOk);
+  }
+
+  SECTION("batched") {
+    auto syncer = IFileSyncer::Build(MakeOptions(BucketSettings::BATCHED_SYNC, 1'000'000));
+    auto future_1 = syncer->Sync({path / "file"}, 4);
+    auto future_2 = syncer->Sync({path / "file", path}, 4);
+
+    REQUIRE(WaitFor(future_1));
+    REQUIRE(WaitFor(future_2));
+    REQUIRE(future_1.get() == Error::kOk);
+  }
+
+  SECTION("batched by size") {
+    auto syncer = IFileSyncer::Build({
+        .durability = BucketSettings::BATCHED_SYNC,
+        .sync_interval = seconds(100),
+        .sync_size = 4,
+    });
+
+    REQUIRE(WaitFor(syncer->Sync({path / "file"}, 4)));
+  }
+}
+
+TEST_CASE("storage::io::FileSyncer should sync pending files when durability changes", "[syncer]") {
+  const auto path = BuildTmpDirectory();
+  auto syncer = IFileSyncer::Build({
+      .durability = BucketSettings::BATCHED_SYNC,
+      .sync_interval = seconds(100),
+      .sync_size = 1000,
+  });
+
+  auto future = syncer->Sync({path}, 4);
+  REQUIRE(future.wait_for(milliseconds(10)) == std::future_status::timeout);
+
+  syncer->SetOptions(MakeOptions(BucketSettings::NO_SYNC));
+  REQUIRE(future.wait_for(seconds(0)) == std::future_status::ready);
+  REQUIRE(syncer->GetOptions().durability == BucketSettings::NO_SYNC);
+
+  syncer->SetOptions(MakeOptions(BucketSettings::BATCHED_SYNC));
+  REQUIRE(WaitFor(syncer->Sync({path}, 4)));
+
+  syncer->SetOptions(MakeOptions(BucketSettings::STRICT_SYNC));
+  REQUIRE(WaitFor(syncer->Sync({path}, 4)));
+}
+
+TEST_CASE("storage::IEntry should provide sync result of written records", "[syncer][entry]") {
+  auto syncer = IFileSyncer::Build(MakeOptions(BucketSettings::BATCHED_SYNC));
+  auto entry = IEntry::Build("entry", BuildTmpDirectory(),
+                             {
+                                 .max_block_size = 1000,
+                                 .max_block_records = 100,
+                                 .syncer = syncer,
+                             });
+
+  auto [writer, err] = entry->BeginWrite(Time(), 4);
+  REQUIRE(err == Error::kOk);
+  REQUIRE_FALSE(writer->sync_result());  // nothing is written yet
+
+  REQUIRE(writer->Write("data") == Error::kOk);
+
+  std::optional<Error> result;
+  for (int i = 0; i < 100 && !result; ++i) {
+    result = writer->sync_result();
+    std::this_thread::sleep_for(milliseconds(10));
+  }
+
+  REQUIRE(result == Error::kOk);
+}
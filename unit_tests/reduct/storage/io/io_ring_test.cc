@@ -0,0 +1,160 @@
+// Copyright 2022 ReductStore
+// This Source Code Form is subject to the terms of the Mozilla Public
+//    License, v. 2.0. If a copy of the MPL was not distributed with this
+//    file, You can obtain one at https://mozilla.org/MPL/2.0/.
+#include "reduct/storage/io/io_ring.h"
+
+#include <catch2/catch.hpp>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <future>
+
+#include "reduct/config.h"
+#include "reduct/helpers.h"
+#include "reduct/storage/entry.h"
+
+using reduct::ReadOne;
+using reduct::WriteOne;
+using reduct::core::Error;
+using reduct::core::Time;
+using reduct::storage::IEntry;
+using reduct::storage::io::IIoRing;
+
+using std::chrono::seconds;
+
+static void WaitFor(const IIoRing::SPtr& ring, const IIoRing::OperationSPtr& operation) {
+  while (!operation->completed) {
+    ring->Poll();
+  }
+}
+
+TEST_CASE("storage::io::IIoRing should read and write files", "[io_uring]") {
+  auto ring = IIoRing::Instance();
+  REQUIRE(ring);
+
+  const auto path = BuildTmpDirectory() / "file";
+  std::ofstream(path) << "0123456789";
+  int fd = ::open(path.c_str(), O_RDWR);
+  REQUIRE(fd >= 0);
+
+  auto write = std::make_shared<IIoRing::Operation>(IIoRing::Operation{.buffer = "abc"});
+  REQUIRE(ring->SubmitWrite(fd, 2, write) == Error::kOk);
+  WaitFor(ring, write);
+  REQUIRE(write->result == 3);
+
+  auto read = std::make_shared<IIoRing::Operation>(IIoRing::Operation{.buffer = std::string(8, 'x')});
+  REQUIRE(ring->SubmitRead(fd, 0, read) == Error::kOk);
+  WaitFor(ring, read);
+  REQUIRE(read->result == 8);
+  REQUIRE(read->buffer == "01abc567");
+
+  SECTION("bad file") {
+    auto bad = std::make_shared<IIoRing::Operation>(IIoRing::Operation{.buffer = "abc"});
+    REQUIRE(ring->SubmitWrite(-1, 0, bad) == Error::kOk);
+    WaitFor(ring, bad);
+    REQUIRE(bad->result == -EBADF);
+  }
+
+  ::close(fd);
+}
+
+TEST_CASE("storage::IEntry should write and read records with io_uring", "[io_uring][entry]") {
+  auto entry = IEntry::Build("entry", BuildTmpDirectory(), {.max_block_size = 1000, .max_block_records = 100});
+  REQUIRE(entry);
+
+  SECTION("one chunk") {
+    REQUIRE(WriteOne(*entry, "1234567890", Time()) == Error::kOk);
+    REQUIRE(ReadOne(*entry, Time()).result == "1234567890");
+  }
+
+  SECTION("record is finished when all chunks are written") {
+    auto [writer, err] = entry->BeginWrite(Time(), 6);
+    REQUIRE(err == Error::kOk);
+    REQUIRE(writer->Write("abc", false) == Error::kOk);
+    REQUIRE(writer->Write("def", true) == Error::kOk);
+    REQUIRE(entry->BeginRead(Time()).error == Error::TooEarly("Record is still being written"));
+
+    std::optional<Error> result;
+    while (!(result = writer->sync_result())) {
+    }
+
+    REQUIRE(result == Error::kOk);
+    REQUIRE(writer->is_done());
+    REQUIRE(ReadOne(*entry, Time()).result == "abcdef");
+  }
+
+  SECTION("writer and reader built in another thread") {
+    // the HTTP server begins records in a worker of the pool and writes them in the loop
+    auto [writer, err] = std::async(std::launch::async, [&entry] { return entry->BeginWrite(Time(), 6); }).get();
+    REQUIRE(err == Error::kOk);
+    REQUIRE(writer->Write("abcdef", true) == Error::kOk);
+
+    std::optional<Error> result;
+    while (!(result = writer->sync_result())) {
+    }
+    REQUIRE(result == Error::kOk);
+
+    auto reader = std::async(std::launch::async, [&entry] { return entry->BeginRead(Time()).result; }).get();
+    REQUIRE(reader);
+
+    std::string data;
+    while (!reader->is_done()) {
+      auto [chunk, read_err] = reader->Read();
+      if (read_err.code == Error::kContinue) {
+        continue;
+      }
+
+      REQUIRE(read_err == Error::kOk);
+      data.append(chunk.data);
+    }
+    REQUIRE(data == "abcdef");
+  }
+
+  SECTION("record of destroyed writer is finished by ring") {
+    auto [writer, err] = entry->BeginWrite(Time(), 6);
+    REQUIRE(err == Error::kOk);
+    REQUIRE(writer->Write("abcdef", true) == Error::kOk);
+    writer.reset();  // doesn't wait for the disk
+
+    auto ring = IIoRing::Instance();
+    while (ring->Reap() > 0) {
+    }
+
+    REQUIRE(ReadOne(*entry, Time()).result == "abcdef");
+  }
+
+  SECTION("adopted writer of removed entry") {
+    auto [writer, err] = entry->BeginWrite(Time(), 6);
+    REQUIRE(err == Error::kOk);
+    REQUIRE(writer->Write("abcdef", true) == Error::kOk);
+    writer.reset();
+    entry.reset();
+
+    auto ring = IIoRing::Instance();
+    while (ring->Reap() > 0) {
+    }
+  }
+
+  SECTION("chunks") {
+    const auto size = reduct::kDefaultMaxReadChunk + 10;
+    auto entry_with_big_blocks =
+        IEntry::Build("entry", BuildTmpDirectory(), {.max_block_size = size * 2, .max_block_records = 100});
+    REQUIRE(WriteOne(*entry_with_big_blocks, std::string(size, 'x'), Time() + seconds(1)) == Error::kOk);
+
+    auto reader = entry_with_big_blocks->BeginRead(Time() + seconds(1)).result;
+    std::string data;
+    while (!reader->is_done()) {
+      auto [chunk, read_err] = reader->Read();
+      if (read_err.code == Error::kContinue) {
+        continue;
+      }
+
+      REQUIRE(read_err == Error::kOk);
+      data.append(chunk.data);
+    }
+
+    REQUIRE(data == std::string(size, 'x'));
+  }
+}
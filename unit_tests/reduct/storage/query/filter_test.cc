@@ -0,0 +1,59 @@
+// Copyright 2022 ReductStore
+// This Source Code Form is subject to the terms of the Mozilla Public
+//    License, v. 2.0. If a copy of the MPL was not distributed with this
+//    file, You can obtain one at https://mozilla.org/MPL/2.0/.
+
+#include "reduct/storage/query/filter.h"
+
+#include <catch2/catch.hpp>
+#include <fmt/core.h>
+
+#include <vector>
+
+using reduct::storage::query::FindState;
+using reduct::storage::query::FindStateKernel;
+using reduct::storage::query::GetFindStateKernels;
+
+TEST_CASE("storage::query::FindState should find the first record with the state", "[query][filter]") {
+  const auto kernels = GetFindStateKernels();
+  const auto [name, kernel] = GENERATE_COPY(table<const char*, FindStateKernel>({
+      {"scalar", kernels.scalar},
+      {"sse2", kernels.sse2},
+      {"avx2", kernels.avx2},
+      {"dispatched", FindState},
+  }));
+
+  if (!kernel) {
+    WARN(fmt::format("{} kernel isn't supported by the CPU", name));
+    return;
+  }
+
+  INFO(name);
+
+  // the sizes cover the vector width, the remainder and the scalar tail
+  const auto size = GENERATE(0, 1, 15, 16, 17, 31, 32, 33, 100, 1024);
+  std::vector<uint8_t> states(size, 0);
+
+  SECTION("no record") { REQUIRE(kernel(states, 0, 1) == states.size()); }
+
+  SECTION("every position") {
+    for (size_t pos = 0; pos < states.size(); ++pos) {
+      states.assign(size, 0);
+      states[pos] = 1;
+      REQUIRE(kernel(states, 0, 1) == pos);
+      REQUIRE(kernel(states, pos, 1) == pos);
+      REQUIRE(kernel(states, pos + 1, 1) == states.size());
+    }
+  }
+
+  SECTION("first of many") {
+    if (size > 2) {
+      states[size / 2] = 1;
+      states[size - 1] = 1;
+      REQUIRE(kernel(states, 0, 1) == size / 2);
+      REQUIRE(kernel(states, size / 2 + 1, 1) == size - 1);
+    }
+  }
+
+  SECTION("start at the end") { REQUIRE(kernel(states, states.size(), 0) == states.size()); }
+}
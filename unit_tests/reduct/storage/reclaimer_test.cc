@@ -0,0 +1,89 @@
+// Copyright 2022 ReductStore
+// This Source Code Form is subject to the terms of the Mozilla Public
+//    License, v. 2.0. If a copy of the MPL was not distributed with this
+//    file, You can obtain one at https://mozilla.org/MPL/2.0/.
+#include "reduct/storage/reclaimer.h"
+
+#include <catch2/catch.hpp>
+
+#include <future>
+
+#include "reduct/helpers.h"
+
+using reduct::core::Error;
+using reduct::core::Time;
+using reduct::proto::api::BucketSettings;
+using reduct::storage::IBucket;
+using reduct::storage::IReclaimer;
+
+using std::chrono::milliseconds;
+using std::chrono::seconds;
+
+TEST_CASE("storage::Reclaimer should remove the oldest blocks", "[reclaimer][quota]") {
+  BucketSettings settings;
+  settings.set_max_block_size(100);
+  settings.set_quota_type(BucketSettings::FIFO);
+  settings.set_quota_size(1000);
+  IBucket::SPtr bucket = IBucket::Build(BuildTmpDirectory() / "bucket", std::move(settings));
+
+  auto entry = bucket->GetOrCreateEntry("entry").result.lock();
+  const auto ts = Time();
+  std::string blob(400, 'x');
+  REQUIRE(entry->BeginWrite(ts + seconds(1), blob.size()).result->Write(blob) == Error::kOk);
+  REQUIRE(entry->BeginWrite(ts + seconds(2), blob.size()).result->Write(blob) == Error::kOk);
+
+  IReclaimer::Options options{
+      .high_watermark = 0.9,
+      .low_watermark = 0.5,
+      .interval = milliseconds(10),
+      .background = false,
+  };
+
+  auto buckets = [bucket] { return std::map<std::string, IBucket::SPtr>{{"bucket", bucket}}; };
+
+  SECTION("below high watermark") {
+    auto reclaimer = IReclaimer::Build(buckets, options);
+    REQUIRE(reclaimer->RunOnce() == 0);
+    REQUIRE(bucket->GetQuotaFill() == Approx(0.8));
+  }
+
+  SECTION("down to low watermark") {
+    REQUIRE(entry->BeginWrite(ts + seconds(3), blob.size()).result->Write(blob) == Error::kOk);
+
+    auto reclaimer = IReclaimer::Build(buckets, options);
+    REQUIRE(reclaimer->RunOnce() == 800);
+    REQUIRE(bucket->GetQuotaFill() == Approx(0.4));
+    REQUIRE(entry->BeginRead(ts + seconds(3)).error == Error::kOk);
+  }
+
+  SECTION("with max rate") {
+    REQUIRE(entry->BeginWrite(ts + seconds(3), blob.size()).result->Write(blob) == Error::kOk);
+
+    options.max_rate = 4000;  // each block of 400 bytes gives the disk 100 ms
+    auto reclaimer = IReclaimer::Build(buckets, options);
+
+    const auto start = std::chrono::steady_clock::now();
+    REQUIRE(reclaimer->RunOnce() == 800);
+    REQUIRE(std::chrono::steady_clock::now() - start >= milliseconds(200));
+    REQUIRE(bucket->GetQuotaFill() == Approx(0.4));
+  }
+
+  SECTION("in background") {
+    REQUIRE(entry->BeginWrite(ts + seconds(3), blob.size()).result->Write(blob) == Error::kOk);
+
+    // the thread takes the buckets at the beginning of each check, so the second call means the first check is done
+    std::promise<void> checked;
+    auto future = checked.get_future();
+    auto counted_buckets = [buckets, &checked, calls = 0]() mutable {
+      if (++calls == 2) {
+        checked.set_value();
+      }
+      return buckets();
+    };
+
+    options.background = true;
+    auto reclaimer = IReclaimer::Build(counted_buckets, options);
+    REQUIRE(future.wait_for(seconds(5)) == std::future_status::ready);
+    REQUIRE(bucket->GetQuotaFill() == Approx(0.4));
+  }
+}
@@ -60,6 +60,46 @@ TEST_CASE("storage::Storage should be restored from filesystem", "[storage]]") {
   REQUIRE(info.latest_record() == 2000002);
 }
 
+TEST_CASE("storage::Storage should restore buckets in background", "[storage]") {
+  const auto dir = BuildTmpDirectory();
+  auto storage = IStorage::Build({.data_path = dir});
+  REQUIRE(storage->CreateBucket("bucket_1", {}) == Error::kOk);
+  REQUIRE(storage->CreateBucket("bucket_2", {}) == Error::kOk);
+
+  storage = IStorage::Build({.data_path = dir, .background_restore = true});
+  REQUIRE(storage->CreateBucket("bucket_1", {}).code == 409);
+
+  for (const auto& name : {"bucket_1", "bucket_2"}) {
+    auto err = storage->GetBucket(name).error;
+    for (int i = 0; i < 100 && err.code == 503; ++i) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      err = storage->GetBucket(name).error;
+    }
+    REQUIRE(err == Error::kOk);
+  }
+
+  REQUIRE(storage->GetList().result.buckets_size() == 2);
+}
+
+TEST_CASE("storage::Storage should checkpoint manifest", "[storage][manifest]") {
+  const auto dir = BuildTmpDirectory();
+  auto storage = IStorage::Build({.data_path = dir, .checkpoint_interval = std::chrono::milliseconds(10)});
+  REQUIRE(storage->CreateBucket("bucket", {}) == Error::kOk);
+
+  auto entry = storage->GetBucket("bucket").result.lock()->GetOrCreateEntry("entry").result.lock();
+  REQUIRE(reduct::WriteOne(*entry, "some_blob", Time() + us(1000001)) == Error::kOk);
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  REQUIRE(fs::exists(dir / "storage.manifest"));
+
+  storage = IStorage::Build({.data_path = dir});
+
+  auto [info, err] = storage->GetInfo();
+  REQUIRE(info.bucket_count() == 1);
+  REQUIRE(info.usage() == 9);
+  REQUIRE(info.latest_record() == 1000001);
+}
+
 TEST_CASE("storage::Storage should provide list of buckets", "[storage]") {
   const auto dir = BuildTmpDirectory();
   auto storage = IStorage::Build({.data_path = dir});
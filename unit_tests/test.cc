@@ -27,6 +27,11 @@ class Loop : public ILoop {
     std::this_thread::sleep_for(std::chrono::microseconds(10));
     task();
   }
+
+  void Schedule(std::chrono::microseconds delay, Task&& task) override {
+    std::this_thread::sleep_for(delay);
+    task();
+  }
 };
 
 /**